@@ -41,6 +41,7 @@
 // RENDERING
 #include "FZTextureAtlas.h"
 #include "FZTexture2D.h"
+#include "FZImageConverter.h"
 #include "FZGLProgram.h"
 #include "FZGLState.h"
 #include "FZGrabber.h"
@@ -56,11 +57,17 @@
 #include "FZEventManager.h"
 #include "FZFontCache.h"
 #include "FZResourcesManager.h"
+#include "FZResourcesArchive.h"
 #include "FZScheduler.h"
 #include "FZShaderCache.h"
 #include "FZSpriteFrameCache.h"
 #include "FZTextureCache.h"
+#include "FZPreloader.h"
+#include "FZPrefetchManager.h"
+#include "FZMemoryManager.h"
+#include "FZResourceGroup.h"
 #include "FZPerformManager.h"
+#include "FZWorkerPool.h"
 
 
 // ACTIONS
@@ -69,6 +76,7 @@
 #include "FZActionInterval.h"
 #include "FZActionEase.h"
 #include "FZActionCamera.h"
+#include "FZCoroutine.h"
 #include "FZActionEase.h"
 
 
@@ -94,6 +102,8 @@
 // OTHERS
 #include "FZIO.h"
 #include "FZFont.h"
+#include "FZTrueType.h"
+#include "FZDistanceField.h"
 #include "FZEvent.h"
 #include "FZFilter.h"
 #include "FZGrid.h"
@@ -52,7 +52,7 @@ namespace FORZE {
     : m_actions()
     {
         Scheduler::Instance().scheduleSelector(SEL_FLOAT(ActionManager::update),
-                                               this, 0, false);
+                                               this, 0, false, 2, kFZUpdatePhase_Actions);
     }
     
     
@@ -85,7 +85,23 @@ namespace FORZE {
     }
     
     
-    void ActionManager::addAction(Action *action, void *target, bool paused)
+    bool ActionManager::isRunning(const Action *action, void *target) const
+    {
+        FZ_ASSERT( action != NULL, "Argument action must be non-NULL.");
+        FZ_ASSERT( target != NULL, "Argument target must be non-NULL.");
+        
+        // removed actions stay in the map until the next update.
+        pair<actionsMap::const_iterator, actionsMap::const_iterator> p(m_actions.equal_range(target));
+        actionsMap::const_iterator it(p.first);
+        for (; it != p.second; ++it) {
+            if(it->second.action == action)
+                return !it->second.isStarted || action->getTarget() != NULL;
+        }
+        return false;
+    }
+    
+    
+    void ActionManager::addAction(Action *action, void *target, bool paused, UpdatePolicyProtocol *policy)
     {
         FZ_ASSERT( action != NULL, "Argument action must be non-NULL.");
         FZ_ASSERT( target != NULL, "Argument target must be non-NULL.");
@@ -93,7 +109,7 @@ namespace FORZE {
         
         action->retain();
         
-        fzActionHandler container = {action, paused, false};
+        fzActionHandler container = {action, policy, 0, paused, false};
         m_actions.insert(pairAction(target, container));
     }
     
@@ -120,17 +136,38 @@ namespace FORZE {
     }
     
     
+    void ActionManager::setUpdatePolicy(void *target, UpdatePolicyProtocol *policy)
+    {
+        FZ_ASSERT( target != NULL, "Argument target must be non-NULL.");
+        
+        const pairSearch& p = m_actions.equal_range(target);
+        actionsMap::iterator it(p.first);
+        for (; it != p.second; ++it)
+            it->second.policy = policy;
+    }
+    
+    
     void ActionManager::removeAction(const Action* action)
     {
         FZ_ASSERT( action != NULL, "Argument action must be non-NULL.");
         
-        const pairSearch& p = m_actions.equal_range(action->getTarget());
-        actionsMap::const_iterator it(p.first);
-        for (; it != p.second; ++it)
+        // actions that did not start yet have no target.
+        actionsMap::iterator it, end;
+        if(action->getTarget()) {
+            const pairSearch& p = m_actions.equal_range(action->getTarget());
+            it = p.first;
+            end = p.second;
+        }else{
+            it = m_actions.begin();
+            end = m_actions.end();
+        }
+        
+        for (; it != end; ++it)
         {
             Action *a = it->second.action;
             if(a == action) {
                 it->second.action->stop();
+                it->second.isStarted = true;
                 return;
             }
         }
@@ -143,12 +180,13 @@ namespace FORZE {
         FZ_ASSERT( target != NULL, "Argument target must be non-NULL.");
         
         const pairSearch& p = m_actions.equal_range(target);
-        actionsMap::const_iterator it(p.first);
+        actionsMap::iterator it(p.first);
         for (; it != p.second; ++it)
         {
             Action *action = it->second.action;
             if(action->getTag() == tag) {
                 it->second.action->stop();
+                it->second.isStarted = true;
                 return;
             }
         }
@@ -160,22 +198,28 @@ namespace FORZE {
         FZ_ASSERT( target != NULL, "Argument target must be non-NULL.");
         
         const pairSearch& p = m_actions.equal_range(target);
-        actionsMap::const_iterator it(p.first);
-        for (; it != p.second; ++it)
+        actionsMap::iterator it(p.first);
+        for (; it != p.second; ++it) {
             it->second.action->stop();
+            it->second.isStarted = true;
+        }
     }
     
     
     void ActionManager::removeAllActions()
     {
-        actionsMap::const_iterator it(m_actions.begin());
-        for (; it != m_actions.end(); ++it)
+        actionsMap::iterator it(m_actions.begin());
+        for (; it != m_actions.end(); ++it) {
             it->second.action->stop();
+            it->second.isStarted = true;
+        }
     }
     
     
     void ActionManager::update(fzFloat dt)
     {
+        fzUInt frame = Scheduler::Instance().getFrame();
+        
         actionsMap::iterator it(m_actions.begin());
         for(; it != m_actions.end();) {
             Action *action = it->second.action;
@@ -194,9 +238,19 @@ namespace FORZE {
                 
                 if(!it->second.isPaused) {
                     
-                    action->step(dt);
-                    if(action->isDone())
-                        action->stop();
+                    fzActionHandler& handler = it->second;
+                    fzUpdateDecision decision = (handler.policy == NULL)
+                    ? kFZUpdateDecision_Update
+                    : handler.policy->getUpdateDecision(frame);
+                    
+                    if(decision == kFZUpdateDecision_Update) {
+                        action->step(dt + handler.skippedDt);
+                        handler.skippedDt = 0;
+                        if(action->isDone())
+                            action->stop();
+                        
+                    }else if(decision == kFZUpdateDecision_Skip)
+                        handler.skippedDt += dt;
                 }
                 ++it;
             }
@@ -33,6 +33,7 @@
 
 #include "FZAction.h"
 #include "FZSelectors.h"
+#include "FZScheduler.h"
 #if FZ_STL_CPLUSPLUS11
 #include STL_UNORDERED_MAP
 #else
@@ -60,6 +61,8 @@ namespace FORZE {
     private:
         struct fzActionHandler {
             Action *action;
+            UpdatePolicyProtocol *policy;
+            fzFloat skippedDt;
             bool isPaused;
             bool isStarted;
         };
@@ -96,8 +99,9 @@ namespace FORZE {
          If the target is already present, then the action will be added to the existing target.
          If the target is not present, a new instance of this target will be created either paused or paused, and the action will be added to the newly created target.
          When the target is paused, the queued actions won't be 'ticked'.
+         @param policy decides frame by frame if the action is stepped. NULL means always.
          */
-        void addAction(Action *action, void *target, bool paused);
+        void addAction(Action *action, void *target, bool paused, UpdatePolicyProtocol *policy = NULL);
         
         
         //! Gets an action given its tag an a target.
@@ -125,6 +129,16 @@ namespace FORZE {
         void resumeTarget(void *target);
         
         
+        //! Sets the update policy used by all the actions of the target.
+        //! @param policy NULL means that the actions are always stepped.
+        //! @see UpdatePolicyProtocol
+        void setUpdatePolicy(void *target, UpdatePolicyProtocol *policy);
+        
+        
+        //! Returns true if the action was added to the target and it was not done or removed yet.
+        bool isRunning(const Action *action, void *target) const;
+        
+        
         //! Removes an action.
         void removeAction(const Action* action);
         
@@ -35,12 +35,20 @@
 namespace FORZE {
     
     fzBuffer::fzBuffer(char *pointer, fzUInt length)
-    : p_ptr(pointer), m_len(length)
+    : p_ptr(pointer), m_len(length), m_isView(false)
     {
         FZ_ASSERT((pointer == NULL) == (length == 0), "If pointer is invalid, length must be 0.");
     }
     
     
+    fzBuffer fzBuffer::view(const char *pointer, fzUInt length)
+    {
+        fzBuffer buffer(const_cast<char*>(pointer), length);
+        buffer.m_isView = true;
+        return buffer;
+    }
+    
+    
     fzBuffer fzBuffer::copy() const
     {
         char *copy = new char[getLength()];
@@ -40,6 +40,7 @@ namespace FORZE
     private:
         char *p_ptr;
         fzUInt m_len;
+        bool m_isView;
         
     public:
         
@@ -55,6 +56,17 @@ namespace FORZE
         fzBuffer(char *pointer, fzUInt length);
         
         
+        //! Returns a buffer that points to memory owned by someone else, free() will not release it.
+        //! Used for the zero-copy reads of mapped archives, the memory must not be modified.
+        static fzBuffer view(const char *pointer, fzUInt length);
+        
+        
+        //! Returns true if the buffer does not own its memory.
+        bool isView() const {
+            return m_isView;
+        }
+        
+        
         //! Returns the buffer start constant pointer.
         const char* getPointer() const {
             return p_ptr;
@@ -75,7 +87,8 @@ namespace FORZE
         
         //! Releases the memory of the buffer and makes the buffer empty.
         void free() {
-            delete [] p_ptr;
+            if(!m_isView)
+                delete [] p_ptr;
             p_ptr = NULL;
             m_len = 0;
         }
@@ -31,6 +31,8 @@
 #include "FZAnimationCache.h"
 #include "FZSprite.h"
 #include "FZMacros.h"
+#include "FZMemoryManager.h"
+#include "FZResourceGroup.h"
 
 
 using namespace STD;
@@ -49,19 +51,51 @@ namespace FORZE {
     
     AnimationCache::AnimationCache()
     : m_animations()
-    { }
+    {
+        MemoryManager::Instance().addCache(this);
+    }
     
     
     void AnimationCache::addAnimation(Animation *animation, const char* name)
     {
-        m_animations.insert(animationPair(fzHash(name), animation));
+        FZ_ASSERT(animation != NULL, "Animation argument must be non-NULL.");
+        FZ_ASSERT(name != NULL, "Name argument must be non-NULL.");
+        
+        uint32_t hash = fzHash(name);
+        ResourceGroup::tag(kFZResource_Animation, hash);
+        
+        if(m_animations.insert(animationPair(hash, animation)).second)
+            animation->retain();
     }
     
     
     void AnimationCache::removeAnimationByName(const char* name)
     {
         FZ_ASSERT(name != NULL, "Name argument must be non-NULL.");
-        m_animations.erase(fzHash(name));
+        removeAnimationByHash(fzHash(name));
+    }
+    
+    
+    void AnimationCache::removeAnimationByHash(uint32_t hash)
+    {
+        animationMap::iterator it(m_animations.find(hash));
+        if(it != m_animations.end()) {
+            it->second->release();
+            m_animations.erase(it);
+        }
+    }
+    
+    
+    void AnimationCache::removeUnusedAnimations()
+    {
+        animationMap::iterator it(m_animations.begin());
+        for(; it != m_animations.end(); ) {
+            if(it->second->retainCount() <= 1) {
+                it->second->release();
+                m_animations.erase(it++);
+            }else
+                ++it;
+        }
     }
     
     
@@ -75,4 +109,28 @@ namespace FORZE {
         
         return it->second;
     }
+    
+    
+    const char* AnimationCache::getMemoryName() const
+    {
+        return "AnimationCache";
+    }
+    
+    
+    fzUInt AnimationCache::getMemoryUsage() const
+    {
+        fzUInt usage = 0;
+        animationMap::const_iterator it(m_animations.begin());
+        for(; it != m_animations.end(); ++it)
+            usage += sizeof(Animation) + it->second->getFrames().size() * sizeof(fzAnimationFrame);
+        
+        return usage;
+    }
+    
+    
+    void AnimationCache::releaseMemory(fzMemoryTier tier)
+    {
+        if(tier == kFZMemoryTier_Unused)
+            removeUnusedAnimations();
+    }
 }
@@ -32,6 +32,7 @@
  */
 
 #include "FZAnimation.h"
+#include "FZProtocols.h"
 #include STL_MAP
 #include STL_STRING
 
@@ -43,7 +44,7 @@ namespace FORZE {
     /** Singleton that manages the Animations.
      * It saves in a cache the animations. You should use this class if you want to save your animations in a cache.     
      */
-    class AnimationCache
+    class AnimationCache : public Protocol::Memory
     {
     private:
         // Simplified types
@@ -69,7 +70,7 @@ namespace FORZE {
         static AnimationCache& Instance();
         
         
-        //! Adds a Animation with a name.
+        //! Adds a Animation with a name. The animation is retained.
         void addAnimation(Animation *animation, const char* name);
         
         
@@ -77,10 +78,24 @@ namespace FORZE {
         void removeAnimationByName(const char* name);
         
         
+        //! Deletes a Animation from the cache given the hash of its name.
+        void removeAnimationByHash(uint32_t hash);
+        
+        
+        //! Removes the animations only retained by the cache.
+        void removeUnusedAnimations();
+        
+        
         //! Returns a Animation that was previously added.
         //! You should retain the returned copy if you are going to use it.
         //! @return NULL if the name is not found.
         Animation* getAnimationByName(const char* name) const;
+        
+        
+        // Protocol::Memory
+        const char* getMemoryName() const override;
+        fzUInt getMemoryUsage() const override;
+        void releaseMemory(fzMemoryTier tier) override;
     };
 }
 #endif
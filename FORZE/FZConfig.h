@@ -53,6 +53,7 @@
 #define STL_LIST <list>
 #define STL_MAP <map>
 #define STL_QUEUE <queue>
+#define STL_ALGORITHM <algorithm>
 #define STL_UNORDERED_MAP <unordered_map>
 #define STD std // Standard library's namespace (std by default)
 
@@ -135,14 +136,65 @@
 
 
 /** @def FZ_TEXTURE_NPOT_SUPPORT
- If enabled, NPOT textures will be used where available. Only 3rd gen (and newer) devices support NPOT textures.
+ If enabled, NPOT textures will be used where available (DeviceConfig::isNPOTSupported()). Only 3rd gen (and newer) devices support NPOT textures.
  NPOT textures have the following limitations:
  - They can't have mipmaps
  - They only accept GL_CLAMP_TO_EDGE in GL_TEXTURE_WRAP_{S,T}
+ When NPOT textures are not used, images are padded to POT by the GPU (glTexSubImage2D), never in RAM.
  
- To enable set it to a value different than 0. Disabled by default.
+ To disable set it to 0. Enabled by default.
+ */
+#define FZ_TEXTURE_NPOT_SUPPORT 1
+
+
+/** @def FZ_FONT_DISTANCE_FIELD_SIZE
+ * Line height in pixels used to rasterize TrueType fonts loaded as distance fields.
+ * Distance field fonts are rendered at any size from this single atlas.
+ */
+#define FZ_FONT_DISTANCE_FIELD_SIZE 32
+
+
+/** @def FZ_FONT_DISTANCE_FIELD_SPREAD
+ * Pixels around each glyph covered by the distance field, it limits the width of outlines and glows.
+ */
+#define FZ_FONT_DISTANCE_FIELD_SPREAD 4
+
+
+/** @def FZ_TMX_CHUNK_SIZE
+ * Width and height in tiles of the static meshes TMXLayer builds from the tile map.
+ * Chunks outside the screen are not rendered, bigger chunks mean less culling work but more overdraw.
+ */
+#define FZ_TMX_CHUNK_SIZE 32
+
+
+/** @def FZ_TMX_STREAMING_MARGIN
+ * Chunks around the screen kept built by streaming TMX maps, they are built before they become visible.
+ * Chunks further than this margin plus one are discarded.
+ */
+#define FZ_TMX_STREAMING_MARGIN 1
+
+
+/** @def FZ_TMX_CACHE
+ * If enabled, the parsed TMX maps are saved in binary form in the persistent path,
+ * the next loads skip the XML parsing, decoding and inflating while the TMX file does not change.
+ * To disable set it to 0. Enabled by default.
  */
-#define FZ_TEXTURE_NPOT_SUPPORT 0
+#define FZ_TMX_CACHE 1
+
+
+/** @def FZ_LIGHT_GRID_CELL_SIZE
+ * Size in points of the cells of the grid LightSystem uses to find the occluders near each light.
+ * It should be close to the light radius.
+ */
+#define FZ_LIGHT_GRID_CELL_SIZE 64
+
+
+/** @def FZ_LIGHT_ATLAS_MAX_SIZE
+ * Maximum width and height in pixels of the offscreen target LightSystem renders the lights to in atlas mode.
+ * The lights that do not fit are rendered in more passes.
+ * @see LightSystem::setAtlasMode()
+ */
+#define FZ_LIGHT_ATLAS_MAX_SIZE 2048
 
 
 /** @def FZ_IO_SUBFIX_CHAR
@@ -152,6 +204,26 @@
  */
 #define FZ_IO_SUBFIX_CHAR '@'
 
+
+/** @def FZ_RESOURCES_MANIFEST
+ * Name of the optional file, in the resources directory, that lists every resource (one relative path per line).
+ * If it exists, the ResourcesManager indexes it instead of scanning the resources directory.
+ */
+#define FZ_RESOURCES_MANIFEST "resources.manifest"
+
+
+/** @def FZ_EVENT_QUEUE_CAPACITY
+ * Number of events the OS wrapper can catch between two frames before the EventManager starts dropping them.
+ * It must be a power of two.
+ */
+#define FZ_EVENT_QUEUE_CAPACITY 256
+
+
+/** @def FZ_EVENT_MAX_ACTIVE
+ * Maximum number of events (touches, clicks, keys...) that can be tracked at the same time.
+ */
+#define FZ_EVENT_MAX_ACTIVE 32
+
 #define FZ_SPRITE_DEBUG_DRAW 0
 
 
@@ -135,8 +135,8 @@ namespace FORZE {
     }
     static bool __cmd_pevents(const char*,float*, int)
     {
-        const list<Event>& events = EventManager::Instance().getEvent();
-        list<Event>::const_iterator event(events.begin());
+        const vector<Event>& events = EventManager::Instance().getEvent();
+        vector<Event>::const_iterator event(events.begin());
         for(; event != events.end(); ++event)
             event->log();
         
@@ -148,8 +148,8 @@ namespace FORZE {
             const auto textures = TextureCache::Instance().getTextures();
             decltype(textures)::const_iterator it(textures.begin());
             for(; it != textures.end(); ++it) {
-                if(nuValues == 0 || (nuValues > 0 && values[0] == it->second->getName()))
-                    it->second->log();
+                if(nuValues == 0 || (nuValues > 0 && values[0] == it->second.texture->getName()))
+                    it->second.texture->log();
             }
         }else{
             
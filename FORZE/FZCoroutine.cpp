@@ -0,0 +1,134 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZCoroutine.h"
+#include "FZAction.h"
+#include "FZActionManager.h"
+#include "FZNode.h"
+#include "FZMacros.h"
+
+
+namespace FORZE {
+    
+    Coroutine::Coroutine()
+    : m_line(0)
+    , m_delay(0)
+    , m_dt(0)
+    , p_action(NULL)
+    , p_actionTarget(NULL)
+    , m_isRunning(false)
+    { }
+    
+    
+    Coroutine::~Coroutine()
+    {
+        releaseAction();
+    }
+    
+    
+    void Coroutine::releaseAction()
+    {
+        FZ_SAFE_RELEASE(p_action);
+        FZ_SAFE_RELEASE(p_actionTarget);
+    }
+    
+    
+    void Coroutine::start(fzUpdatePhase phase)
+    {
+        FZ_ASSERT(!m_isRunning, "The coroutine is already running.");
+        
+        m_line = 0;
+        m_delay = 0;
+        m_isRunning = true;
+        retain();
+        
+        Scheduler::Instance().scheduleSelector(SEL_FLOAT(Coroutine::step), this, 0, false, 2, phase);
+    }
+    
+    
+    void Coroutine::stop()
+    {
+        if(!m_isRunning)
+            return;
+        
+        if(p_action) {
+            ActionManager::Instance().removeAction(p_action);
+            releaseAction();
+        }
+        m_isRunning = false;
+        Scheduler::Instance().unscheduleSelector(SEL_FLOAT(Coroutine::step), this);
+        
+        // the coroutine could be deallocated here.
+        release();
+    }
+    
+    
+    void Coroutine::awaitDelay(fzFloat seconds)
+    {
+        FZ_ASSERT(seconds >= 0, "Delay must be positive.");
+        m_delay = seconds;
+    }
+    
+    
+    void Coroutine::awaitAction(Node *target, Action *action)
+    {
+        FZ_ASSERT(target, "Target can not be NULL.");
+        FZ_ASSERT(action, "Action can not be NULL.");
+        FZ_ASSERT(p_action == NULL, "Only one action can be awaited.");
+        FZ_ASSERT(action->getTarget() == NULL, "This action is already used.");
+        
+        action->retain();
+        target->retain();
+        p_action = action;
+        p_actionTarget = target;
+        
+        target->runAction(action);
+    }
+    
+    
+    void Coroutine::step(fzFloat dt)
+    {
+        m_dt = dt;
+        
+        if(m_delay > 0)
+            m_delay -= dt;
+        
+        if(p_action && !ActionManager::Instance().isRunning(p_action, p_actionTarget))
+            releaseAction();
+        
+        if(isReady()) {
+            // run() could stop the coroutine.
+            retain();
+            run();
+            if(m_line == -1)
+                stop();
+            release();
+        }
+    }
+}
@@ -0,0 +1,182 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZCOROUTINE_H_INCLUDED__
+#define __FZCOROUTINE_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZLifeCycle.h"
+#include "FZScheduler.h"
+
+
+namespace FORZE {
+    
+    class Node;
+    class Action;
+    
+    
+    /** Coroutine is a lightweight alternative to long trees of Sequence, CallFunc and DelayTime actions.
+     * The script is written in run() as plain sequential code. It is suspended at the await points and
+     * resumed by the Scheduler in the following frames.
+     * The coroutine is stackless: all the state is stored in the object itself, so a long script costs a single
+     * allocation instead of a tree of actions.
+     *
+     * @code
+     * class Intro : public Coroutine
+     * {
+     *     Sprite *p_hero;
+     *     int m_jumps;
+     *
+     *     void run() {
+     *         FZ_COROUTINE_BEGIN();
+     *         FZ_AWAIT_DELAY(1);
+     *         for(m_jumps = 0; m_jumps < 3; ++m_jumps)
+     *             FZ_AWAIT_ACTION(p_hero, new JumpBy(0.5f, fzPoint(100, 0), 50, 1));
+     *         FZ_AWAIT_UNTIL(m_doorOpened);
+     *         FZ_COROUTINE_END();
+     *     }
+     * };
+     * (new Intro())->start();
+     * @endcode
+     *
+     * @warning local variables are NOT preserved across await points, use member variables instead.
+     * @warning await points can not be used inside switch statements.
+     */
+    class Coroutine : public LifeCycle
+    {
+    private:
+        // resume point, -1 when finished
+        int m_line;
+        
+        // remaining delay in seconds
+        fzFloat m_delay;
+        
+        // delta time of the current step
+        fzFloat m_dt;
+        
+        // awaited action and its target, both retained during the await
+        Action *p_action;
+        Node *p_actionTarget;
+        
+        bool m_isRunning;
+        
+        //! Called by the Scheduler every frame.
+        void step(fzFloat dt);
+        
+        void releaseAction();
+        
+        
+    protected:
+        //! Override this method to write the script.
+        //! It must start with FZ_COROUTINE_BEGIN() and end with FZ_COROUTINE_END().
+        virtual void run() = 0;
+        
+        
+        //! Suspends the coroutine during the given number of seconds.
+        //! Use FZ_AWAIT_DELAY() instead.
+        void awaitDelay(fzFloat seconds);
+        
+        
+        //! Runs an action with the given target. The coroutine is suspended until the action is done.
+        //! The action runs in the ActionManager, it is paused with the target. The target is retained during the await,
+        //! if it is cleaned up the action is stopped and the coroutine is resumed.
+        //! Use FZ_AWAIT_ACTION() instead.
+        void awaitAction(Node *target, Action *action);
+        
+        
+        //! Returns true if the last awaited delay and action finished.
+        bool isReady() const {
+            return m_delay <= 0 && p_action == NULL;
+        }
+        
+        
+        //! Used by FZ_COROUTINE_* macros.
+        int& resumePoint() {
+            return m_line;
+        }
+        
+        
+    public:
+        //! Constructs a stopped coroutine.
+        Coroutine();
+        ~Coroutine();
+        
+        
+        //! Starts the coroutine. It is retained while it is running.
+        //! @param phase in which the coroutine is resumed.
+        void start(fzUpdatePhase phase = kFZUpdatePhase_Update);
+        
+        
+        //! Stops the coroutine, the awaited action is stopped too.
+        void stop();
+        
+        
+        //! Returns true if the coroutine is running.
+        bool isRunning() const {
+            return m_isRunning;
+        }
+        
+        
+        //! Returns the delta time of the current frame.
+        fzFloat getDelta() const {
+            return m_dt;
+        }
+    };
+    
+    
+//! @def FZ_COROUTINE_BEGIN
+//! Marks the beginning of Coroutine::run().
+#define FZ_COROUTINE_BEGIN() switch(resumePoint()) { case 0:
+    
+    
+//! @def FZ_COROUTINE_END
+//! Marks the end of Coroutine::run(). The coroutine is stopped.
+#define FZ_COROUTINE_END() } resumePoint() = -1; return
+    
+    
+//! @def FZ_YIELD
+//! Suspends the coroutine until the next frame.
+#define FZ_YIELD() do { resumePoint() = __LINE__; return; case __LINE__:; } while(0)
+    
+    
+//! @def FZ_AWAIT_UNTIL
+//! Suspends the coroutine until the condition is true. The condition is evaluated once per frame.
+#define FZ_AWAIT_UNTIL(__CONDITION__) do { resumePoint() = __LINE__; case __LINE__: if(!isReady() || !(__CONDITION__)) return; } while(0)
+    
+    
+//! @def FZ_AWAIT_DELAY
+//! Suspends the coroutine during the given number of seconds.
+#define FZ_AWAIT_DELAY(__SECONDS__) do { awaitDelay((__SECONDS__)); FZ_AWAIT_UNTIL(true); } while(0)
+    
+    
+//! @def FZ_AWAIT_ACTION
+//! Runs the action with the given target and suspends the coroutine until the action is done.
+#define FZ_AWAIT_ACTION(__TARGET__, __ACTION__) do { awaitAction((__TARGET__), (__ACTION__)); FZ_AWAIT_UNTIL(true); } while(0)
+    
+}
+#endif
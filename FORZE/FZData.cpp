@@ -86,7 +86,7 @@ namespace FORZE {
         unsigned int bufferSize = outLenghtHint;
         
         // ALLOC OUTPUT BUFFER
-        *output = new unsigned char[bufferSize];
+        *output = new(std::nothrow) unsigned char[bufferSize];
         if (!*output) {
             FZLOGERROR("ZIP: Memory alloc failed.");
             return Z_MEM_ERROR;
@@ -123,36 +123,72 @@ namespace FORZE {
                     inflateEnd(&d_stream);
                     return status;
             }
+            if (d_stream.avail_in == 0 && d_stream.avail_out > 0) {
+                // truncated stream
+                inflateEnd(&d_stream);
+                return Z_DATA_ERROR;
+            }
             
-            // REALLOC OUTPUT BUFFER
-            if (status != Z_STREAM_END) {
-                
+            // GROW OUTPUT BUFFER
+            // only reached when the hint was too small.
+            if (d_stream.avail_out == 0) {
                 unsigned char *tmp = new(std::nothrow) unsigned char[bufferSize * BUFFER_INC_FACTOR];
                 if (! tmp ) {
                     FZLOGERROR("ZIP: Memory realloc failed.");
                     inflateEnd(&d_stream);
                     return Z_MEM_ERROR;
                 }
-                memcpy(tmp, *output, bufferSize * BUFFER_INC_FACTOR);
+                memcpy(tmp, *output, bufferSize);
+                delete [] *output;
                 *output = tmp;
                 
                 d_stream.next_out = *output + bufferSize;
-                d_stream.avail_out = bufferSize;
+                d_stream.avail_out = bufferSize * (BUFFER_INC_FACTOR - 1);
                 bufferSize *= BUFFER_INC_FACTOR;                
             }
         }
         *outLength = bufferSize - d_stream.avail_out;
-        
-        // RELEASE UNUSED BUFFER MEMORY
         FZ_ASSERT(bufferSize >= *outLength, "Bad internal state.");
-//        if(bufferSize != *outLength)
-//            *output = (unsigned char*)realloc(*output, *outLength);
         
         status = inflateEnd(&d_stream);
         return status;
     }
     
     
+    bool Data::inflateZIPInto(const unsigned char *input, fzUInt inLength, unsigned char *output, fzUInt outLength)
+    {
+        FZ_ASSERT(input, "Input pointer cannot be NULL.");
+        FZ_ASSERT(output, "Output pointer cannot be NULL.");
+
+        z_stream d_stream;
+        d_stream.zalloc = (alloc_func)0;
+        d_stream.zfree = (free_func)0;
+        d_stream.opaque = (voidpf)0;
+        d_stream.next_in  = const_cast<Bytef*>(input);
+        d_stream.avail_in = inLength;
+        d_stream.next_out = output;
+        d_stream.avail_out = outLength;
+        
+        // zlib or gzip, automatic header detection
+        int status = inflateInit2(&d_stream, 15 + 32);
+        if( status != Z_OK ) {
+            FZLOGERROR("ZIP: Inflate initialization failed. Error code: %d.", status);
+            return false;
+        }
+        
+        // the whole output is available, so a single call inflates everything
+        status = inflate(&d_stream, Z_FINISH);
+        fzUInt inflated = outLength - d_stream.avail_out;
+        inflateEnd(&d_stream);
+        
+        if(status != Z_STREAM_END || inflated != outLength) {
+            FZLOGERROR("ZIP: Inflated length mismatch or corrupted data. Error code: %d.", status);
+            return false;
+        }
+        return true;
+    }
+    
+    
     fzBuffer Data::inflateZIPWithHint(unsigned char *input, unsigned int inLength, unsigned int outLengthHint)
     {
         unsigned int outLength = 0;
@@ -190,9 +226,12 @@ namespace FORZE {
     }
     
     
-    fzBuffer Data::inflateCCZ(unsigned char *input, unsigned int inLength)
+    fzUInt Data::getCCZLength(const unsigned char *input, fzUInt inLength)
     {
-        // load file into memory
+        if(input == NULL || inLength < sizeof(CCZHeader)) {
+            FZLOGERROR("IO:CCZ: Invalid CCZ file.");
+            return 0;
+        }
         const CCZHeader *header = reinterpret_cast<const CCZHeader*>(input);
         
         
@@ -202,45 +241,52 @@ namespace FORZE {
              header->sig[2] == 'Z' &&
              header->sig[3] == '!')) {
             FZLOGERROR("IO:CCZ: Invalid CCZ file.");
-            return fzBuffer::empty();
+            return 0;
         }
         
         
         // verify header version
         if( fzBitOrder_int16BigToHost(header->version) > 2 ) {
             FZLOGERROR("IO:CCZ: Unsupported version.");
-            return fzBuffer::empty();
+            return 0;
         }
         
         
         // verify compression format
         if( fzBitOrder_int16BigToHost(header->compression_type) != CCZ_COMPRESSION_ZLIB ) {
             FZLOGERROR("IO:CCZ: Unsupported compression method.");
-            return fzBuffer::empty();
+            return 0;
         }
         
+        return fzBitOrder_int32BigToHost( header->len );
+    }
+    
+    
+    bool Data::inflateCCZInto(const unsigned char *input, fzUInt inLength, unsigned char *output, fzUInt outLength)
+    {
+        FZ_ASSERT(getCCZLength(input, inLength) == outLength, "Output length must match the CCZ length.");
         
-        uLong fileLen = inLength-1;
-        uint32_t expectedLen = fzBitOrder_int32BigToHost( header->len );
-        uLongf realLen = expectedLen;
-        
-        char *contentData = new char[expectedLen];
-        uLongf source = (uLongf)input + sizeof(CCZHeader);
+        return inflateZIPInto(input + sizeof(CCZHeader), inLength - sizeof(CCZHeader), output, outLength);
+    }
+    
+    
+    fzBuffer Data::inflateCCZ(unsigned char *input, unsigned int inLength)
+    {
+        fzUInt expectedLen = getCCZLength(input, inLength);
+        if(expectedLen == 0)
+            return fzBuffer::empty();
         
+        char *contentData = new(std::nothrow) char[expectedLen];
+        if(contentData == NULL) {
+            FZLOGERROR("IO:CCZ: Impossible to allocate memory.");
+            return fzBuffer::empty();
+        }
         
-        int ret = uncompress((Bytef*)contentData,
-                             &realLen,
-                             (Bytef*)source,
-                             (uLong)(fileLen - sizeof(CCZHeader))
-                             );
-                
-        if( ret != Z_OK ) {
-            FZLOGERROR("IO:CCZ: Failed to uncompress data. Error code: %d.", ret);
+        if(!inflateCCZInto(input, inLength, (unsigned char*)contentData, expectedLen)) {
+            FZLOGERROR("IO:CCZ: Failed to uncompress data.");
             delete [] contentData;
             return fzBuffer::empty();
         }
-        FZ_ASSERT(realLen <= expectedLen, "Corrupted .CCZ. The expected uncompressed data length is wrong. Buffer overflow occurred.");
-        
         return fzBuffer(contentData, expectedLen);
     }
     
@@ -275,8 +321,9 @@ namespace FORZE {
         char *output = new(std::nothrow) char[outputSize];
         
         if( output ) {
-            Base64decode(output, input);
-            return fzBuffer(output, outputSize);
+            // Base64decode_len() is an upper bound, the buffer length is the decoded one.
+            fzUInt decodedSize = Base64decode(output, input);
+            return fzBuffer(output, decodedSize);
             
         }else{
             FZLOGERROR("Base64: error allocating memory.");
@@ -52,7 +52,8 @@ namespace FORZE {
     public:
         //! Decodes a 64base encoded memory. The decoded memory is
         //! expected to be freed by the caller.
-        //! @return the length of the out buffer
+        //! @return the decoded memory, its length is the number of decoded bytes
+        //! and it is followed by a '\0'.
         static fzBuffer B64Decode(const char *input, fzUInt inLength);
         
         
@@ -63,12 +64,29 @@ namespace FORZE {
         
         
         //! Inflates a CCZ data.
+        //! The output buffer is allocated once, with the uncompressed length stored in the CCZ header.
         static fzBuffer inflateCCZ(unsigned char *input, unsigned int inLength);
         
         
+        //! Returns the uncompressed length stored in the CCZ header, 0 if the data is not a valid CCZ.
+        static fzUInt getCCZLength(const unsigned char *input, fzUInt inLength);
+        
+        
+        //! Inflates a CCZ data into the output buffer, that must be exactly getCCZLength() bytes long.
+        //! @return false if the data is corrupted or its length does not match.
+        static bool inflateCCZInto(const unsigned char *input, fzUInt inLength, unsigned char *output, fzUInt outLength);
+        
+        
+        //! Inflates either zlib or gzip deflated memory straight into the output buffer (a texture staging
+        //! buffer or a tiles array for example), no intermediate buffer is allocated.
+        //! @return false if the data is corrupted or the inflated length is not exactly outLength.
+        static bool inflateZIPInto(const unsigned char *input, fzUInt inLength, unsigned char *output, fzUInt outLength);
+        
+        
         //! Inflates either zlib or gzip deflated memory. The inflated memory is
-        //! expected to be freed by the caller. It will allocate 256k for the destination buffer.
+        //! expected to be freed by the caller. It will allocate 128k for the destination buffer.
         //! If it is not enought it will multiply the previous buffer size per 2, until there is enough memory.
+        //! Use inflateZIPInto() when the inflated length is known.
         //! @return the length of the deflated buffer.
         static fzBuffer inflateZIP(unsigned char *input, unsigned int inLength);
         
@@ -35,6 +35,7 @@
 #include "FZDataStore.h"
 #include "FZIO.h"
 #include "FZData.h"
+#include "FZMemoryManager.h"
 #include "external/rapidxml/rapidxml.hpp"
 #include "external/rapidxml/rapidxml_print.hpp"
 
@@ -65,6 +66,7 @@ namespace FORZE {
     , m_num(0)
     , m_capacity(0)
     , m_dirty(false)
+    , m_isLoaded(true)
     {
         {
             char buffer[1024];
@@ -83,6 +85,8 @@ namespace FORZE {
             FZLOGERROR(error.what());
             fzOSW_removePath(p_path);
         }
+        
+        MemoryManager::Instance().addCache(this);
     }
     
     
@@ -164,10 +168,53 @@ namespace FORZE {
             fputs("</" XML_ENTRY_TAG">\n", f);
         }
         fclose(f);
+        m_dirty = false;
         return true;
     }
     
     
+    bool DataStore::unload()
+    {
+        if(!m_isLoaded)
+            return true;
+        
+        if(!save())
+            return false;
+        
+        for(fzUInt i = 0; i < m_num; ++i) {
+            fzStoreEntry& entry = p_store[i];
+            delete entry.key;
+            
+            if(entry.type == kFZData_string || entry.type == kFZData_data)
+                entry.data.free();
+        }
+        free(p_store);
+        p_store = NULL;
+        m_num = 0;
+        m_capacity = 0;
+        m_isLoaded = false;
+        
+        return true;
+    }
+    
+    
+    void DataStore::load() const
+    {
+        if(m_isLoaded)
+            return;
+        
+        // the entries are a cache of the file, reloading them does not change the store.
+        DataStore *store = const_cast<DataStore*>(this);
+        store->m_isLoaded = true;
+        try {
+            store->readFromMemory();
+            
+        } catch(std::exception& error) {
+            FZLOGERROR(error.what());
+        }
+    }
+    
+    
     void DataStore::readFromMemory()
     {
         FZ_ASSERT(p_path, "Path cannot be NULL.");
@@ -257,6 +304,8 @@ namespace FORZE {
     
     DataStore::fzStoreEntry* DataStore::entryForHash(uint32_t keyhash) const
     {
+        load();
+        
         if(m_num == 0)
             return NULL;
         
@@ -278,6 +327,7 @@ namespace FORZE {
     
     void DataStore::setEntry(const fzStoreEntry& entry)
     {
+        load();
         fzStoreEntry *current = entryForHash(entry.hash);
         removeEntry(current);
         
@@ -480,5 +530,31 @@ namespace FORZE {
     {
         FZLog("NOT IMPLEMENTED");
     }
-
+    
+    
+    const char* DataStore::getMemoryName() const
+    {
+        return "DataStore";
+    }
+    
+    
+    fzUInt DataStore::getMemoryUsage() const
+    {
+        fzUInt usage = m_capacity * sizeof(fzStoreEntry);
+        for(fzUInt i = 0; i < m_num; ++i) {
+            const fzStoreEntry& entry = p_store[i];
+            usage += strlen(entry.key) + 1;
+            
+            if(entry.type == kFZData_string || entry.type == kFZData_data)
+                usage += entry.data.getLength();
+        }
+        return usage;
+    }
+    
+    
+    void DataStore::releaseMemory(fzMemoryTier tier)
+    {
+        if(tier == kFZMemoryTier_Reloadable)
+            unload();
+    }
 }
@@ -33,11 +33,12 @@
 
 #include "FZTypes.h"
 #include "FZAllocator.h"
+#include "FZProtocols.h"
 
 
 namespace FORZE {
     
-    class DataStore
+    class DataStore : public Protocol::Memory
     {
     private:
         enum {
@@ -75,6 +76,9 @@ namespace FORZE {
         // is data dirty
         bool m_dirty;
         
+        // false if the entries were released to save memory, they are read again on demand.
+        bool m_isLoaded;
+        
         // data base absolute path.
         const char *p_path;
         
@@ -96,6 +100,9 @@ namespace FORZE {
         //! Low level way to remove entries.
         void removeEntry(fzStoreEntry *entry);
         
+        //! Reads the entries again if they were unloaded.
+        void load() const;
+        
         
     protected:
         DataStore();
@@ -199,6 +206,19 @@ namespace FORZE {
         //! FORZE saves the data automatically.
         //! @return false if data could not be saved. Change to debug mode.
         bool save();
+        
+        
+        //! Saves the data and releases the memory used by the entries.
+        //! They are read again from disk the next time the DataStore is accessed.
+        //! @warning the pointers returned by stringForKey() become invalid.
+        //! @return false if the data could not be saved, in that case nothing is released.
+        bool unload();
+        
+        
+        // Protocol::Memory
+        const char* getMemoryName() const override;
+        fzUInt getMemoryUsage() const override;
+        void releaseMemory(fzMemoryTier tier) override;
     };
 }
 #endif
@@ -57,6 +57,8 @@
 #include "FZHUD.h"
 #include "FZTransitions.h"
 #include "FZPerformManager.h"
+#include "FZPrefetchManager.h"
+#include "FZMemoryManager.h"
 
 
 using namespace STD;
@@ -669,6 +671,8 @@ namespace FORZE {
         m_scenesStack.push_back(scene);
         scene->retain();
         p_nextScene = scene;
+        
+        PrefetchManager::Instance().sceneWillEnter(scene);
     }
     
     
@@ -685,6 +689,8 @@ namespace FORZE {
         scene->retain();
         
         p_nextScene = scene;
+        
+        PrefetchManager::Instance().sceneWillEnter(scene);
     }
     
     
@@ -777,7 +783,7 @@ namespace FORZE {
         
         // SCHEDULE
         if(!m_isPaused)
-            Scheduler::Instance().tick( m_dt );
+            Scheduler::Instance().tick( m_dt, kFZUpdatePhase_Input, kFZUpdatePhase_PostUpdate );
         
         // UPDATE PROJECTION
         if(m_dirtyFlags)
@@ -787,6 +793,10 @@ namespace FORZE {
         if(p_nextScene)
             setNextScene();
         
+        // PRE-RENDER SCHEDULE
+        if(!m_isPaused)
+            Scheduler::Instance().tick( m_dt, kFZUpdatePhase_PreRender, kFZUpdatePhase_PreRender );
+        
 
         // RENDERING
 #if FZ_RENDER_ON_DEMAND
@@ -1037,9 +1047,8 @@ namespace FORZE {
     {
         FZ_ASSERT(p_appdelegate, "FORZE was not initialized properly. App delegate is missing.");
 
-        TextureCache::Instance().removeUnusedTextures();
-        FontCache::Instance().removeUnusedFonts();
         FZLOGINFO("Director: Memory warning.");
+        MemoryManager::Instance().didReceiveMemoryWarning();
     }
     
     
@@ -121,6 +121,7 @@ namespace FORZE {
         friend class Node;
         friend class EventManager;
         friend class Accelerometer;
+        friend class Font;
     private:
         
 #if FZ_RENDER_ON_DEMAND
@@ -0,0 +1,153 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "FZDistanceField.h"
+#include "FZMacros.h"
+#include "FZMath.h"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include STL_VECTOR
+
+
+using namespace STD;
+
+namespace FORZE {
+    
+    // dst[i] = min(dst[i], src[i] + add)
+    static void minAdd(float *__restrict__ dst, const float *__restrict__ src, float add, fzUInt count)
+    {
+        fzUInt i = 0;
+        
+#if defined(__ARM_NEON__)
+        float32x4_t vadd = vdupq_n_f32(add);
+        for(; i + 4 <= count; i += 4)
+            vst1q_f32(dst + i, vminq_f32(vld1q_f32(dst + i), vaddq_f32(vld1q_f32(src + i), vadd)));
+        
+#elif defined(__SSE__)
+        __m128 vadd = _mm_set1_ps(add);
+        for(; i + 4 <= count; i += 4)
+            _mm_storeu_ps(dst + i, _mm_min_ps(_mm_loadu_ps(dst + i), _mm_add_ps(_mm_loadu_ps(src + i), vadd)));
+#endif
+        
+        for(; i < count; ++i) {
+            float value = src[i] + add;
+            if(value < dst[i])
+                dst[i] = value;
+        }
+    }
+    
+    
+    // Squared distance transform limited to "radius" pixels: D(x, y) = min(f(x+i, y+j) + i*i + j*j)
+    static void distanceTransform(float *field, float *tmp, fzInt width, fzInt height, fzInt radius)
+    {
+        const fzUInt size = width * height;
+        
+        // horizontal pass: field -> tmp
+        memcpy(tmp, field, size * sizeof(float));
+        for(fzInt k = 1; k <= radius && k < width; ++k) {
+            const float add = (float)(k * k);
+            for(fzInt y = 0; y < height; ++y) {
+                float *dst = tmp + y * width;
+                const float *src = field + y * width;
+                minAdd(dst, src + k, add, width - k);   // right neighbours
+                minAdd(dst + k, src, add, width - k);   // left neighbours
+            }
+        }
+        
+        // vertical pass: tmp -> field
+        memcpy(field, tmp, size * sizeof(float));
+        for(fzInt k = 1; k <= radius && k < height; ++k) {
+            const float add = (float)(k * k);
+            for(fzInt y = 0; y < height - k; ++y) {
+                minAdd(field + y * width, tmp + (y + k) * width, add, width);         // bottom neighbours
+                minAdd(field + (y + k) * width, tmp + y * width, add, width);         // top neighbours
+            }
+        }
+    }
+    
+    
+    void DistanceField::generate(const uint8_t *coverage, fzUInt width, fzUInt height, fzUInt stride,
+                                 uint8_t *output, fzFloat spread)
+    {
+        FZ_ASSERT(coverage != NULL && output != NULL, "Bitmaps can not be NULL.");
+        FZ_ASSERT(spread > 0, "Spread must be positive.");
+        
+        if(width == 0 || height == 0)
+            return;
+        
+        const fzInt radius = (fzInt)ceilf(spread) + 1;
+        const float infinity = (float)(radius * radius * 2 + 1);
+        const fzUInt size = width * height;
+        
+        // outside: distance to the nearest inside pixel, inside: distance to the nearest outside pixel.
+        vector<float> outside(size), inside(size), tmp(size);
+        for(fzUInt y = 0; y < height; ++y) {
+            const uint8_t *row = coverage + y * stride;
+            for(fzUInt x = 0; x < width; ++x) {
+                bool isInside = row[x] >= 128;
+                outside[y * width + x] = isInside ? 0 : infinity;
+                inside[y * width + x] = isInside ? infinity : 0;
+            }
+        }
+        distanceTransform(&outside[0], &tmp[0], width, height, radius);
+        distanceTransform(&inside[0], &tmp[0], width, height, radius);
+        
+        
+        const fzFloat scale = 1.0f / (2 * spread);
+        for(fzUInt y = 0; y < height; ++y)
+        {
+            const uint8_t *row = coverage + y * stride;
+            uint8_t *out = output + y * stride;
+            for(fzUInt x = 0; x < width; ++x)
+            {
+                // signed distance to the edge, positive outside.
+                // the antialiased pixels already know where the edge is.
+                fzFloat distance;
+                fzUInt p = y * width + x;
+                if(row[x] > 0 && row[x] < 255)
+                    distance = 0.5f - row[x] / 255.0f;
+                else if(row[x] == 0)
+                    distance = sqrtf(outside[p]) - 0.5f;
+                else
+                    distance = 0.5f - sqrtf(inside[p]);
+                
+                fzFloat value = 0.5f - distance * scale;
+                out[x] = (uint8_t)(fzMin<fzFloat>(fzMax<fzFloat>(value, 0), 1) * 255.0f + 0.5f);
+            }
+        }
+    }
+}
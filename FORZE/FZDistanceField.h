@@ -0,0 +1,57 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZDISTANCEFIELD_H_INCLUDED__
+#define __FZDISTANCEFIELD_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZTypes.h"
+
+
+namespace FORZE {
+    
+    /** DistanceField converts antialiased coverage bitmaps (glyphs) into signed distance fields.
+     * A distance field can be scaled with a simple threshold in the fragment shader and stays crisp,
+     * outlines and glows are just other thresholds (see kFZShader_mat_aC4_SDF).
+     *
+     * The squared euclidean distance is computed with two separable passes limited to the spread,
+     * both passes are min(dst, src + k*k) over whole rows, so they run with NEON/SSE.
+     */
+    class DistanceField
+    {
+    public:
+        //! Generates the distance field of a 8 bits coverage bitmap (0 outside, 255 inside).
+        //! The output is 128 at the edge, it reaches 255 inside and 0 outside "spread" pixels away from it.
+        //! The bitmap should have "spread" pixels of padding at every side.
+        //! @param stride is the row size in bytes of both, the coverage and the output.
+        //! @param output can be the coverage bitmap itself.
+        static void generate(const uint8_t *coverage, fzUInt width, fzUInt height, fzUInt stride,
+                             uint8_t *output, fzFloat spread);
+    };
+}
+#endif
@@ -27,15 +27,167 @@
  @author Manuel Martínez-Almeida
  */
 
+#include <string.h>
+
 #include "FZEventManager.h"
 #include "FZDirector.h"
 #include "FZMacros.h"
+#include STL_ALGORITHM
+
+// The ring is built on the compiler's atomic builtins (GCC 4.7+ and clang), they do not depend on the STL.
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#define FZ_EVENT_QUEUE_LOCKFREE 1
+#else
+#define FZ_EVENT_QUEUE_LOCKFREE 0
 #include "external/tinythread/tinythread.h"
+#endif
 
 using namespace STD;
 
 namespace FORZE {
+    
+#if FZ_EVENT_QUEUE_LOCKFREE
+    
+    // Bounded lock-free queue (Vyukov's sequenced ring).
+    // Every slot carries a sequence number, so producers only compete for the head index
+    // and the consumer (the main thread) never writes the head. The OS wrapper is the usual producer,
+    // but the console thread and cancelAllEvents() can push events too.
+    struct fzEventQueue
+    {
+        struct fzEventSlot
+        {
+            fzUInt sequence;
+            Event event;
+            
+            fzEventSlot()
+            : sequence(0)
+            , event(NULL, 0, kFZEventType_All, kFZEventState_Indifferent)
+            {}
+        };
+        
+        fzEventSlot slots[FZ_EVENT_QUEUE_CAPACITY];
+        fzUInt head;
+        fzUInt tail;
+        bool enabled;
+        
+        fzEventQueue()
+        : head(0)
+        , tail(0)
+        , enabled(true)
+        {
+            for(fzUInt i = 0; i < FZ_EVENT_QUEUE_CAPACITY; ++i)
+                __atomic_store_n(&slots[i].sequence, i, __ATOMIC_RELAXED);
+        }
+        
+        void setEnabled(bool isEnabled)
+        {
+            __atomic_store_n(&enabled, isEnabled, __ATOMIC_RELAXED);
+        }
+        
+        bool isEnabled() const
+        {
+            return __atomic_load_n(&enabled, __ATOMIC_RELAXED);
+        }
+        
+        bool push(const Event& event)
+        {
+            fzEventSlot *slot;
+            fzUInt pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+            for(;;) {
+                slot = &slots[pos & (FZ_EVENT_QUEUE_CAPACITY-1)];
+                fzInt diff = (fzInt)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - pos);
+                if(diff == 0) {
+                    // on failure pos is updated with the current head
+                    if(__atomic_compare_exchange_n(&head, &pos, pos+1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                        break;
+                }
+                else if(diff < 0)
+                    return false; // full
+                else
+                    pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+            }
+            slot->event = event;
+            __atomic_store_n(&slot->sequence, pos+1, __ATOMIC_RELEASE);
+            return true;
+        }
+        
+        bool pop(Event& event)
+        {
+            fzEventSlot *slot = &slots[tail & (FZ_EVENT_QUEUE_CAPACITY-1)];
+            fzInt diff = (fzInt)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - (tail+1));
+            if(diff < 0)
+                return false; // empty
+            
+            event = slot->event;
+            __atomic_store_n(&slot->sequence, tail + FZ_EVENT_QUEUE_CAPACITY, __ATOMIC_RELEASE);
+            ++tail;
+            return true;
+        }
+    };
+    
+#else
+    
+    // Bounded ring protected by a mutex, used when the compiler has no atomic builtins.
+    // The critical sections only copy one event, the producers rarely wait.
+    struct fzEventQueue
+    {
+        struct fzEventSlot
+        {
+            Event event;
+            
+            fzEventSlot()
+            : event(NULL, 0, kFZEventType_All, kFZEventState_Indifferent)
+            {}
+        };
+        
+        fzEventSlot slots[FZ_EVENT_QUEUE_CAPACITY];
+        fzUInt head;
+        fzUInt tail;
+        volatile bool enabled;
+        mutex guard;
+        
+        fzEventQueue()
+        : head(0)
+        , tail(0)
+        , enabled(true)
+        {}
+        
+        void setEnabled(bool isEnabled)
+        {
+            enabled = isEnabled;
+        }
+        
+        bool isEnabled() const
+        {
+            return enabled;
+        }
+        
+        bool push(const Event& event)
+        {
+            guard.lock();
+            bool full = (head - tail) == FZ_EVENT_QUEUE_CAPACITY;
+            if(!full)
+                slots[(head++) & (FZ_EVENT_QUEUE_CAPACITY-1)].event = event;
+            
+            guard.unlock();
+            return !full;
+        }
         
+        bool pop(Event& event)
+        {
+            guard.lock();
+            bool empty = (head == tail);
+            if(!empty)
+                event = slots[(tail++) & (FZ_EVENT_QUEUE_CAPACITY-1)].event;
+            
+            guard.unlock();
+            return !empty;
+        }
+    };
+    
+#endif
+    
+    
     bool EventDelegate::event(Event&)
     {
         FZLOGERROR("EventDelegate: bool event(Event&) should be overwritten.");
@@ -43,6 +195,8 @@ namespace FORZE {
     }
     
 #define FZEVENT_INTERNAL_MASK (kFZEventType_Stick-1)
+#define FZEVENT_TABLE_SIZE (FZ_EVENT_MAX_ACTIVE * 2)
+#define FZEVENT_PENDING_TABLE_SIZE (FZ_EVENT_QUEUE_CAPACITY * 2)
     
     EventManager* EventManager::p_instance = NULL;
     
@@ -59,29 +213,35 @@ namespace FORZE {
     : m_events()
     , m_handlers(0)
     , m_flags(0)
-    , m_enabled(true)
+    , m_coalesceLatest(kFZEventType_MouseMoved | kFZEventType_Trackpad | kFZEventType_Accelerometer | kFZEventType_Gyro)
+    , m_coalesceHistory(0)
     {
-        p_mutex = new recursive_mutex();
+        FZ_ASSERT((FZ_EVENT_QUEUE_CAPACITY & (FZ_EVENT_QUEUE_CAPACITY-1)) == 0, "FZ_EVENT_QUEUE_CAPACITY must be a power of two.");
+        FZ_ASSERT(FZ_EVENT_QUEUE_CAPACITY < INT16_MAX, "FZ_EVENT_QUEUE_CAPACITY is too big.");
+        FZ_ASSERT(FZ_EVENT_MAX_ACTIVE < INT16_MAX, "FZ_EVENT_MAX_ACTIVE is too big.");
+
+        p_queue = new fzEventQueue();
+        m_events.reserve(FZ_EVENT_MAX_ACTIVE);
+        m_pending.reserve(FZ_EVENT_QUEUE_CAPACITY);
+        rebuildTable();
     }
     
     
     EventManager::~EventManager()
     {
-        delete p_mutex;
+        delete p_queue;
     }
     
     
     void EventManager::setIsEnabled(bool isEnabled)
     {
-        p_mutex->lock();
-        m_enabled = isEnabled;
-        p_mutex->unlock();
+        p_queue->setEnabled(isEnabled);
     }
     
     
     bool EventManager::isEnabled() const
     {
-        return m_enabled;
+        return p_queue->isEnabled();
     }
     
     
@@ -228,7 +388,75 @@ namespace FORZE {
     }
     
     
-    Event* EventManager::addEvent(const Event& newEvent)
+    void EventManager::setCoalescing(uint16_t types, fzEventCoalescing mode)
+    {
+        m_coalesceLatest &= ~types;
+        m_coalesceHistory &= ~types;
+        
+        switch (mode) {
+            case kFZEventCoalescing_None: break;
+            case kFZEventCoalescing_Latest: m_coalesceLatest |= types; break;
+            case kFZEventCoalescing_History: m_coalesceHistory |= types; break;
+            default: FZ_ASSERT(false, "Invalid coalescing mode."); break;
+        }
+    }
+    
+    
+    fzEventCoalescing EventManager::getCoalescing(fzEventType type) const
+    {
+        if(m_coalesceHistory & type)
+            return kFZEventCoalescing_History;
+        if(m_coalesceLatest & type)
+            return kFZEventCoalescing_Latest;
+        
+        return kFZEventCoalescing_None;
+    }
+    
+    
+    static fzUInt hashSource(void *owner, intptr_t identifier)
+    {
+        uintptr_t hash = ((uintptr_t)owner >> 4) ^ ((uintptr_t)identifier * 2654435761u);
+        return (fzUInt)(hash ^ (hash >> 16));
+    }
+    
+    
+    fzUInt EventManager::hashEvent(const Event& event) const
+    {
+        return hashSource(event.getOwner(), event.getIdentifier()) & (FZEVENT_TABLE_SIZE-1);
+    }
+    
+    
+    Event* EventManager::findEvent(const Event& event)
+    {
+        fzUInt index = hashEvent(event);
+        for(; m_eventsTable[index] >= 0; index = (index+1) & (FZEVENT_TABLE_SIZE-1))
+        {
+            Event *e = &m_events[m_eventsTable[index]];
+            if(event.getIdentifier() == e->getIdentifier() &&
+               event.getOwner() == e->getOwner() &&
+               event.getType() == e->getType())
+                return e;
+        }
+        return NULL;
+    }
+    
+    
+    void EventManager::rebuildTable()
+    {
+        memset(m_eventsTable, -1, sizeof(m_eventsTable));
+        
+        fzUInt count = m_events.size();
+        for(fzUInt i = 0; i < count; ++i) {
+            fzUInt index = hashEvent(m_events[i]);
+            while(m_eventsTable[index] >= 0)
+                index = (index+1) & (FZEVENT_TABLE_SIZE-1);
+            
+            m_eventsTable[index] = i;
+        }
+    }
+    
+    
+    Event* EventManager::addEvent(Event& newEvent)
     {
         FZ_ASSERT(newEvent.getOwner(), "Event owner can not be NULL.");
 
@@ -237,23 +465,31 @@ namespace FORZE {
             
         switch (newEvent.getState())
         {
-            case kFZEventState_Began:
-#if FORZE_DEBUG > 0
+            case kFZEventState_Indifferent:
             {
-                eventList::const_iterator it(m_events.begin());
-                for(; it != m_events.end(); ++it) {
-                    if(newEvent.getIdentifier() == it->getIdentifier() &&
-                       newEvent.getOwner() == it->getOwner())
-                    {
-                        FZLOGERROR("EventManager: Event duplicated:");
-                        it->log();
-                    }
-                }
+                // Indifferent events are dispatched once, they don't need to be tracked.
+                FZ_ASSERT(newEvent.getDelegate() == NULL, "Event delegate should be NULL.");
+                return &newEvent;
             }
-#endif
-            case kFZEventState_Indifferent:
+            case kFZEventState_Began:
             {
                 FZ_ASSERT(newEvent.getDelegate() == NULL, "Event delegate should be NULL.");
+#if FORZE_DEBUG > 0
+                Event *duplicated = findEvent(newEvent);
+                if(duplicated) {
+                    FZLOGERROR("EventManager: Event duplicated:");
+                    duplicated->log();
+                }
+#endif
+                if(m_events.size() >= FZ_EVENT_MAX_ACTIVE) {
+                    FZLOGERROR("EventManager: Too many active events, FZ_EVENT_MAX_ACTIVE should be increased.");
+                    return NULL;
+                }
+                fzUInt index = hashEvent(newEvent);
+                while(m_eventsTable[index] >= 0)
+                    index = (index+1) & (FZEVENT_TABLE_SIZE-1);
+                
+                m_eventsTable[index] = m_events.size();
                 m_events.push_back(newEvent);
                 return &(m_events.back());
             }
@@ -261,18 +497,11 @@ namespace FORZE {
             case kFZEventState_Ended:
             case kFZEventState_Cancelled:
             {
-                eventList::iterator it(m_events.begin());
-                for(; it != m_events.end(); ++it) {
-                    Event *e = &(*it);
-                    if(newEvent.getIdentifier() == e->getIdentifier() &&
-                       newEvent.getOwner() == e->getOwner() &&
-                       newEvent.getType() == e->getType())
-                    {
-                        e->update(newEvent);
-                        return e;
-                    }
-                }
-                return NULL;
+                Event *e = findEvent(newEvent);
+                if(e)
+                    e->update(newEvent);
+                
+                return e;
             }
             default:
             {
@@ -285,13 +514,9 @@ namespace FORZE {
     
     void EventManager::catchEvent(const Event& newEvent)
     {
-        p_mutex->lock();
-        
         // the events are cached in order to dispatch them correctly.
-        if(m_enabled)
-            m_buffer.push(newEvent);
-        
-        p_mutex->unlock();
+        if(isEnabled() && !p_queue->push(newEvent))
+            FZLOGERROR("EventManager: Event queue is full, FZ_EVENT_QUEUE_CAPACITY should be increased.");
     }
     
     
@@ -307,89 +532,183 @@ namespace FORZE {
     }
     
     
-    void EventManager::dispatchEvents()
+    bool EventManager::isSameSource(const Event& a, const Event& b)
     {
-        p_mutex->lock();
-        while(!m_buffer.empty())
+        return (a.getOwner() == b.getOwner() &&
+                a.getType() == b.getType() &&
+                (a.getState() == kFZEventState_Indifferent || a.getIdentifier() == b.getIdentifier()));
+    }
+    
+    
+    bool EventManager::collectEvents()
+    {
+        // Samples are collapsed into the previous one only if it is the latest pending event of the same source,
+        // both have the same state and only samples of the same type were queued after it.
+        // So Began, Ended and Cancelled are never lost and events are never reordered.
+        uint16_t coalesced = m_coalesceLatest | m_coalesceHistory;
+        if(coalesced)
+            memset(m_pendingTable, -1, sizeof(m_pendingTable));
+        
+        // trailing run of samples of the same type at the end of m_pending
+        fzUInt runStart = m_pending.size();
+        uint16_t runType = 0;
+        
+        Event event(NULL, 0, kFZEventType_All, kFZEventState_Indifferent);
+        while(m_pending.size() < FZ_EVENT_QUEUE_CAPACITY && p_queue->pop(event))
         {
-            Event *event = addEvent(m_buffer.front());
+            bool isSample = ((event.getType() & coalesced) && event.getOwner() != this &&
+                             (event.getState() == kFZEventState_Updated || event.getState() == kFZEventState_Indifferent));
+            
+            if(!isSample || event.getType() != runType) {
+                runStart = isSample ? m_pending.size() : m_pending.size()+1;
+                runType = isSample ? event.getType() : 0;
+            }
             
-            if(event) {
+            if((event.getType() & coalesced) && event.getOwner() != this)
+            {
+                intptr_t identifier = (event.getState() == kFZEventState_Indifferent) ? 0 : event.getIdentifier();
+                fzUInt index = (hashSource(event.getOwner(), identifier) ^ event.getType()) & (FZEVENT_PENDING_TABLE_SIZE-1);
                 
-                switch (event->getState()) {
-                    case kFZEventState_Indifferent:
-                    {
-                        handlerList::const_reverse_iterator handler(m_handlers.rbegin());
-                        for (; handler != m_handlers.rend(); ++handler) {
-                            if(handler->flags & event->getType())
-                                handler->delegate->event(*event);
-                        }
-                        
+                for(; m_pendingTable[index] >= 0; index = (index+1) & (FZEVENT_PENDING_TABLE_SIZE-1))
+                {
+                    if(isSameSource(event, m_pending[m_pendingTable[index]].event))
                         break;
-                    }
-                    case kFZEventState_Began:
+                }
+                if(m_pendingTable[index] >= 0 && (fzUInt)m_pendingTable[index] >= runStart)
+                {
+                    fzPendingEvent& last = m_pending[m_pendingTable[index]];
+                    if(isSample && last.event.getState() == event.getState())
                     {
-                        handlerList::const_reverse_iterator handler(m_handlers.rbegin());
-                        for (; handler != m_handlers.rend(); ++handler) {
-                            if(handler->flags & event->getType()) {
-                                if(handler->delegate->event(*event)) {
-                                    if(handler->flags & event->getType()) {
-                                        event->setDelegate(handler->delegate);
-                                        break;
-                                    }
-                                }
-                            }
+                        if(m_coalesceHistory & event.getType()) {
+                            m_history.push_back(last);
+                            last.history = m_history.size()-1;
                         }
-                        break;
+                        last.event = event;
+                        continue;
                     }
-                    case kFZEventState_Updated:
-                    {
-                        if(event->getDelegate())
-                            event->getDelegate()->event(*event);
-                        
-                        break;
+                }
+                m_pendingTable[index] = m_pending.size();
+            }
+            fzPendingEvent pending = { event, -1 };
+            m_pending.push_back(pending);
+        }
+        return !m_pending.empty();
+    }
+    
+    
+    void EventManager::dispatchEvent(Event& newEvent)
+    {
+        // cancelAllEvents() marker, see below.
+        if(newEvent.getOwner() == this) {
+            cancelEvents();
+            return;
+        }
+        Event *event = addEvent(newEvent);
+        
+        if(event) {
+            
+            switch (event->getState()) {
+                case kFZEventState_Indifferent:
+                {
+                    handlerList::const_reverse_iterator handler(m_handlers.rbegin());
+                    for (; handler != m_handlers.rend(); ++handler) {
+                        if(handler->flags & event->getType())
+                            handler->delegate->event(*event);
                     }
-                    case kFZEventState_Ended:
-                    case kFZEventState_Cancelled:
-                    {
-                        if(event->getDelegate()) {
-                            event->getDelegate()->event(*event);
-                            event->setDelegate(NULL);
+                    
+                    break;
+                }
+                case kFZEventState_Began:
+                {
+                    handlerList::const_reverse_iterator handler(m_handlers.rbegin());
+                    for (; handler != m_handlers.rend(); ++handler) {
+                        if(handler->flags & event->getType()) {
+                            if(handler->delegate->event(*event)) {
+                                if(handler->flags & event->getType()) {
+                                    event->setDelegate(handler->delegate);
+                                    break;
+                                }
+                            }
                         }
-                        break;
                     }
-                    default:
-                    {
-                        FZ_ASSERT(false, "Invalid event state.");
-                        break;
+                    break;
+                }
+                case kFZEventState_Updated:
+                {
+                    if(event->getDelegate())
+                        event->getDelegate()->event(*event);
+                    
+                    break;
+                }
+                case kFZEventState_Ended:
+                case kFZEventState_Cancelled:
+                {
+                    if(event->getDelegate()) {
+                        event->getDelegate()->event(*event);
+                        event->setDelegate(NULL);
                     }
+                    break;
+                }
+                default:
+                {
+                    FZ_ASSERT(false, "Invalid event state.");
+                    break;
                 }
             }
-            m_buffer.pop();
+        }
+    }
+    
+    
+    void EventManager::dispatchEvents()
+    {
+        while(collectEvents())
+        {
+            vector<fzPendingEvent>::iterator it(m_pending.begin());
+            for(; it != m_pending.end(); ++it)
+            {
+                m_coalesced.clear();
+                for(fzInt i = it->history; i >= 0; i = m_history[i].history)
+                    m_coalesced.push_back(m_history[i].event);
+                
+                reverse(m_coalesced.begin(), m_coalesced.end());
+                dispatchEvent(it->event);
+            }
+            m_pending.clear();
+            m_history.clear();
+            m_coalesced.clear();
         }
         m_handlers.remove_if(isHandlerFinished);
-        m_events.remove_if(isEventFinished);
         
-        p_mutex->unlock();
+        fzUInt count = m_events.size();
+        m_events.erase(remove_if(m_events.begin(), m_events.end(), isEventFinished), m_events.end());
+        if(count != m_events.size())
+            rebuildTable();
     }
     
     
-    void EventManager::cancelAllEvents()
+    void EventManager::cancelEvents()
     {
         eventList::iterator it(m_events.begin());
         for(; it != m_events.end(); ++it) {
             if(it->getState() == kFZEventState_Began || it->getState() == kFZEventState_Updated)
             {
-                Event event = Event(it->getOwner(), it->getIdentifier(),
-                                    it->getType(), kFZEventState_Cancelled,
-                                    it->m_x, it->m_y, it->m_z);
-                
-                catchEvent(event);
+                it->m_state = kFZEventState_Cancelled;
+                if(it->getDelegate()) {
+                    it->getDelegate()->event(*it);
+                    it->setDelegate(NULL);
+                }
             }
         }
     }
     
     
+    void EventManager::cancelAllEvents()
+    {
+        // m_events belongs to the main thread, so the cancellation is queued as a marker owned by the EventManager.
+        catchEvent(Event(this, 0, kFZEventType_All, kFZEventState_Cancelled));
+    }
+    
+    
     fzUInt EventManager::getNumberOfEvents(uint16_t type) const
     {
         fzUInt count = 0;
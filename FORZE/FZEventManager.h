@@ -31,7 +31,7 @@
  */
 
 #include "FZEvent.h"
-#include STL_QUEUE
+#include STL_VECTOR
 #include STL_LIST
 
 
@@ -60,9 +60,26 @@ namespace FORZE {
         
     };
     
-    class recursive_mutex;
+    enum fzEventCoalescing
+    {
+        //! Every sample is dispatched.
+        kFZEventCoalescing_None,
+        
+        //! Consecutive samples caught in the same frame are collapsed into the latest one.
+        //! Updated events are collapsed per identifier, indifferent events (accelerometer, mouse moved...) per owner.
+        kFZEventCoalescing_Latest,
+        
+        //! Like kFZEventCoalescing_Latest, but the collapsed samples are kept.
+        //! @see EventManager::getCoalescedEvents()
+        kFZEventCoalescing_History
+    };
+    
+    struct fzEventQueue;
     
     //! EventManager catch and dispatch events.
+    //! The OS wrapper pushes the events into a fixed-capacity ring and the main thread drains it
+    //! once per frame in dispatchEvents(). The ring is lock-free, built on the compiler's atomic builtins;
+    //! compilers without them fall back to a mutex.
     class EventManager
     {
         friend class Director;
@@ -76,15 +93,20 @@ namespace FORZE {
             EventDelegate *delegate;
         };
         friend bool isHandlerFinished(const EventManager::fzEventHandler&);
+        
+        struct fzPendingEvent
+        {
+            Event event;
+            fzInt history; // last collapsed sample in m_history, -1 if none
+        };
 
         
         // Simplified typedefs
         typedef list<fzEventHandler> handlerList;
-        typedef list<Event> eventList;
-        typedef queue<Event> eventQueue;
+        typedef vector<Event> eventList;
         
-        // Mutex
-        recursive_mutex *p_mutex;
+        // Events caught by the OS wrapper, waiting to be dispatched
+        fzEventQueue *p_queue;
         
         // Director's instance
         static EventManager* p_instance;
@@ -92,15 +114,26 @@ namespace FORZE {
         // events requested
         uint16_t m_flags;
         
-        // Events vector
+        // Active events, never bigger than FZ_EVENT_MAX_ACTIVE
         eventList m_events;
-        eventQueue m_buffer;
+        
+        // Open-addressed table: (owner, identifier) -> index in m_events
+        int16_t m_eventsTable[FZ_EVENT_MAX_ACTIVE * 2];
         
         // Delegates
         handlerList m_handlers;
         
-        // is enabled
-        bool m_enabled;
+        // Events collected in this frame, after coalescing
+        vector<fzPendingEvent> m_pending;
+        vector<fzPendingEvent> m_history;
+        eventList m_coalesced;
+        
+        // Open-addressed table: event source -> last index in m_pending
+        int16_t m_pendingTable[FZ_EVENT_QUEUE_CAPACITY * 2];
+        
+        // Coalescing policies by event type
+        uint16_t m_coalesceLatest;
+        uint16_t m_coalesceHistory;
         
         handlerList::iterator indexForPriority(fzInt priority);
         void updateFlags();
@@ -108,8 +141,16 @@ namespace FORZE {
         fzEventHandler* getHandlerForTarget(void* target);
         void updateHandlerFlags(fzEventHandler*, uint16_t);
         bool invalidateDelegate(EventDelegate *target);
-        Event* addEvent(const Event&);
         
+        fzUInt hashEvent(const Event&) const;
+        Event* findEvent(const Event&);
+        void rebuildTable();
+        Event* addEvent(Event&);
+        void cancelEvents();
+        
+        static bool isSameSource(const Event&, const Event&);
+        bool collectEvents();
+        void dispatchEvent(Event&);
         void dispatchEvents();
         
     protected:
@@ -147,16 +188,41 @@ namespace FORZE {
         
         
         //! This method is used internally to track the incoming events.
+        //! It can be called from any thread, usually the OS wrapper's one. It is lock-free when the compiler
+        //! provides atomic builtins (GCC and clang), otherwise the queue is protected by a mutex.
+        //! The event is dropped if the queue is full, see FZ_EVENT_QUEUE_CAPACITY.
         void catchEvent(const Event& newEvent);
         
         
+        //! Returns the active events (Began or Updated) tracked by the EventManager.
         const eventList& getEvent() const {
             return m_events;
         }
         
         
+        //! Cancels all the active events.
+        //! The cancellation is queued like any other event, so it is safe to call it from the OS wrapper.
         void cancelAllEvents();
         
+        
+        //! Sets how the samples of the specified event types are coalesced.
+        //! By default kFZEventType_MouseMoved, kFZEventType_Trackpad, kFZEventType_Accelerometer and
+        //! kFZEventType_Gyro are coalesced with kFZEventCoalescing_Latest.
+        //! @param types bit mask of fzEventType
+        //! @see fzEventCoalescing
+        void setCoalescing(uint16_t types, fzEventCoalescing mode);
+        
+        
+        //! Returns the coalescing mode of the specified event type.
+        fzEventCoalescing getCoalescing(fzEventType type) const;
+        
+        
+        //! Returns the samples collapsed into the event that is being dispatched, oldest first.
+        //! It is only valid inside EventDelegate::event() and only filled for kFZEventCoalescing_History types.
+        const eventList& getCoalescedEvents() const {
+            return m_coalesced;
+        }
+        
         void setAccelGyroInterval(fzFloat interval);
         
         fzUInt getNumberOfEvents(uint16_t type) const;
@@ -28,6 +28,7 @@
  */
 
 #include <string.h>
+#include <algorithm>
 #include "FZFont.h"
 #include "FZCommon.h"
 #include "FZMacros.h"
@@ -35,6 +36,14 @@
 #include "FZTexture2D.h"
 #include "FZTextureCache.h"
 #include "FZResourcesManager.h"
+#include "FZTrueType.h"
+#include "FZDistanceField.h"
+#include "FZWorkerPool.h"
+#include "FZScheduler.h"
+#include "FZDirector.h"
+#include "FZDeviceConfig.h"
+#include "FZMath.h"
+#include "external/tinythread/tinythread.h"
 
 
 namespace FORZE {
@@ -57,11 +66,34 @@ namespace FORZE {
     }
     
     
-    Font::Font(const char* filename, fzFloat fontHeight)
-    : p_texture(NULL)
+    Font::Font(const char* filename, fzFloat fontHeight, bool distanceField)
+    : p_trueType(NULL)
+    , m_scale(0)
+    , m_atlasFactor(1)
+    , m_padding(1)
+    , m_cellWidth(0)
+    , m_cellHeight(0)
+    , m_columns(0)
+    , m_atlasHeight(0)
+    , m_maxAtlasHeight(0)
+    , m_generation(0)
+    , m_atlas()
+    , m_cells()
+    , p_mutex(NULL)
+    , m_pending()
+    , m_finished()
+    , m_activeWorkers(0)
+    , m_isScheduled(false)
+    , m_factor(1)
+    , p_texture(NULL)
+    , m_lineHeight(0)
+    , m_isDistanceField(distanceField)
+    , m_kerning()
     {
         FZ_ASSERT(filename != NULL, "Filename cannot be empty.");
         
+        memset(m_kerningIndex, 0, sizeof(m_kerningIndex));
+        
         const char *extension = IO::getExtension(filename);
         if(extension == NULL)
             FZ_RAISE_STOP("Font: Extension is missing.");
@@ -70,7 +102,10 @@ namespace FORZE {
         if(strcasecmp(extension, "fnt") == 0 )
             loadFNTFile(filename);
         
-        else if(strcasecmp(extension, "ttf") == 0 )
+        else if(strcasecmp(extension, "fzf") == 0 )
+            loadFZFFile(filename);
+        
+        else if(strcasecmp(extension, "ttf") == 0 || strcasecmp(extension, "otf") == 0)
             loadTTFFile(filename, fontHeight);
         
         else
@@ -80,6 +115,35 @@ namespace FORZE {
     
     Font::~Font()
     {
+        if(p_trueType)
+        {
+            if(m_isScheduled)
+                Scheduler::Instance().unscheduleSelector(SEL_FLOAT(Font::updateGlyphs), this);
+            
+            // workers leave right after their last job, wait for them before releasing.
+            for(;;) {
+                p_mutex->lock();
+                fzUInt active = m_activeWorkers;
+                p_mutex->unlock();
+                if(active == 0)
+                    break;
+                
+                this_thread::yield();
+            }
+            
+            for(; !m_pending.empty(); m_pending.pop()) {
+                delete [] m_pending.front()->pixels;
+                delete m_pending.front();
+            }
+            vector<fzGlyphJob*>::iterator it(m_finished.begin());
+            for(; it != m_finished.end(); ++it) {
+                delete [] (*it)->pixels;
+                delete (*it);
+            }
+            delete p_mutex;
+            delete p_trueType;
+        }
+        
         // if pointer is non-NULL, we release it.
         FZ_SAFE_RELEASE(p_texture);
     }
@@ -105,15 +169,8 @@ namespace FORZE {
     {
         fzBuffer buffer = ResourcesManager::Instance().loadResource(filename, &m_factor);
         
-        // Unpack TTF Data
-        try {
-            loadTTFData(buffer.getPointer(), fontHeight);
-            buffer.free();
-            
-        } catch(...) {
-            buffer.free();
-            throw;
-        }
+        // Unpack TTF Data, the TrueType keeps the buffer.
+        loadTTFData(buffer, fontHeight);
     }
     
     
@@ -126,6 +183,7 @@ namespace FORZE {
         char word[30];
         bool parsedCommon = false;
         bool parsedPage = false;
+        vector<pair<uint16_t, fzFloat> > kerning;
         
         while(*data != '\0') {
         
@@ -226,7 +284,7 @@ namespace FORZE {
                     }
                     
                     uint16_t key = generateKey((uint8_t)first, (uint8_t)second);
-                    m_kerning.insert(pair<uint16_t, fzFloat>(key, amount));
+                    kerning.push_back(pair<uint16_t, fzFloat>(key, amount / m_factor));
                     
                     break;
                 }
@@ -247,23 +305,481 @@ namespace FORZE {
         
         if(!parsedPage)
             FZ_RAISE_STOP("Font:FNT: FNT page data not found.");
+        
+        setKerning(kerning);
     }
     
     
-    void Font::loadTTFData(char* data, fzFloat fontHeight)
+    void Font::loadFZFFile(const char* filename)
     {
-        if(data == NULL)
-            FZ_RAISE("Font:TTF: Imposible to load TTF data. Pointer is NULL.");
+        // read-only, archived fonts are not even copied.
+        fzBuffer buffer = ResourcesManager::Instance().mapResource(filename, &m_factor);
+        
+        try {
+            loadFZFData(buffer);
+            buffer.free();
+            
+        } catch(...) {
+            buffer.free();
+            throw;
+        }
+    }
+    
+    
+    void Font::loadFZFData(const fzBuffer& buffer)
+    {
+        if(buffer.isEmpty())
+            FZ_RAISE("Font:FZF: Imposible to load FZF data. Buffer is empty.");
+        
+        const char *data = buffer.getPointer();
+        const fzUInt length = buffer.getLength();
+        
+        fzFontHeader header;
+        if(length < sizeof(header))
+            FZ_RAISE("Font:FZF: Invalid header.");
+        
+        memcpy(&header, data, sizeof(header));
+        if(header.magic != FZ_FONT_MAGIC)
+            FZ_RAISE_STOP("Font:FZF: Invalid FZF sign.");
+        
+        if(header.version != FZ_FONT_VERSION)
+            FZ_RAISE_STOP("Font:FZF: Invalid FZF version, convert the font again with tools/fzfont.");
+        
+        
+        // sections
+        const fzUInt nuGlyphs = header.pageCount * 256;
+        const fzUInt textureOffset = sizeof(header);
+        const fzUInt pagesOffset = textureOffset + header.textureLength;
+        const fzUInt glyphsOffset = pagesOffset + header.pageCount * sizeof(uint32_t);
+        const fzUInt indexOffset = glyphsOffset + nuGlyphs * sizeof(fzFontGlyph);
+        const fzUInt kerningOffset = indexOffset + (nuGlyphs + 1) * sizeof(uint32_t);
+        const fzUInt end = kerningOffset + header.kerningCount * sizeof(fzFontKerning);
+        
+        if(header.textureLength == 0 || end > length || data[pagesOffset - 1] != '\0')
+            FZ_RAISE_STOP("Font:FZF: Corrupted file.");
+        
+        
+        // only the first page (code points 0-255) is used by FORZE.
+        fzInt pageIndex = -1;
+        for(fzUInt i = 0; i < header.pageCount; ++i) {
+            uint32_t page;
+            memcpy(&page, data + pagesOffset + i * sizeof(uint32_t), sizeof(uint32_t));
+            if(page == 0) {
+                pageIndex = i;
+                break;
+            }
+        }
+        if(pageIndex < 0)
+            FZ_RAISE_STOP("Font:FZF: The font does not include the code points 0-255.");
+        
+        
+        // TEXTURE
+        p_texture = TextureCache::Instance().addImage(data + textureOffset);
+        if(p_texture == NULL)
+            FZ_RAISE("Font:FZF: Font's texture is missing.");
+        
+        p_texture->retain();
+        m_lineHeight = header.lineHeight / m_factor;
+        
+        
+        // GLYPHS
+        fzFontGlyph glyphs[256];
+        memcpy(glyphs, data + glyphsOffset + pageIndex * 256 * sizeof(fzFontGlyph), sizeof(glyphs));
+        for(fzUInt i = 0; i < 256; ++i) {
+            const fzFontGlyph& glyph = glyphs[i];
+            fzCharDef& def = m_chars[i];
+            def.x           = glyph.x / m_factor;
+            def.y           = glyph.y / m_factor;
+            def.width       = glyph.width / m_factor;
+            def.height      = glyph.height / m_factor;
+            def.xOffset     = glyph.xOffset / m_factor;
+            def.yOffset     = glyph.yOffset / m_factor;
+            def.xAdvance    = glyph.xAdvance / m_factor;
+        }
+        
+        
+        // KERNING, already sorted.
+        uint32_t index[257];
+        memcpy(index, data + indexOffset + pageIndex * 256 * sizeof(uint32_t), sizeof(index));
+        if(index[256] > header.kerningCount || index[0] > index[256])
+            FZ_RAISE_STOP("Font:FZF: Corrupted kerning table.");
+        
+        vector<fzFontKerning> kernings(index[256] - index[0]);
+        if(!kernings.empty())
+            memcpy(&kernings[0], data + kerningOffset + index[0] * sizeof(fzFontKerning), kernings.size() * sizeof(fzFontKerning));
+        
+        m_kerning.reserve(kernings.size());
+        for(fzUInt first = 0; first < 256; ++first)
+        {
+            m_kerningIndex[first] = m_kerning.size();
+            for(uint32_t i = index[first]; i < index[first + 1]; ++i) {
+                const fzFontKerning& kerning = kernings[i - index[0]];
+                if(kerning.second < 256) {
+                    fzKerningPair pair = { (uint8_t)kerning.second, kerning.amount / m_factor };
+                    m_kerning.push_back(pair);
+                }
+            }
+        }
+        m_kerningIndex[256] = m_kerning.size();
+    }
+    
+    
+    void Font::setKerning(vector<pair<uint16_t, fzFloat> >& pairs)
+    {
+        // the keys are (first << 8 | second), sorting them groups the pairs by the first char.
+        sort(pairs.begin(), pairs.end());
+        
+        m_kerning.clear();
+        m_kerning.reserve(pairs.size());
+        
+        fzUInt first = 0;
+        vector<pair<uint16_t, fzFloat> >::const_iterator it(pairs.begin());
+        for(; it != pairs.end(); ++it)
+        {
+            fzUInt charId = it->first >> 8;
+            for(; first <= charId; ++first)
+                m_kerningIndex[first] = m_kerning.size();
+            
+            // duplicated pairs are ignored
+            if(!m_kerning.empty() && m_kerningIndex[charId] < m_kerning.size() && m_kerning.back().second == (it->first & 0xFF))
+                continue;
+            
+            fzKerningPair pair = { (uint8_t)(it->first & 0xFF), it->second };
+            m_kerning.push_back(pair);
+        }
+        for(; first <= 256; ++first)
+            m_kerningIndex[first] = m_kerning.size();
+    }
+    
+    
+    void Font::loadTTFData(fzBuffer data, fzFloat fontHeight)
+    {
+        if(data.isEmpty())
+            FZ_RAISE("Font:TTF: Imposible to load TTF data. Buffer is empty.");
+        
+        if(m_isDistanceField) {
+            // one atlas for all the sizes
+            fontHeight = FZ_FONT_DISTANCE_FIELD_SIZE;
+            m_padding = FZ_FONT_DISTANCE_FIELD_SPREAD;
+        }
+        if(fontHeight <= 0) {
+            data.free();
+            FZ_RAISE_STOP("Font:TTF: The line height must be positive.");
+        }
+        
+        // the TrueType owns the buffer from now.
+        p_trueType = new TrueType(data);
+        p_mutex = new mutex();
+        
+        // glyphs are rasterized at the screen resolution, metrics are stored in points.
+        m_atlasFactor = (m_isDistanceField) ? 1 : Director::Instance().getContentScaleFactor();
+        m_lineHeight = fontHeight;
+        m_scale = p_trueType->getScaleForHeight(fontHeight * m_atlasFactor);
+        
+        const fzFloat ascender = p_trueType->getAscender() * m_scale;
+        map<uint32_t, uint8_t> charForGlyph;
+        
+        
+        // METRICS (chars are Latin-1 code points)
+        for(fzUInt c = ' '; c < 256; ++c)
+        {
+            if(c >= 0x7F && c < 0xA0)
+                continue;
+            
+            uint32_t glyph = p_trueType->getGlyphIndex(c);
+            m_glyphs[c] = glyph;
+            m_charCells[c] = -1;
+            if(glyph == 0)
+                continue;
+            
+            charForGlyph.insert(pair<uint32_t, uint8_t>(glyph, c));
+            
+            fzGlyphBox box = p_trueType->getGlyphBox(glyph, m_scale);
+            fzCharDef& def = m_chars[c];
+            def.xAdvance = roundf(p_trueType->getAdvance(glyph) * m_scale) / m_atlasFactor;
+            
+            if(box.getWidth() > 0 && box.getHeight() > 0) {
+                fzInt width = box.getWidth() + m_padding * 2;
+                fzInt height = box.getHeight() + m_padding * 2;
+                
+                def.width   = width / m_atlasFactor;
+                def.height  = height / m_atlasFactor;
+                def.xOffset = (box.x0 - (fzInt)m_padding) / m_atlasFactor;
+                def.yOffset = (roundf(ascender) + box.y0 - m_padding) / m_atlasFactor;
+                
+                m_cellWidth = fzMax<fzUInt>(m_cellWidth, width);
+                m_cellHeight = fzMax<fzUInt>(m_cellHeight, height);
+            }
+        }
+        for(fzUInt c = 0; c < ' '; ++c) {
+            m_glyphs[c] = 0;
+            m_charCells[c] = -1;
+        }
+        if(m_cellWidth == 0)
+            FZ_RAISE("Font:TTF: The font does not include any Latin-1 glyph.");
+        
+        
+        // KERNING
+        vector<pair<uint16_t, fzFloat> > kerning;
+        fzUInt nuPairs = p_trueType->getKerningPairs(NULL, NULL, NULL);
+        if(nuPairs > 0) {
+            vector<uint16_t> firsts(nuPairs), seconds(nuPairs);
+            vector<int16_t> values(nuPairs);
+            p_trueType->getKerningPairs(&firsts[0], &seconds[0], &values[0]);
+            
+            for(fzUInt i = 0; i < nuPairs; ++i) {
+                map<uint32_t, uint8_t>::const_iterator first(charForGlyph.find(firsts[i]));
+                map<uint32_t, uint8_t>::const_iterator second(charForGlyph.find(seconds[i]));
+                if(first == charForGlyph.end() || second == charForGlyph.end())
+                    continue;
+                
+                fzFloat amount = roundf(values[i] * m_scale) / m_atlasFactor;
+                if(amount != 0)
+                    kerning.push_back(pair<uint16_t, fzFloat>(generateKey(first->second, second->second), amount));
+            }
+        }
+        setKerning(kerning);
+        
+        
+        // ATLAS, uniform cells. It starts with 4 rows and grows when needed.
+        GLint maxTextureSize = DeviceConfig::Instance().getMaxTextureSize();
+        fzUInt width = fzMath_nextPOT(m_cellWidth * 16);
+        width = fzMin<fzUInt>(width, maxTextureSize);
+        m_columns = width / m_cellWidth;
+        m_atlasHeight = fzMath_nextPOT(m_cellHeight * 4);
+        m_maxAtlasHeight = fzMin<fzUInt>(maxTextureSize, fzMax<fzUInt>(1024, m_atlasHeight));
+        
+        m_atlas.assign(width * m_atlasHeight * 2, 0);
+        
+        fzGlyphCell free = { -1, 0, 0 };
+        m_cells.assign(m_columns * (m_atlasHeight / m_cellHeight), free);
+        
+        p_texture = new Texture2D(&m_atlas[0], kFZPixelFormat_LA88, kFZTextureFormat_LA88,
+                                  width, m_atlasHeight, fzSize(width, m_atlasHeight));
+        p_texture->setFactor(m_atlasFactor);
+        p_texture->retain();
+    }
+    
+    
+    int Font::allocateCell(fzUInt frame)
+    {
+        // 1. free cell
+        int lru = -1;
+        for(fzUInt i = 0; i < m_cells.size(); ++i) {
+            const fzGlyphCell& cell = m_cells[i];
+            if(cell.charId < 0)
+                return i;
+            
+            if(cell.lastUse < frame && (lru < 0 || cell.lastUse < m_cells[lru].lastUse))
+                lru = i;
+        }
+        
+        // 2. bigger atlas
+        if(m_atlasHeight * 2 <= m_maxAtlasHeight) {
+            fzUInt first = m_cells.size();
+            growAtlas();
+            return first;
+        }
+        
+        // 3. least recently used glyph, not used in this frame.
+        if(lru >= 0) {
+            m_charCells[m_cells[lru].charId] = -1;
+            m_cells[lru].charId = -1;
+            clearCell(lru);
+            ++m_generation;
+        }
+        return lru;
+    }
+    
+    
+    void Font::growAtlas()
+    {
+        fzUInt width = p_texture->getPixelsWide();
+        m_atlasHeight *= 2;
+        
+        // rows are appended, the cells keep their position.
+        m_atlas.resize(width * m_atlasHeight * 2, 0);
+        
+        fzGlyphCell free = { -1, 0, 0 };
+        m_cells.resize(m_columns * (m_atlasHeight / m_cellHeight), free);
+        
+        p_texture->update(&m_atlas[0], kFZPixelFormat_LA88, width, m_atlasHeight, fzSize(width, m_atlasHeight));
+        
+        // texture coords changed
+        ++m_generation;
+    }
+    
+    
+    void Font::clearCell(fzUInt cell)
+    {
+        fzUInt width = p_texture->getPixelsWide();
+        fzUInt x = (cell % m_columns) * m_cellWidth;
+        fzUInt y = (cell / m_columns) * m_cellHeight;
+        
+        for(fzUInt row = 0; row < m_cellHeight; ++row)
+            memset(&m_atlas[((y + row) * width + x) * 2], 0, m_cellWidth * 2);
+        
+        vector<uint8_t> zeros(m_cellWidth * m_cellHeight * 2, 0);
+        p_texture->updateRegion(&zeros[0], kFZPixelFormat_LA88, x, y, m_cellWidth, m_cellHeight);
+    }
+    
+    
+    void Font::rasterizeGlyph(fzGlyphJob& job) const
+    {
+        p_trueType->rasterize(job.glyph, m_scale, job.pixels, m_cellWidth, m_padding);
+        
+        if(m_isDistanceField)
+            DistanceField::generate(job.pixels, m_cellWidth, m_cellHeight, m_cellWidth, job.pixels, m_padding);
+    }
+    
+    
+    void Font::uploadGlyph(const fzGlyphJob& job)
+    {
+        // the cell was evicted before the glyph was rasterized
+        const fzGlyphCell& cell = m_cells[job.cell];
+        if(cell.ticket != job.ticket || cell.charId < 0)
+            return;
+        
+        fzUInt width = p_texture->getPixelsWide();
+        fzUInt x = (job.cell % m_columns) * m_cellWidth;
+        fzUInt y = (job.cell / m_columns) * m_cellHeight;
+        
+        // coverage -> premultiplied white (LA88)
+        vector<uint8_t> pixels(m_cellWidth * m_cellHeight * 2);
+        for(fzUInt row = 0; row < m_cellHeight; ++row) {
+            const uint8_t *src = job.pixels + row * m_cellWidth;
+            uint8_t *dst = &pixels[row * m_cellWidth * 2];
+            for(fzUInt i = 0; i < m_cellWidth; ++i) {
+                dst[i * 2] = src[i];
+                dst[i * 2 + 1] = src[i];
+            }
+            memcpy(&m_atlas[((y + row) * width + x) * 2], dst, m_cellWidth * 2);
+        }
+        p_texture->updateRegion(&pixels[0], kFZPixelFormat_LA88, x, y, m_cellWidth, m_cellHeight);
+    }
+    
+    
+    void Font::rasterizeGlyphs(void *context, fzUInt)
+    {
+        // Each worker keeps rasterizing until there are no jobs left.
+        Font *font = static_cast<Font*>(context);
+        for(;;)
+        {
+            font->p_mutex->lock();
+            if(font->m_pending.empty()) {
+                --font->m_activeWorkers;
+                font->p_mutex->unlock();
+                return;
+            }
+            fzGlyphJob *job = font->m_pending.front();
+            font->m_pending.pop();
+            font->p_mutex->unlock();
+            
+            font->rasterizeGlyph(*job);
+            
+            font->p_mutex->lock();
+            font->m_finished.push_back(job);
+            font->p_mutex->unlock();
+        }
+    }
+    
+    
+    void Font::updateGlyphs(fzFloat)
+    {
+        vector<fzGlyphJob*> finished;
+        
+        p_mutex->lock();
+        finished.swap(m_finished);
+        bool isIdle = m_pending.empty() && m_activeWorkers == 0;
+        p_mutex->unlock();
+        
+        vector<fzGlyphJob*>::iterator it(finished.begin());
+        for(; it != finished.end(); ++it) {
+            uploadGlyph(*(*it));
+            delete [] (*it)->pixels;
+            delete (*it);
+        }
         
-        FZ_RAISE_STOP("Font:TTF: TTF NOT IMPLEMENTED.");
+        if(!finished.empty())
+            Director::Instance().m_sceneIsDirty = true;
+        
+        if(isIdle) {
+            Scheduler::Instance().unscheduleSelector(SEL_FLOAT(Font::updateGlyphs), this);
+            m_isScheduled = false;
+        }
     }
     
     
-    fzFloat Font::getKerning(unsigned char first, unsigned char second) const
+    void Font::loadChars(const char* str)
     {
-        uint16_t key = generateKey(first, second);
-        map<uint16_t, fzFloat>::const_iterator it(m_kerning.find(key));
-        return (it == m_kerning.end()) ? 0.0f : it->second;
+        if(p_trueType == NULL || str == NULL)
+            return;
+        
+        const fzUInt frame = Scheduler::Instance().getFrame();
+        const bool useWorkers = WorkerPool::Instance().getNumberOfWorkers() > 0;
+        bool isQueued = false;
+        
+        for(; *str != '\0'; ++str)
+        {
+            unsigned char charId = *str;
+            if(m_chars[charId].width == 0)
+                continue;
+            
+            int cell = m_charCells[charId];
+            if(cell < 0)
+            {
+                cell = allocateCell(frame);
+                if(cell < 0) {
+                    FZLOGERROR("Font:TTF: The glyph atlas is full, '%c' can not be rendered in this frame.", charId);
+                    continue;
+                }
+                
+                fzGlyphCell& glyphCell = m_cells[cell];
+                glyphCell.charId = charId;
+                ++glyphCell.ticket;
+                m_charCells[charId] = cell;
+                m_chars[charId].x = ((cell % m_columns) * m_cellWidth) / m_atlasFactor;
+                m_chars[charId].y = ((cell / m_columns) * m_cellHeight) / m_atlasFactor;
+                
+                fzGlyphJob *job = new fzGlyphJob();
+                job->glyph = m_glyphs[charId];
+                job->cell = cell;
+                job->ticket = glyphCell.ticket;
+                job->pixels = new uint8_t[m_cellWidth * m_cellHeight];
+                memset(job->pixels, 0, m_cellWidth * m_cellHeight);
+                
+                if(useWorkers) {
+                    p_mutex->lock();
+                    m_pending.push(job);
+                    p_mutex->unlock();
+                    isQueued = true;
+                    
+                }else{
+                    rasterizeGlyph(*job);
+                    uploadGlyph(*job);
+                    delete [] job->pixels;
+                    delete job;
+                }
+            }
+            m_cells[cell].lastUse = frame;
+        }
+        
+        if(isQueued)
+        {
+            p_mutex->lock();
+            bool startWorker = (m_activeWorkers == 0);
+            if(startWorker)
+                ++m_activeWorkers;
+            p_mutex->unlock();
+            
+            if(startWorker)
+                WorkerPool::Instance().dispatch(rasterizeGlyphs, this);
+            
+            if(!m_isScheduled) {
+                Scheduler::Instance().scheduleSelector(SEL_FLOAT(Font::updateGlyphs), this, 0, false, 2, kFZUpdatePhase_PreUpdate);
+                m_isScheduled = true;
+            }
+        }
     }
     
     
@@ -34,14 +34,55 @@
 #include "FZTypes.h"
 #include "FZConfig.h"
 #include "FZLifeCycle.h"
+#include "FZAllocator.h"
 
 
 #include STL_MAP
+#include STL_VECTOR
+#include STL_QUEUE
 
 using namespace STD;
 
 namespace FORZE {
 
+#define FZ_FONT_MAGIC 0x4e465a46 // "FZFN"
+#define FZ_FONT_VERSION 1
+    
+    /** Precompiled font format (.fzf, little endian), built offline from .fnt files with tools/fzfont.
+     * It is loaded with a single read (or mapped from an archive), nothing is parsed.
+     * - fzFontHeader
+     * - Texture filename, '\0' terminated and padded to 4 bytes (textureLength).
+     * - uint32_t pages[pageCount]: code point >> 8 of each page, sorted.
+     * - fzFontGlyph glyphs[pageCount * 256]: the glyph of a code point is glyphs[pageIndex * 256 + (code & 0xFF)].
+     * - uint32_t kerningIndex[pageCount * 256 + 1]: the pairs of glyph i are kernings[kerningIndex[i], kerningIndex[i+1]).
+     * - fzFontKerning kernings[kerningCount], sorted by first and second code points.
+     * Values are in pixels, they are divided by the scaling factor of the file (@x2) when loaded.
+     */
+    struct fzFontHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        float lineHeight;
+        uint32_t textureLength;
+        uint32_t pageCount;
+        uint32_t kerningCount;
+    };
+    
+    struct fzFontGlyph
+    {
+        float x, y;
+        float width, height;
+        float xOffset, yOffset;
+        float xAdvance;
+    };
+    
+    struct fzFontKerning
+    {
+        uint32_t second;
+        float amount;
+    };
+    
+    
     struct fzCharDef
     {
         fzFloat x, y;
@@ -58,24 +99,94 @@ namespace FORZE {
     };
     
     class Texture2D;
+    class TrueType;
+    class mutex;
+    
+    /** Font loads bitmap fonts (.fnt) and TrueType fonts (.ttf, .otf with TrueType outlines).
+     * TrueType glyphs are rasterized on demand (see loadChars()) into a glyph atlas owned by the font:
+     * - the rasterization runs in the WorkerPool, glyphs are uploaded in the next frames.
+     * - the atlas grows (up to 1024px or the max texture size) when it is full.
+     * - when it can not grow, the least recently used glyphs are evicted, getGeneration() changes
+     *   and the labels using the font layout their text again.
+     */
     class Font : public LifeCycle
     {
+    private:
+        struct fzGlyphCell {
+            int16_t charId;
+            fzUInt lastUse;
+            fzUInt ticket;
+        };
+        
+        struct fzGlyphJob {
+            uint32_t glyph;
+            fzUInt cell;
+            fzUInt ticket;
+            uint8_t *pixels;
+        };
+        
+        // TrueType glyph atlas
+        TrueType *p_trueType;
+        fzFloat m_scale;
+        fzFloat m_atlasFactor;
+        fzUInt m_padding;
+        fzUInt m_cellWidth;
+        fzUInt m_cellHeight;
+        fzUInt m_columns;
+        fzUInt m_atlasHeight;
+        fzUInt m_maxAtlasHeight;
+        fzUInt m_generation;
+        uint32_t m_glyphs[256];
+        int16_t m_charCells[256];
+        vector<uint8_t> m_atlas;
+        vector<fzGlyphCell> m_cells;
+        
+        // rasterization jobs
+        mutex *p_mutex;
+        queue<fzGlyphJob*> m_pending;
+        vector<fzGlyphJob*> m_finished;
+        fzUInt m_activeWorkers;
+        bool m_isScheduled;
+        
+        int allocateCell(fzUInt frame);
+        void growAtlas();
+        void clearCell(fzUInt cell);
+        void rasterizeGlyph(fzGlyphJob& job) const;
+        void uploadGlyph(const fzGlyphJob& job);
+        void updateGlyphs(fzFloat dt);
+        static void rasterizeGlyphs(void *font, fzUInt);
+        
     protected:
         fzUInt m_factor;
         Texture2D *p_texture;
         fzFloat m_lineHeight;
         fzCharDef m_chars[256];
-        map<uint16_t, fzFloat> m_kerning;
+        bool m_isDistanceField;
+        
+        // flat kerning table: the pairs of "first" are m_kerning[m_kerningIndex[first], m_kerningIndex[first+1])
+        struct fzKerningPair {
+            uint8_t second;
+            fzFloat amount;
+        };
+        uint32_t m_kerningIndex[257];
+        vector<fzKerningPair> m_kerning;
+        
+        void setKerning(vector<pair<uint16_t, fzFloat> >& pairs);
         
         
         void loadFNTFile(const char*);
         void loadFNTData(char*);
+        void loadFZFFile(const char*);
+        void loadFZFData(const fzBuffer&);
         void loadTTFFile(const char*, fzFloat);
-        void loadTTFData(char*, fzFloat);
+        void loadTTFData(fzBuffer, fzFloat);
         
     public:
         //! Constructs a Font giving the Font's filename and an optional lineHeight param.
-        Font(const char* filename, fzFloat lineHeight);
+        //! If distanceField is true the font is rendered with the kFZShader_nomat_aC4_SDF shader:
+        //! - TrueType fonts are rasterized as distance fields at FZ_FONT_DISTANCE_FIELD_SIZE, lineHeight is ignored.
+        //! - bitmap fonts (.fnt) must have been generated offline as distance fields (alpha channel).
+        Font(const char* filename, fzFloat lineHeight, bool distanceField = false);
         ~Font();
         
         
@@ -98,7 +209,43 @@ namespace FORZE {
         
         
         //! Returns kerning space betwen two characters.
-        fzFloat getKerning(unsigned char first, unsigned char second) const;
+        fzFloat getKerning(unsigned char first, unsigned char second) const
+        {
+            // a few pairs per char, sorted by the second char
+            const uint32_t end = m_kerningIndex[first + 1];
+            for(uint32_t i = m_kerningIndex[first]; i < end; ++i) {
+                const fzKerningPair& kerning = m_kerning[i];
+                if(kerning.second >= second)
+                    return (kerning.second == second) ? kerning.amount : 0;
+            }
+            return 0;
+        }
+        
+        
+        //! Makes sure the glyphs of the string are in the atlas, the missing ones are rasterized.
+        //! Until a glyph is uploaded its quad is transparent, the char info (metrics) is valid since the beginning.
+        //! It does nothing for bitmap fonts.
+        void loadChars(const char* str);
+        
+        
+        //! Returns a number that changes every time the char rects or the atlas size change.
+        //! Labels must layout their text again when it changes.
+        fzUInt getGeneration() const {
+            return m_generation;
+        }
+        
+        
+        //! Returns true if the glyphs are distance fields.
+        //! Distance field fonts can be scaled, see Label::setLineHeight().
+        bool isDistanceField() const {
+            return m_isDistanceField;
+        }
+        
+        
+        //! Returns true if the font is a TrueType font rasterized at runtime.
+        bool isTrueType() const {
+            return p_trueType != NULL;
+        }
         
         void log() const;
     };
@@ -34,6 +34,8 @@
 #include "FZFont.h"
 #include "FZMacros.h"
 #include "FZIO.h"
+#include "FZMemoryManager.h"
+#include "FZResourceGroup.h"
 
 using namespace STD;
 
@@ -53,10 +55,12 @@ namespace FORZE {
     
     FontCache::FontCache()
     : m_fonts()
-    { }
+    {
+        MemoryManager::Instance().addCache(this);
+    }
     
     
-    Font* FontCache::addFont(const char* filename, fzFloat lineHeight)
+    Font* FontCache::addFont(const char* filename, fzFloat lineHeight, bool distanceField)
     {
         FZ_ASSERT(filename != NULL, "Filename argument must be non-NULL.");
         
@@ -67,18 +71,28 @@ namespace FORZE {
         IO::removeFileSuffix(filenameCpy);
         
         uint32_t hash = fzHash(filenameCpy);
-        Font *font = getFontForHash(hash);
         
-        if(font != NULL && strcmp(IO::getExtension(filenameCpy), "ttf") == 0) {
-            // Rewritting
+        // TrueType fonts are rasterized for a line height, every height is a different font.
+        // Distance field fonts are scaled, one font for all the heights.
+        const char *extension = IO::getExtension(filenameCpy);
+        if(distanceField) {
+            char key[512];
+            snprintf(key, sizeof(key), "%s:sdf", filenameCpy);
+            hash = fzHash(key);
+            
+        }else if(extension && (strcasecmp(extension, "ttf") == 0 || strcasecmp(extension, "otf") == 0)) {
             FZ_ASSERT(lineHeight > 0, "Line height must me positive.");
-            FZLog("NOT IMPLEMENTED");
+            char key[512];
+            snprintf(key, sizeof(key), "%s:%.2f", filenameCpy, (float)lineHeight);
+            hash = fzHash(key);
         }
+        ResourceGroup::tag(kFZResource_Font, hash);
+        Font *font = getFontForHash(hash);
         
         if(font == NULL) {
             
             try {
-                font = new Font(filenameCpy, lineHeight);
+                font = new Font(filenameCpy, lineHeight, distanceField);
                 font->retain();
                 m_fonts.insert(fontsPair(hash, font));
 
@@ -130,8 +144,12 @@ namespace FORZE {
     void FontCache::removeFontByName(const char* filename)
     {
         FZ_ASSERT(filename, "Filename can not be NULL.");
-
-        uint32_t hash = fzHash(filename);
+        removeFontByHash(fzHash(filename));
+    }
+    
+    
+    void FontCache::removeFontByHash(uint32_t hash)
+    {
         Font *font = getFontForHash(hash);
         if(font) {
             m_fonts.erase(hash);
@@ -161,4 +179,24 @@ namespace FORZE {
         
         m_fonts.clear();
     }
+    
+    
+    const char* FontCache::getMemoryName() const
+    {
+        return "FontCache";
+    }
+    
+    
+    fzUInt FontCache::getMemoryUsage() const
+    {
+        // the textures are accounted by the TextureCache
+        return m_fonts.size() * sizeof(Font);
+    }
+    
+    
+    void FontCache::releaseMemory(fzMemoryTier tier)
+    {
+        if(tier == kFZMemoryTier_Unused)
+            removeUnusedFonts();
+    }
 }
@@ -34,6 +34,7 @@
 #include "FZTypes.h"
 #include "FZConfig.h"
 #include "FZSelectors.h"
+#include "FZProtocols.h"
 #if FZ_STL_CPLUSPLUS11
 #include STL_UNORDERED_MAP
 #else
@@ -50,7 +51,7 @@ namespace FORZE {
      * Once the Texture2D is loaded, the next time it will return
      * a reference of the previously loaded Texture2D reducing GPU & CPU memory
      */
-    class FontCache : public SELProtocol
+    class FontCache : public SELProtocol, public Protocol::Memory
     {
     private:
         // Simplified typedefs
@@ -81,7 +82,9 @@ namespace FORZE {
         
         
         //! Returns and loads if needed a Font instance giving the filename.
-        Font* addFont(const char* filename, fzFloat lineHeight = 0);
+        //! TrueType fonts (.ttf, .otf) need a line height, each line height is cached as a different Font.
+        //! Distance field fonts are cached once per file, whatever the line height is (see Font::isDistanceField()).
+        Font* addFont(const char* filename, fzFloat lineHeight = 0, bool distanceField = false);
         
         
         //! Removes a Font from the cache given the font instance.
@@ -92,6 +95,10 @@ namespace FORZE {
         //! @param filename is a NULL terminated char string.
         void removeFontByName(const char* filename);
         
+        
+        //! Removes a Font from the cache given the hash of its key name.
+        void removeFontByHash(uint32_t hash);
+        
         Font* getFontByName(const char* filename) const;
 
         
@@ -106,7 +113,12 @@ namespace FORZE {
         
         const fontsMap& getFonts() const {
             return m_fonts;
-        }
+        }        
+        
+        // Protocol::Memory
+        const char* getMemoryName() const override;
+        fzUInt getMemoryUsage() const override;
+        void releaseMemory(fzMemoryTier tier) override;
     };
 }
 #endif
@@ -29,6 +29,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include "FZHash.h"
 
 
@@ -52,6 +53,16 @@ namespace FORZE {
     }
     
     
+    uint32_t fzHashLowercase(const char *str)
+    {
+        uint32_t hash = 5381;
+        for(; *str != '\0'; ++str)
+            hash = __HASH_FUNCTION(hash, (char)tolower((unsigned char)*str));
+        
+        return hash;
+    }
+    
+    
     uint32_t fzVersion(const char *str)
     {
         uint32_t hash = 0;
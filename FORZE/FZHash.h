@@ -67,6 +67,9 @@ namespace FORZE
     //! Returns an int32 hash value giving a string.
     uint32_t fzHash(const char *str);
     
+    //! Like fzHash() but ignoring the case of ASCII letters, used to index the resources' paths.
+    uint32_t fzHashLowercase(const char *str);
+    
     //! Parses a string describing a version "x.y.z" and converts it to an integer.
     uint32_t fzVersion(const char *str);
 }
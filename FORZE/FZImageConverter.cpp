@@ -0,0 +1,334 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include <algorithm>
+
+#include "FZImageConverter.h"
+#include "FZMacros.h"
+#include STL_VECTOR
+
+
+using namespace STD;
+
+namespace FORZE {
+    
+    static const uint8_t s_bayer4x4[4][4] =
+    {
+        {  0,  8,  2, 10 },
+        { 12,  4, 14,  6 },
+        {  3, 11,  1,  9 },
+        { 15,  7, 13,  5 }
+    };
+    
+    
+    // Packs 8 bits channels into a 16 bits pixel (RGB565, RGB5A1 or RGBA4444).
+    // The layout is known at compile time, so the plain loops are vectorized by the compiler.
+    template<fzUInt SRC, uint8_t RB, uint8_t GB, uint8_t BB, uint8_t AB>
+    struct fzPacker
+    {
+        static inline uint16_t pack(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+        {
+            return (uint16_t)(((r >> (8 - RB)) << (GB + BB + AB)) |
+                              ((g >> (8 - GB)) << (BB + AB)) |
+                              ((b >> (8 - BB)) << AB) |
+                              (a >> (8 - AB)));
+        }
+        
+        
+        static void convert(uint8_t *pixels, fzUInt width, fzUInt height)
+        {
+            uint16_t *dst = reinterpret_cast<uint16_t*>(pixels);
+            const fzUInt count = width * height;
+            
+            for(fzUInt i = 0; i < count; ++i) {
+                const uint8_t *p = pixels + i * SRC;
+                dst[i] = pack(p[0], p[1], p[2], (SRC == 4) ? p[3] : 255);
+            }
+        }
+        
+        
+        static void convertOrdered(uint8_t *pixels, fzUInt width, fzUInt height)
+        {
+            const uint8_t bits[4] = { RB, GB, BB, AB };
+            uint16_t *dst = reinterpret_cast<uint16_t*>(pixels);
+            
+            for(fzUInt y = 0; y < height; ++y)
+            {
+                const uint8_t *row = s_bayer4x4[y & 3];
+                for(fzUInt x = 0; x < width; ++x)
+                {
+                    fzUInt i = y * width + x;
+                    const uint8_t *p = pixels + i * SRC;
+                    uint32_t c[4] = { p[0], p[1], p[2], (SRC == 4) ? p[3] : 255u };
+                    
+                    // 1 bit alpha is not dithered, it would add noise to the edges.
+                    for(fzUInt ch = 0; ch < 4; ++ch) {
+                        if(bits[ch] > 1) {
+                            c[ch] += (row[x & 3] << (8 - bits[ch])) >> 4;
+                            c[ch] = (c[ch] > 255) ? 255 : c[ch];
+                        }
+                    }
+                    dst[i] = pack(c[0], c[1], c[2], c[3]);
+                }
+            }
+        }
+        
+        
+        static void convertErrorDiffusion(uint8_t *pixels, fzUInt width, fzUInt height)
+        {
+            const uint8_t bits[4] = { RB, GB, BB, AB };
+            uint16_t *dst = reinterpret_cast<uint16_t*>(pixels);
+            
+            // errors (x16) of the current and the next row, with one pixel of margin at each side.
+            const fzUInt stride = (width + 2) * 4;
+            vector<int16_t> errors(stride * 2, 0);
+            int16_t *current = &errors[0];
+            int16_t *next = &errors[stride];
+            
+            for(fzUInt y = 0; y < height; ++y)
+            {
+                for(fzUInt x = 0; x < width; ++x)
+                {
+                    fzUInt i = y * width + x;
+                    const uint8_t *p = pixels + i * SRC;
+                    int32_t c[4] = { p[0], p[1], p[2], (SRC == 4) ? p[3] : 255 };
+                    
+                    for(fzUInt ch = 0; ch < 4; ++ch)
+                    {
+                        if(bits[ch] <= 1)
+                            continue;
+                        
+                        int32_t value = c[ch] + current[(x + 1) * 4 + ch] / 16;
+                        value = (value < 0) ? 0 : ((value > 255) ? 255 : value);
+                        
+                        int32_t max = (1 << bits[ch]) - 1;
+                        int32_t error = value - ((value >> (8 - bits[ch])) * 255) / max;
+                        
+                        // Floyd-Steinberg: 7/16 right, 3/16 bottom-left, 5/16 bottom, 1/16 bottom-right
+                        current[(x + 2) * 4 + ch] += error * 7;
+                        next[(x + 0) * 4 + ch] += error * 3;
+                        next[(x + 1) * 4 + ch] += error * 5;
+                        next[(x + 2) * 4 + ch] += error;
+                        c[ch] = value;
+                    }
+                    dst[i] = pack(c[0], c[1], c[2], c[3]);
+                }
+                std::swap(current, next);
+                std::fill(next, next + stride, 0);
+            }
+        }
+        
+        
+        static void convert(uint8_t *pixels, fzUInt width, fzUInt height, fzDithering dithering)
+        {
+            switch (dithering) {
+                case kFZDithering_Ordered: convertOrdered(pixels, width, height); break;
+                case kFZDithering_ErrorDiffusion: convertErrorDiffusion(pixels, width, height); break;
+                default: convert(pixels, width, height); break;
+            }
+        }
+    };
+    
+    
+    // Keeps some of the 8 bits channels (RGB888, LA88, L8, A8).
+    static void selectChannels(uint8_t *pixels, fzUInt srcBytes, fzUInt count, const uint8_t *channels, fzUInt dstBytes)
+    {
+        for(fzUInt i = 0; i < count; ++i) {
+            const uint8_t *src = pixels + i * srcBytes;
+            uint8_t *dst = pixels + i * dstBytes;
+            
+            // channels are read in increasing order, so writing in place is safe.
+            for(fzUInt ch = 0; ch < dstBytes; ++ch)
+                dst[ch] = src[channels[ch]];
+        }
+    }
+    
+    
+    fzImageInfo ImageConverter::analyze(const uint8_t *pixels, fzPixelFormat format, fzUInt count)
+    {
+        fzImageInfo info = { false, false, false, false };
+        
+        fzUInt bytes;
+        int alpha, gray;
+        switch (format) {
+            case kFZPixelFormat_RGBA8888: bytes = 4; alpha = 3; gray = 1; break;
+            case kFZPixelFormat_RGB888: bytes = 3; alpha = -1; gray = 1; break;
+            case kFZPixelFormat_LA88: bytes = 2; alpha = 1; gray = 0; break;
+            default: return info;
+        }
+        
+        // flags are accumulated without branches, the loop can stop once all of them were discarded.
+        uint32_t notOpaque = 0, notBinary = 0, notGray = 0, notAlphaOnly = 0;
+        const fzUInt blockSize = 4096;
+        
+        for(fzUInt block = 0; block < count; block += blockSize)
+        {
+            const fzUInt end = (block + blockSize < count) ? block + blockSize : count;
+            for(fzUInt i = block; i < end; ++i)
+            {
+                const uint8_t *p = pixels + i * bytes;
+                if(alpha >= 0) {
+                    uint32_t a = p[alpha];
+                    notOpaque |= 255 - a;
+                    notBinary |= a * (255 - a);
+                }
+                if(gray) {
+                    notGray |= (p[0] ^ p[1]) | (p[1] ^ p[2]);
+                    notAlphaOnly |= p[0] | p[1] | p[2];
+                }else
+                    notAlphaOnly |= p[0];
+            }
+            if(notOpaque && notBinary && notGray && notAlphaOnly)
+                break;
+        }
+        
+        info.isOpaque = (notOpaque == 0);
+        info.hasBinaryAlpha = (notBinary == 0);
+        info.isGrayscale = (notGray == 0);
+        info.isAlphaOnly = (alpha >= 0 && notAlphaOnly == 0);
+        return info;
+    }
+    
+    
+    fzPixelFormat ImageConverter::chooseFormat(fzPixelFormat format, const fzImageInfo& info, fzTextureFormat policy)
+    {
+        // a concrete texture format was forced (the enums are parallel)
+        if(policy >= 0) {
+            fzPixelFormat forced = static_cast<fzPixelFormat>(policy);
+            return canConvert(format, forced) ? forced : format;
+        }
+        
+        if(policy == kFZTextureFormat_quality)
+            return format;
+        
+        switch (format) {
+            case kFZPixelFormat_RGBA8888:
+                if(info.isGrayscale) {
+                    if(info.isOpaque)
+                        return kFZPixelFormat_L8;
+                    return (info.isAlphaOnly) ? kFZPixelFormat_A8 : kFZPixelFormat_LA88;
+                }
+                if(policy != kFZTextureFormat_performance)
+                    return format;
+                if(info.isOpaque)
+                    return kFZPixelFormat_RGB565;
+                
+                return (info.hasBinaryAlpha) ? kFZPixelFormat_RGB5A1 : kFZPixelFormat_RGBA4444;
+                
+            case kFZPixelFormat_RGB888:
+                if(info.isGrayscale)
+                    return kFZPixelFormat_L8;
+                
+                return (policy == kFZTextureFormat_performance) ? kFZPixelFormat_RGB565 : format;
+                
+            case kFZPixelFormat_LA88:
+                if(info.isOpaque)
+                    return kFZPixelFormat_L8;
+                
+                return (info.isAlphaOnly) ? kFZPixelFormat_A8 : format;
+                
+            default:
+                return format;
+        }
+    }
+    
+    
+    bool ImageConverter::canConvert(fzPixelFormat from, fzPixelFormat to)
+    {
+        switch (from) {
+            case kFZPixelFormat_RGBA8888:
+                return (to == kFZPixelFormat_RGB888 || to == kFZPixelFormat_RGBA4444 ||
+                        to == kFZPixelFormat_RGB5A1 || to == kFZPixelFormat_RGB565 ||
+                        to == kFZPixelFormat_LA88 || to == kFZPixelFormat_L8 || to == kFZPixelFormat_A8);
+                
+            case kFZPixelFormat_RGB888:
+                return (to == kFZPixelFormat_RGB565 || to == kFZPixelFormat_L8);
+                
+            case kFZPixelFormat_LA88:
+                return (to == kFZPixelFormat_L8 || to == kFZPixelFormat_A8);
+                
+            default:
+                return false;
+        }
+    }
+    
+    
+    fzUInt ImageConverter::convert(uint8_t *pixels, fzPixelFormat from, fzPixelFormat to,
+                                   fzUInt width, fzUInt height, fzDithering dithering)
+    {
+        FZ_ASSERT(pixels != NULL, "Pixels can not be NULL.");
+        FZ_ASSERT(canConvert(from, to), "Conversion is not supported.");
+        
+        const fzUInt count = width * height;
+        const fzUInt srcBytes = Texture2D::getPixelInfo(from).dataBBP / 8;
+        const fzUInt dstBytes = Texture2D::getPixelInfo(to).dataBBP / 8;
+        
+        if(from == kFZPixelFormat_RGBA8888)
+        {
+            switch (to) {
+                case kFZPixelFormat_RGB565: fzPacker<4, 5, 6, 5, 0>::convert(pixels, width, height, dithering); break;
+                case kFZPixelFormat_RGB5A1: fzPacker<4, 5, 5, 5, 1>::convert(pixels, width, height, dithering); break;
+                case kFZPixelFormat_RGBA4444: fzPacker<4, 4, 4, 4, 4>::convert(pixels, width, height, dithering); break;
+                case kFZPixelFormat_RGB888: {
+                    static const uint8_t channels[] = { 0, 1, 2 };
+                    selectChannels(pixels, srcBytes, count, channels, dstBytes);
+                    break;
+                }
+                case kFZPixelFormat_LA88: {
+                    static const uint8_t channels[] = { 0, 3 };
+                    selectChannels(pixels, srcBytes, count, channels, dstBytes);
+                    break;
+                }
+                case kFZPixelFormat_A8: {
+                    static const uint8_t channels[] = { 3 };
+                    selectChannels(pixels, srcBytes, count, channels, dstBytes);
+                    break;
+                }
+                default: {
+                    static const uint8_t channels[] = { 0 };
+                    selectChannels(pixels, srcBytes, count, channels, dstBytes);
+                    break;
+                }
+            }
+        }
+        else if(from == kFZPixelFormat_RGB888 && to == kFZPixelFormat_RGB565)
+        {
+            fzPacker<3, 5, 6, 5, 0>::convert(pixels, width, height, dithering);
+        }
+        else
+        {
+            // RGB888 -> L8, LA88 -> L8, LA88 -> A8
+            static const uint8_t luminance[] = { 0 };
+            static const uint8_t alpha[] = { 1 };
+            selectChannels(pixels, srcBytes, count, (to == kFZPixelFormat_A8) ? alpha : luminance, dstBytes);
+        }
+        
+        return count * dstBytes;
+    }
+}
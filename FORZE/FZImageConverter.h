@@ -0,0 +1,85 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZIMAGECONVERTER_H_INCLUDED__
+#define __FZIMAGECONVERTER_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZTexture2D.h"
+
+
+namespace FORZE {
+    
+    //! Content of an image, computed by ImageConverter::analyze().
+    struct fzImageInfo
+    {
+        //! All the pixels have alpha = 255.
+        bool isOpaque;
+        
+        //! All the pixels have alpha = 0 or alpha = 255.
+        bool hasBinaryAlpha;
+        
+        //! All the pixels have R = G = B.
+        bool isGrayscale;
+        
+        //! All the pixels have R = G = B = 0, it is sampled the same from an A8 texture.
+        bool isAlphaOnly;
+    };
+    
+    
+    /** ImageConverter analyzes decoded images and reduces them to smaller pixel formats.
+     * It does not call OpenGL, so it can run in a worker thread (Texture2D::decode()).
+     */
+    class ImageConverter
+    {
+    public:
+        //! Scans the pixels of a RGBA8888, RGB888 or LA88 image.
+        static fzImageInfo analyze(const uint8_t *pixels, fzPixelFormat format, fzUInt count);
+        
+        
+        /** Returns the smallest format that keeps the image content acceptable given a policy:
+         * - kFZTextureFormat_quality: the decoded format, no reduction.
+         * - kFZTextureFormat_auto: lossless reductions only, L8/LA88 for grayscale images and A8 for alpha only images.
+         * - kFZTextureFormat_performance: same as auto, and lossy reductions for the rest of images:
+         *   RGB565 if opaque, RGB5A1 if 1-bit alpha and RGBA4444 otherwise.
+         * - any other format: the format itself if the conversion is supported.
+         */
+        static fzPixelFormat chooseFormat(fzPixelFormat format, const fzImageInfo& info, fzTextureFormat policy);
+        
+        
+        //! Returns true if convert() supports the given conversion.
+        static bool canConvert(fzPixelFormat from, fzPixelFormat to);
+        
+        
+        //! Converts the pixels in place, the output is never bigger than the input.
+        //! @return the new length of the pixels in bytes.
+        static fzUInt convert(uint8_t *pixels, fzPixelFormat from, fzPixelFormat to,
+                              fzUInt width, fzUInt height, fzDithering dithering);
+    };
+}
+#endif
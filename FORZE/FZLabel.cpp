@@ -28,11 +28,17 @@
  @author Manuel Martínez-Almeida
  */
 
+#include <string.h>
+
 #include "FZLabel.h"
 #include "FZSprite.h"
 #include "FZMacros.h"
 #include "FZFontCache.h"
 #include "FZFont.h"
+#include "FZTexture2D.h"
+#include "FZMath.h"
+#include "FZShaderCache.h"
+#include "FZGLProgram.h"
 
 
 using namespace STD;
@@ -93,7 +99,19 @@ namespace FORZE {
     , m_alignment(kFZLabelAlignment_left)
     , m_verticalPadding(2)
     , m_letterSpacing(0)
+    , m_mode(kFZLabelMode_sprites)
     , p_font(NULL)
+    , m_fontGeneration(0)
+    , m_lineHeight(0)
+    , m_outlineColor(0, 0, 0, 0)
+    , m_outlineWidth(0)
+    , m_glowColor(0, 0, 0, 0)
+    , m_glowWidth(0)
+    , m_lineWidths()
+    , m_glyphs()
+    , m_dirtyBegin(0)
+    , m_dirtyEnd(0)
+    , m_colorIsDirty(false)
     {
         setIsRelativeAnchorPoint(true);
         setAnchorPoint(0.5f, 0.5f);
@@ -101,9 +119,15 @@ namespace FORZE {
     
     
     Label::Label(const char* text, const char* fontFilename, fzFloat lineHeight)
+    : Label(text, fontFilename, lineHeight, false)
+    { }
+    
+    
+    Label::Label(const char* text, const char* fontFilename, fzFloat lineHeight, bool distanceField)
     : Label()
     {
-        Font *font = FontCache::Instance().addFont(fontFilename, lineHeight);
+        m_lineHeight = lineHeight;
+        Font *font = FontCache::Instance().addFont(fontFilename, lineHeight, distanceField);
         setFont(font);
         setString(text);
     }
@@ -125,6 +149,7 @@ namespace FORZE {
         FZRETAIN_TEMPLATE(font, p_font);
 
         if(font) {
+            setGLProgram(font->isDistanceField() ? kFZShader_nomat_aC4_SDF : kFZShader_nomat_aC4_TEX);
             setTexture(font->getTexture());
             createFontChars();
         }
@@ -134,10 +159,13 @@ namespace FORZE {
     void Label::setString(const char* str)
     {
         if(str == NULL)
-            m_string.clear();
-        else
-            m_string.assign(str);
+            str = "";
+        
+        // counters usually set the same string every frame
+        if(m_string.compare(str) == 0)
+            return;
         
+        m_string.assign(str);
         createFontChars();
     }
     
@@ -169,9 +197,53 @@ namespace FORZE {
     }
     
     
+    void Label::setMode(fzLabelMode mode)
+    {
+        if(mode != m_mode) {
+            m_mode = mode;
+            removeAllChildren();
+            m_glyphs.clear();
+            createFontChars();
+        }
+    }
+    
+    
+    void Label::setLineHeight(fzFloat lineHeight)
+    {
+        if(lineHeight != m_lineHeight) {
+            m_lineHeight = lineHeight;
+            createFontChars();
+        }
+    }
+    
+    
+    void Label::setOutline(const fzColor4F& color, fzFloat width)
+    {
+        FZ_ASSERT(width >= 0 && width <= 1, "Width must be between 0 and 1.");
+        m_outlineColor = color;
+        m_outlineWidth = width;
+        makeDirty(kFZDirty_color);
+    }
+    
+    
+    void Label::setGlow(const fzColor4F& color, fzFloat width)
+    {
+        FZ_ASSERT(width >= 0 && width <= 1, "Width must be between 0 and 1.");
+        m_glowColor = color;
+        m_glowWidth = width;
+        makeDirty(kFZDirty_color);
+    }
+    
+    
     void Label::setColor(const fzColor3B& color)
     {
         m_color = color;
+        if(m_mode == kFZLabelMode_mesh) {
+            m_colorIsDirty = true;
+            makeDirty(kFZDirty_color);
+            return;
+        }
+        
         Sprite *sprite = static_cast<Sprite*>(m_children.front());
         for(fzUInt i = 0; (i < m_string.size()) && sprite; ++i, sprite = static_cast<Sprite*>(sprite->next())) {
             sprite->setColor(color);
@@ -185,10 +257,61 @@ namespace FORZE {
     }
     
     
+    void Label::setGlyph(fzUInt index, const fzRect& rect, const fzPoint& origin, const fzSize& size)
+    {
+        fzLabelGlyph glyph;
+        fzPoint tr = origin + size;
+        glyph.vertices[0] = origin;
+        glyph.vertices[1] = fzVec2(tr.x, origin.y);
+        glyph.vertices[2] = fzVec2(origin.x, tr.y);
+        glyph.vertices[3] = tr;
+        
+        // same texture coords than Sprite::updateTextureCoords()
+        Texture2D *texture = getTexture();
+        fzFloat wide = texture->getPixelsWide();
+        fzFloat high = texture->getPixelsHigh();
+        fzRect texRect(rect);
+        texRect *= texture->getFactor();
+        
+#if FZ_FIX_ARTIFACTS_BY_STRECHING_TEXEL
+        wide *= 2;
+        high *= 2;
+        texRect.origin.x       = texRect.origin.x*2+1;
+        texRect.origin.y       = texRect.origin.y*2+1;
+        texRect.size.width     = texRect.size.width*2-2;
+        texRect.size.height    = texRect.size.height*2-2;
+#endif
+        
+        fzFloat A = texRect.origin.x / wide;
+        fzFloat B = A + texRect.size.width / wide;
+        fzFloat C = texRect.origin.y / high;
+        fzFloat D = C + texRect.size.height / high;
+        glyph.texCoords[0] = fzVec2(A, D);
+        glyph.texCoords[1] = fzVec2(B, D);
+        glyph.texCoords[2] = fzVec2(A, C);
+        glyph.texCoords[3] = fzVec2(B, C);
+        
+        
+        // only the glyphs that changed are uploaded again
+        if(index < m_glyphs.size()) {
+            if(memcmp(&m_glyphs[index], &glyph, sizeof(fzLabelGlyph)) == 0)
+                return;
+            
+            m_glyphs[index] = glyph;
+        }else
+            m_glyphs.push_back(glyph);
+        
+        m_dirtyBegin = fzMin(m_dirtyBegin, index);
+        m_dirtyEnd = fzMax(m_dirtyEnd, index + 1);
+        makeDirty(kFZDirty_texcoords);
+    }
+    
+    
     void Label::createFontChars()
     {
         // Get string length
         fzUInt m_stringLen = m_string.size();
+        fzUInt glyphCount = 0;
     
         Sprite *fontChar = static_cast<Sprite*>(m_children.front());
         
@@ -203,14 +326,21 @@ namespace FORZE {
                 return;
             }
             
+            // TrueType glyphs are rasterized on demand
+            p_font->loadChars(m_string.c_str());
+            m_fontGeneration = p_font->getGeneration();
+            
+            // distance fields are scaled to the line height
+            const fzFloat scale = (p_font->isDistanceField() && m_lineHeight > 0)
+            ? m_lineHeight / p_font->getLineHeight() : 1;
+            
             // Precalculate label size
             const char *string = m_string.c_str();
             char charId = 0, prevId = 0;
             fzUInt i;
             fzUInt currentLine = 0;
             fzFloat longestLine = 0;
-            fzFloat lineWidth[100];
-            lineWidth[0] = 0;
+            m_lineWidths.assign(1, 0);
             
             for(i = 0; i <= m_stringLen; ++i) {
                 charId = string[i];
@@ -218,16 +348,17 @@ namespace FORZE {
                     FZ_RAISE("Label: CHAR[] doesn't exist. It's negative.");
                 
                 if(charId == '\n' || charId == '\0') {
-                    longestLine = fzMax(longestLine, lineWidth[currentLine]);
-                    lineWidth[++currentLine] = 0;
+                    longestLine = fzMax(longestLine, m_lineWidths[currentLine]);
+                    m_lineWidths.push_back(0);
+                    ++currentLine;
                 }else{
-                    lineWidth[currentLine] += p_font->getCharInfo(charId).xAdvance + m_letterSpacing + p_font->getKerning(prevId, charId);
+                    m_lineWidths[currentLine] += (p_font->getCharInfo(charId).xAdvance + p_font->getKerning(prevId, charId)) * scale + m_letterSpacing;
                     prevId = charId;
                 }
             }
             
             
-            fzFloat lineHeight = p_font->getLineHeight() + m_verticalPadding;
+            fzFloat lineHeight = p_font->getLineHeight() * scale + m_verticalPadding;
             fzFloat totalHeight = lineHeight * currentLine;
             
             fzFloat nextFontPositionY = totalHeight - lineHeight;
@@ -251,10 +382,10 @@ namespace FORZE {
                 {
                     switch (m_alignment) {
                         case kFZLabelAlignment_right:
-                            nextFontPositionX = longestLine - lineWidth[currentLine];
+                            nextFontPositionX = longestLine - m_lineWidths[currentLine];
                             break;
                         case kFZLabelAlignment_center:
-                            nextFontPositionX = (longestLine - lineWidth[currentLine])/2.0f;
+                            nextFontPositionX = (longestLine - m_lineWidths[currentLine])/2.0f;
                             break;
                         default:
                             FZLOGERROR("Label: %d is not a valid aligment.", m_alignment);
@@ -270,35 +401,44 @@ namespace FORZE {
                     char toPrint[3];
                     printChar(toPrint, charId);
                     FZLOGERROR("Label: CHAR[%d] '%s' is not included.", charId, toPrint);
-                    nextFontPositionX += p_font->getLineHeight();
+                    nextFontPositionX += p_font->getLineHeight() * scale;
                     continue;
                 }
                 
-                // get sprite
-                if( fontChar == NULL ) {
-                    fontChar = new Sprite();
-                    addChild(fontChar);
+                nextFontPositionX += p_font->getKerning(prevId, charId) * scale;
+                fzSize size(fontDef.width * scale, fontDef.height * scale);
+                fzFloat yOffset = (p_font->getLineHeight() - fontDef.yOffset) * scale;
+                fzPoint origin(nextFontPositionX + fontDef.xOffset * scale,
+                               nextFontPositionY + yOffset - size.height);
+                
+                if(m_mode == kFZLabelMode_mesh)
+                {
+                    setGlyph(glyphCount++, fontDef.getRect(), origin, size);
+                }
+                else
+                {
+                    // get sprite
+                    if( fontChar == NULL ) {
+                        fontChar = new Sprite();
+                        addChild(fontChar);
+                        
+                    }else {
+                        // reusing sprites
+                        fontChar->setIsVisible(true);
+                    }
                     
-                }else {
-                    // reusing sprites
-                    fontChar->setIsVisible(true);
+                    // config sprite
+                    fzPoint fontPos = origin + fzPoint(size.width, size.height) * 0.5f;
+                    fontChar->setTextureRect(fontDef.getRect());
+                    fontChar->setPosition(fontPos);
+                    fontChar->setScale(scale);
+                    fontChar->setColor(m_color);
+                    fontChar = static_cast<Sprite*>(fontChar->next());
                 }
                 
-                // config sprite
-                nextFontPositionX += p_font->getKerning(prevId, charId);
-                fzFloat yOffset = p_font->getLineHeight() - fontDef.yOffset;
-                fzPoint fontPos = fzPoint(nextFontPositionX + fontDef.xOffset + fontDef.width * 0.5f,
-                                          nextFontPositionY + yOffset - fontDef.height * 0.5f );
-                
-                fontChar->setTextureRect(fontDef.getRect());
-                fontChar->setPosition(fontPos);
-                fontChar->setColor(m_color);
-                
-                
                 // next sprite
-                nextFontPositionX += fontDef.xAdvance + m_letterSpacing;
+                nextFontPositionX += fontDef.xAdvance * scale + m_letterSpacing;
                 prevId = charId;
-                fontChar = static_cast<Sprite*>(fontChar->next());
             }
             
             // new content size
@@ -307,8 +447,111 @@ namespace FORZE {
         
     clean:
         
+        // glyphs not longer used are not drawn.
+        if(glyphCount < m_glyphs.size()) {
+            m_glyphs.resize(glyphCount);
+            makeDirty(kFZDirty_texcoords);
+        }
+        
         // make sprites not longer used hidden.
         for(; fontChar; fontChar = static_cast<Sprite*>(fontChar->next()))
             fontChar->setIsVisible(false);
     }
+    
+    
+    void Label::render(unsigned char dirtyFlags)
+    {
+        if(p_font && p_font->isTrueType()) {
+            // the glyph atlas changed, the char rects are not valid anymore.
+            if(m_fontGeneration != p_font->getGeneration())
+                createFontChars();
+            else
+                p_font->loadChars(m_string.c_str()); // glyphs in use are not evicted
+        }
+        
+        if(m_mode == kFZLabelMode_sprites) {
+            SpriteBatch::render(dirtyFlags);
+            return;
+        }
+        
+        const fzUInt count = m_glyphs.size();
+        const fzUInt capacity = m_textureAtlas.getCapacity();
+        m_textureAtlas.reserveCapacity(count);
+        
+        // the atlas does not keep its quads when it grows
+        if((dirtyFlags & kFZDirty_transform_absolute) || capacity != m_textureAtlas.getCapacity()) {
+            m_dirtyBegin = 0;
+            m_dirtyEnd = count;
+            m_colorIsDirty = true;
+        }
+        if(dirtyFlags & kFZDirty_opacity)
+            m_colorIsDirty = true;
+        
+        
+        fzV4_T2_C4_Quad *quads = m_textureAtlas.getQuads();
+        
+        // UPDATING VERTICES AND TEXTURE COORDS
+        fzUInt end = fzMin(m_dirtyEnd, count);
+        for(fzUInt i = m_dirtyBegin; i < end; ++i)
+        {
+            fzVec4 output[4];
+            const fzLabelGlyph& glyph = m_glyphs[i];
+            fzMath_mat4Vec4(m_transformMV,
+                            reinterpret_cast<const float*>(glyph.vertices),
+                            reinterpret_cast<float*>(output));
+            
+            fzV4_T2_C4_Quad& quad = quads[i];
+            quad.bl.vertex = output[0];
+            quad.br.vertex = output[1];
+            quad.tl.vertex = output[2];
+            quad.tr.vertex = output[3];
+            
+            quad.bl.texCoord = glyph.texCoords[0];
+            quad.br.texCoord = glyph.texCoords[1];
+            quad.tl.texCoord = glyph.texCoords[2];
+            quad.tr.texCoord = glyph.texCoords[3];
+            m_textureAtlas.updateQuad(&quad);
+        }
+        
+        
+        // UPDATING COLOR
+        fzUInt colorBegin = (m_colorIsDirty) ? 0 : m_dirtyBegin;
+        fzUInt colorEnd = (m_colorIsDirty) ? count : end;
+        const fzColor4B color4(m_color.r, m_color.g, m_color.b, static_cast<GLubyte>(m_cachedOpacity * 255));
+        for(fzUInt i = colorBegin; i < colorEnd; ++i)
+        {
+            fzV4_T2_C4_Quad& quad = quads[i];
+            quad.bl.color = color4;
+            quad.br.color = color4;
+            quad.tl.color = color4;
+            quad.tr.color = color4;
+            m_textureAtlas.updateQuad(&quad);
+        }
+        
+        m_dirtyBegin = count;
+        m_dirtyEnd = 0;
+        m_colorIsDirty = false;
+        
+        // SETS THE LAST QUAD USED
+        m_textureAtlas.setLastQuad(quads + count);
+
+        // RENDERING
+        draw();
+    }
+    
+    
+    void Label::draw()
+    {
+#if FZ_GL_SHADERS
+        if(p_font && p_font->isDistanceField()) {
+            // the distance field shader is shared, the effects are set before every draw.
+            p_glprogram->use();
+            p_glprogram->setUniform4f("u_outlineColor"_hash, m_outlineColor.r, m_outlineColor.g, m_outlineColor.b, m_outlineColor.a);
+            p_glprogram->setUniform1f("u_outlineWidth"_hash, m_outlineWidth * 0.5f);
+            p_glprogram->setUniform4f("u_glowColor"_hash, m_glowColor.r, m_glowColor.g, m_glowColor.b, m_glowColor.a);
+            p_glprogram->setUniform1f("u_glowWidth"_hash, m_glowWidth * 0.5f);
+        }
+#endif
+        SpriteBatch::draw();
+    }
 }
@@ -33,6 +33,7 @@
 
 #include "FZSpriteBatch.h"
 #include STL_STRING
+#include STL_VECTOR
 
 
 using namespace STD;
@@ -44,6 +45,25 @@ namespace FORZE {
         kFZLabelAlignment_center,
         kFZLabelAlignment_right,
     };
+    
+    
+    enum fzLabelMode {
+        //! One Sprite child per character, they can be accessed and animated individually.
+        kFZLabelMode_sprites,
+        
+        //! The glyph quads are written straight into the TextureAtlas, no children are created.
+        //! Only the quads of the glyphs that changed are updated, use it for counters and timers.
+        kFZLabelMode_mesh,
+    };
+    
+    
+    //! Cached layout of a glyph, in label coordinates.
+    struct fzLabelGlyph
+    {
+        fzVec2 vertices[4];
+        fzVec2 texCoords[4];
+    };
+    
         
     class Font;
     class Label : public SpriteBatch, public Protocol::Color
@@ -54,10 +74,27 @@ namespace FORZE {
         fzFloat m_verticalPadding;
         fzFloat m_letterSpacing;
         fzLabelAlignment m_alignment;
+        fzLabelMode m_mode;
 
         Font *p_font;
+        fzUInt m_fontGeneration;
+        fzFloat m_lineHeight;
+        
+        // distance field effects
+        fzColor4F m_outlineColor;
+        fzFloat m_outlineWidth;
+        fzColor4F m_glowColor;
+        fzFloat m_glowWidth;
+        
+        // text mesh cache
+        vector<fzFloat> m_lineWidths;
+        vector<fzLabelGlyph> m_glyphs;
+        fzUInt m_dirtyBegin;
+        fzUInt m_dirtyEnd;
+        bool m_colorIsDirty;
         
         void createFontChars();
+        void setGlyph(fzUInt index, const fzRect& rect, const fzPoint& origin, const fzSize& size);
         
     public:
         //! Constructs a void label.
@@ -69,6 +106,11 @@ namespace FORZE {
         Label(const char* text, const char* fontFilename, fzFloat lineHeight);
         
         
+        //! Constructs a label with a distance field font if distanceField is true, see Font::isDistanceField().
+        //! The text is scaled to the line height without losing quality.
+        Label(const char* text, const char* fontFilename, fzFloat lineHeight, bool distanceField);
+        
+        
         //! Constructs a bitmap font label, this method is recomemded for .FNT fonts.
         Label(const char* text, const char* fontFilename);
         
@@ -121,11 +163,45 @@ namespace FORZE {
         fzFloat getLetterSpacing() const {
             return m_letterSpacing;
         }
+        
+        
+        //! Sets how the characters are rendered.
+        //! kFZLabelMode_sprites by default.
+        void setMode(fzLabelMode mode);
+        
+        
+        //! Returns how the characters are rendered.
+        fzLabelMode getMode() const {
+            return m_mode;
+        }
+        
+        
+        //! Sets the line height of distance field fonts, the glyphs are scaled.
+        //! 0 (by default) uses the font's line height. It is ignored by bitmap fonts.
+        void setLineHeight(fzFloat lineHeight);
+        
+        
+        //! Returns the line height set with setLineHeight().
+        fzFloat getLineHeight() const {
+            return m_lineHeight;
+        }
+        
+        
+        //! Sets an outline, only for distance field fonts.
+        //! @param width 0 (no outline) to 1 (the whole spread of the distance field).
+        void setOutline(const fzColor4F& color, fzFloat width);
+        
+        
+        //! Sets a glow behind the text (and its outline), only for distance field fonts.
+        //! @param width 0 (no glow) to 1 (the whole spread of the distance field).
+        void setGlow(const fzColor4F& color, fzFloat width);
 
         
         // Redefined
         virtual void setColor(const fzColor3B& color) override;
         virtual const fzColor3B& getColor() const override;
+        virtual void render(unsigned char) override;
+        virtual void draw() override;
     };
 }
 #endif
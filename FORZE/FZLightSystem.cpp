@@ -27,8 +27,11 @@
  @author Manuel Martínez-Almeida
  */
 
+#include <string.h>
+#include <algorithm>
 #include "FZLightSystem.h"
 #include "FZSpriteBatch.h"
+#include "FZTMXLayer.h"
 #include "FZTexture2D.h"
 #include "FZPrimitives.h"
 #include "FZGLState.h"
@@ -38,6 +41,13 @@
 #include "FZMath.h"
 #include "FZMacros.h"
 #include "FZMS.h"
+#include "FZGLProgram.h"
+#include "FZWorkerPool.h"
+#include "FZDeviceConfig.h"
+
+
+// Points between the tiles of the atlas, the lights never sample the neighbour tiles.
+#define FZ_LIGHT_ATLAS_PADDING 2
 
 
 using namespace STD;
@@ -47,13 +57,6 @@ namespace FORZE {
 #pragma mark - Helper lighting methods
     
     
-    inline fzPoint convertPoint(const fzPoint& current, const fzPoint& referencePoint)
-    {
-        fzPoint newPoint = Director::Instance().unnormalizedCoord(current);
-        return newPoint - referencePoint;
-    }
-    
-    
     inline fzInt previousVertex(fzInt current, fzInt total)
     {
         FZ_ASSERT(current >= 0 && total > 0, "Invalid indexes.");
@@ -101,8 +104,20 @@ namespace FORZE {
 
     LightSystem::LightSystem(Texture2D *texture, Node *batch)
     : m_grabber()
+    , p_atlas(NULL)
+    , m_atlasColumns(0)
+    , m_atlasRows(0)
+    , m_atlasMode(false)
     , p_batch(NULL)
     , p_texture(NULL)
+    , m_occluders()
+    , m_cells()
+    , m_columns(0)
+    , m_rows(0)
+    , m_spriteOccluders(0)
+    , m_meshVersion(0)
+    , m_shadows()
+    , p_shadowProgram(NULL)
     {
         FZ_ASSERT(batch != NULL, "Sprite batch cannot be NULL.");
         FZ_ASSERT(texture != NULL, "Texture cannot be NULL.");
@@ -113,6 +128,9 @@ namespace FORZE {
 #if FZ_GL_SHADERS
         // SHADER
         setGLProgram(kFZShader_mat_TEX);
+        
+        p_shadowProgram = ShaderCache::Instance().getProgramByKey(kFZShader_mat_aC4);
+        p_shadowProgram->retain();
 #endif
     }
     
@@ -126,6 +144,11 @@ namespace FORZE {
     {
         setTexture(NULL);
         setBatch(NULL);
+        delete p_atlas;
+        
+#if FZ_GL_SHADERS
+        p_shadowProgram->release();
+#endif
     }
     
     
@@ -165,6 +188,32 @@ namespace FORZE {
     void LightSystem::setBatch(Node *batch)
     {
         FZRETAIN_TEMPLATE(batch, p_batch);
+        
+        // the occluders grid is built again
+        m_columns = 0;
+    }
+    
+    
+    void LightSystem::setAtlasMode(bool atlasMode)
+    {
+        if(atlasMode == m_atlasMode)
+            return;
+        
+        m_atlasMode = atlasMode;
+        if(!atlasMode) {
+            delete p_atlas;
+            p_atlas = NULL;
+            
+            // the lights use the grabber again
+            Texture2D *texture = m_grabber.getTexture();
+            if(texture) {
+                Light *light;
+                FZ_LIST_FOREACH(m_children, light) {
+                    light->setTexture(texture);
+                    light->setTextureRect(fzRect(FZPointZero, texture->getContentSize()));
+                }
+            }
+        }
     }
 
     
@@ -194,6 +243,11 @@ namespace FORZE {
             m_quad.tr.texCoord = fzVec2(pixels.width / wide, pixels.height / high);
             
             
+            // the atlas tiles depend on the light size
+            delete p_atlas;
+            p_atlas = NULL;
+            
+            
             // CONFIG FBO GRABBER
             fzFloat quality = (fzFloat)p_texture->getFactor() / (fzFloat)Director::Instance().getResourcesFactor();
             m_grabber.config(kFZTextureFormat_RGBA8888, size, fzPoint(0.5f, 0.5f), quality);
@@ -210,137 +264,475 @@ namespace FORZE {
     }
 
     
-    void LightSystem::render(unsigned char dirtyFlags)
+#pragma mark - Occluders grid
+    
+    void LightSystem::setOccluder(fzOccluder& occluder, const fzVec2 *vertices, const float *inverse)
     {
-        Light *light;
+        copy(vertices, vertices + 4, occluder.vertices);
+        fzMath_mat4Vec2(inverse, reinterpret_cast<const float*>(vertices), reinterpret_cast<float*>(occluder.shape));
+        
+        fzVec2 min = occluder.shape[0];
+        fzVec2 max = occluder.shape[0];
+        for(fzUInt i = 1; i < 4; ++i) {
+            min.x = fzMin(min.x, occluder.shape[i].x);
+            min.y = fzMin(min.y, occluder.shape[i].y);
+            max.x = fzMax(max.x, occluder.shape[i].x);
+            max.y = fzMax(max.y, occluder.shape[i].y);
+        }
+        occluder.center = fzVec2((min.x + max.x) / 2, (min.y + max.y) / 2);
+        
+        // occluders outside the layer are kept in the border cells
+        occluder.cells[0] = fzMin<fzInt>(fzMax<fzInt>(floorf(min.x / FZ_LIGHT_GRID_CELL_SIZE), 0), m_columns-1);
+        occluder.cells[1] = fzMin<fzInt>(fzMax<fzInt>(floorf(min.y / FZ_LIGHT_GRID_CELL_SIZE), 0), m_rows-1);
+        occluder.cells[2] = fzMin<fzInt>(fzMax<fzInt>(floorf(max.x / FZ_LIGHT_GRID_CELL_SIZE), 0), m_columns-1);
+        occluder.cells[3] = fzMin<fzInt>(fzMax<fzInt>(floorf(max.y / FZ_LIGHT_GRID_CELL_SIZE), 0), m_rows-1);
+    }
+    
+    
+    void LightSystem::insertOccluder(fzUInt index)
+    {
+        const fzOccluder& occluder = m_occluders[index];
+        for(fzInt row = occluder.cells[1]; row <= occluder.cells[3]; ++row)
+            for(fzInt column = occluder.cells[0]; column <= occluder.cells[2]; ++column)
+                m_cells[column + row * m_columns].push_back(index);
+    }
+    
+    
+    void LightSystem::removeOccluder(fzUInt index)
+    {
+        const fzOccluder& occluder = m_occluders[index];
+        for(fzInt row = occluder.cells[1]; row <= occluder.cells[3]; ++row) {
+            for(fzInt column = occluder.cells[0]; column <= occluder.cells[2]; ++column)
+            {
+                vector<fzUInt>& cell = m_cells[column + row * m_columns];
+                vector<fzUInt>::iterator it(find(cell.begin(), cell.end(), index));
+                FZ_ASSERT(it != cell.end(), "Occluder is not in the cell.");
+                *it = cell.back();
+                cell.pop_back();
+            }
+        }
+    }
+    
+    
+    void LightSystem::removeOccluders(fzUInt first)
+    {
+        const fzUInt count = m_occluders.size();
+        if(first >= count)
+            return;
+        
+        if((count - first) * 2 > count) {
+            // most of the occluders are removed, it is faster to fill the cells again.
+            vector< vector<fzUInt> >::iterator it(m_cells.begin());
+            for(; it != m_cells.end(); ++it)
+                it->clear();
+            
+            m_occluders.resize(first);
+            for(fzUInt i = 0; i < first; ++i)
+                insertOccluder(i);
+            
+        } else {
+            for(fzUInt i = first; i < count; ++i)
+                removeOccluder(i);
+            
+            m_occluders.resize(first);
+        }
+    }
+    
+    
+    void LightSystem::updateOccluders()
+    {
+        // Sprite::getVertices() returns clip coordinates, the inverse transform converts them to LightSystem coordinates.
+        fzMat4 inverse;
+        fzMath_mat4Invert(m_transformMV, inverse);
+        
+        
+        // GRID
+        // It is built again when the LightSystem moves or resizes.
+        fzInt columns = fzMax<fzInt>(ceilf(m_contentSize.width / FZ_LIGHT_GRID_CELL_SIZE), 1);
+        fzInt rows = fzMax<fzInt>(ceilf(m_contentSize.height / FZ_LIGHT_GRID_CELL_SIZE), 1);
+        bool tilesAreDirty = false;
+        
+        if(columns != m_columns || rows != m_rows || memcmp(m_occludersTransform, m_transformMV, sizeof(fzMat4)) != 0)
+        {
+            memcpy(m_occludersTransform, m_transformMV, sizeof(fzMat4));
+            m_columns = columns;
+            m_rows = rows;
+            m_cells.clear();
+            m_cells.resize(columns * rows);
+            m_occluders.clear();
+            m_spriteOccluders = 0;
+            tilesAreDirty = true;
+        }
+        
+        
+        // SPRITES
+        // Only the sprites whose vertices changed are moved in the grid.
+        fzUInt index = 0;
+        fzVec2 vertices[4];
         Sprite *sprite;
-        fzUInt shapeSize;
-        fzUInt polySize = 1;
+        FZ_LIST_FOREACH(p_batch->getChildren(), sprite)
+        {
+            FZ_ASSERT(dynamic_cast<Sprite*>(sprite), "All children must be sprites.");
+            sprite->getVertices(reinterpret_cast<float*>(vertices));
+            
+            if(index < m_spriteOccluders && m_occluders[index].p_sprite == sprite) {
+                fzOccluder& occluder = m_occluders[index];
+                if(memcmp(occluder.vertices, vertices, sizeof(vertices)) != 0) {
+                    removeOccluder(index);
+                    setOccluder(occluder, vertices, inverse);
+                    insertOccluder(index);
+                }
+            } else {
+                // the children changed, the following occluders are added again.
+                if(index < m_occluders.size()) {
+                    removeOccluders(index);
+                    m_spriteOccluders = index;
+                    tilesAreDirty = true;
+                }
+                m_occluders.push_back(fzOccluder());
+                m_occluders.back().p_sprite = sprite;
+                setOccluder(m_occluders.back(), vertices, inverse);
+                insertOccluder(index);
+            }
+            ++index;
+        }
+        if(index < m_spriteOccluders) {
+            removeOccluders(index);
+            tilesAreDirty = true;
+        }
+        m_spriteOccluders = index;
         
-        register fzVec2 shape[10];
-        register fzVec2 finalShape[8];
-        float *shapeFloats = reinterpret_cast<float*>(shape);
         
+        // TMX TILES
+        // The tiles of a TMXLayer are not children, they are taken again when the tile mesh changes.
+        TMXLayer *layer = dynamic_cast<TMXLayer*>(p_batch);
+        if(layer && (tilesAreDirty || layer->getMeshVersion() != m_meshVersion))
+        {
+            removeOccluders(m_spriteOccluders);
+            m_meshVersion = layer->getMeshVersion();
+            
+            vector<fzVec2> tiles;
+            layer->getTileVertices(tiles);
+            
+            for(fzUInt i = 0; i < tiles.size(); i += 4) {
+                m_occluders.push_back(fzOccluder());
+                m_occluders.back().p_sprite = NULL;
+                setOccluder(m_occluders.back(), &tiles[i], inverse);
+                insertOccluder(m_occluders.size()-1);
+            }
+        }
+    }
+    
+    
+#pragma mark - Shadows
+    
+    static fzUInt generateShadowShape(fzVec2 *shape, fzFloat radius, fzVec2 *output)
+    {
+        const fzUInt shapeSize = 4;
+        fzVec2 finalShape[8];
+        fzUInt polySize;
         
-        // ITERATE LIGHTS
-        FZ_LIST_FOREACH(m_children, light)
-        {  
-            const fzPoint& reference = light->getPosition();
+        fzUInt i1 = 0, i2 = 1;
+        fzPoint dv1;
+        fzPoint dv2;
+        
+        
+        // GET DETERMINANT VERTICES
+        fzFloat maxAngle = 1000000;
+        {
+            for(fzUInt i = 0; i < (shapeSize-1); ++i)
+            {
+                for(fzUInt w = i+1; w < shapeSize; ++w)
+                {
+                    fzFloat angle = fastAngle(shape[i], shape[w]);
+                    if(angle < maxAngle) {
+                        maxAngle = angle;
+                        dv1 = shape[i]; i1 = i;
+                        dv2 = shape[w]; i2 = w;
+                    }
+                }
+            }
+        }
+        
+        
+        // GET INTERSECCION POINTS
+        { 
+            dv1.normalize();
+            dv2.normalize();
 
-            fzFloat radius = light->getContentSize().width/2;
-            fzFloat radius_2 = radius * radius;
+            fzPoint mv(dv1);
+            mv += dv2;
+            mv.normalize();
+            mv *= radius;
+            
+            fzPoint mp = mv;
+            mv = mv.getPerp();
             
+            fzFloat num = dv1.x*mp.y - dv1.y*mp.x;
+            fzFloat fi = num/(mv.x*dv1.y-mv.y*dv1.x);
+            fzPoint add = mv * fi;
+            finalShape[0] = fzVec2( mp - add );
+            finalShape[1] = fzVec2( mp + add );
+        }
+        polySize = 2;
+        
+        
+        // GET FACE
+        {
+            fzInt prev = previousVertex(i1, shapeSize);
+            fzInt next = nextVertex(i1, shapeSize);
+            
+            fzFloat anglePrev = fastAngle(dv1, shape[prev]-shape[i1]);
+            fzFloat angleNext = fastAngle(dv1, shape[next]-shape[i1]);
+            
+            if(angleNext < anglePrev) {
+                // NEXT IS THE FACE
+                for(fzUInt i = i1; i <= i2; ++i, ++polySize)
+                    finalShape[polySize] = shape[i];
+            }
+            else{
+                // PREV IS THE FACE
+                fzUInt faceCount = shapeSize-i2+i1+1;
+                fzUInt current = i1;
+                for(fzUInt i = 0; i < faceCount; ++i, ++polySize) {
+                    finalShape[polySize] = shape[current];
+                    current = previousVertex(current, shapeSize);
+                }
+            }
+        }
+        
+        
+        // ENSAMBLING POLYGON
+        generateShape(finalShape, output, polySize);
+        return polySize;
+    }
+    
+    
+    void LightSystem::generateShadows(void *ptr, fzUInt index)
+    {
+        const LightSystem *system = static_cast<const LightSystem*>(ptr);
+        fzLightShadows& shadows = const_cast<LightSystem*>(system)->m_shadows[index];
+        shadows.vertices.clear();
+        
+        const fzPoint& center = shadows.position;
+        const fzFloat radius = shadows.radius;
+        const fzFloat radius_2 = radius * radius;
+        
+        fzInt beginColumn = fzMax<fzInt>(floorf((center.x - radius) / FZ_LIGHT_GRID_CELL_SIZE), 0);
+        fzInt beginRow = fzMax<fzInt>(floorf((center.y - radius) / FZ_LIGHT_GRID_CELL_SIZE), 0);
+        fzInt endColumn = fzMin<fzInt>(floorf((center.x + radius) / FZ_LIGHT_GRID_CELL_SIZE), system->m_columns-1);
+        fzInt endRow = fzMin<fzInt>(floorf((center.y + radius) / FZ_LIGHT_GRID_CELL_SIZE), system->m_rows-1);
+        
+        fzVec2 shape[4];
+        fzVec2 strip[10];
+        fzV2_C4 vertex;
+        vertex.color = shadows.color;
+        
+        for(fzInt row = beginRow; row <= endRow; ++row) {
+            for(fzInt column = beginColumn; column <= endColumn; ++column)
+            {
+                const vector<fzUInt>& cell = system->m_cells[column + row * system->m_columns];
+                vector<fzUInt>::const_iterator it(cell.begin());
+                for(; it != cell.end(); ++it)
+                {
+                    const fzOccluder& occluder = system->m_occluders[*it];
+                    
+                    // An occluder can be in several cells, it is only visited in the first one of the query.
+                    // The grid is shared by all the lights, it is never written here.
+                    if(fzMax(occluder.cells[0], beginColumn) != column || fzMax(occluder.cells[1], beginRow) != row)
+                        continue;
+                    
+                    if(center.distanceSquared(occluder.center) > radius_2)
+                        continue;
+                    
+                    for(fzUInt i = 0; i < 4; ++i)
+                        shape[i] = occluder.shape[i] - center;
+                    
+                    // the triangle strip is converted to triangles, all the shadows are drawn at once.
+                    fzUInt stripSize = generateShadowShape(shape, radius, strip);
+                    for(fzUInt i = 2; i < stripSize; ++i) {
+                        vertex.vertex = strip[i-2];
+                        shadows.vertices.push_back(vertex);
+                        vertex.vertex = strip[i-1];
+                        shadows.vertices.push_back(vertex);
+                        vertex.vertex = strip[i];
+                        shadows.vertices.push_back(vertex);
+                    }
+                }
+            }
+        }
+    }
+    
+    
+    void LightSystem::drawShadows(const fzLightShadows& shadows, const fzBlendFunc& blend)
+    {
+        if(shadows.vertices.empty())
+            return;
+        
+        fzGLBlendFunc(blend);
+        fzGLSetMode(kFZGLMode_NoTexture);
+        
+        const fzV2_C4 *vertices = &shadows.vertices.front();
+        
+#if FZ_GL_SHADERS
+        p_shadowProgram->use();
+        FZ_PROGRAM_APPLY_TRANSFORM(p_shadowProgram);
+        
+        glVertexAttribPointer(kFZAttribPosition, 2, GL_FLOAT, GL_FALSE, sizeof(fzV2_C4), &vertices->vertex);
+        glVertexAttribPointer(kFZAttribColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(fzV2_C4), &vertices->color);
+#else
+        glVertexPointer(2, GL_FLOAT, sizeof(fzV2_C4), &vertices->vertex);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(fzV2_C4), &vertices->color);
+#endif
+        
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)shadows.vertices.size());
+    }
+    
+    
+#pragma mark - Rendering
+    
+    void LightSystem::render(unsigned char dirtyFlags)
+    {
+        updateOccluders();
+        
+        // SHADOW GEOMETRY
+        // The shadows of every light are generated by the workers before any OpenGL call.
+        Light *light;
+        fzUInt index = 0;
+        m_shadows.resize(m_children.size());
+        FZ_LIST_FOREACH(m_children, light)
+        {
+            fzLightShadows& shadows = m_shadows[index++];
+            shadows.position = light->getPosition();
+            shadows.radius = light->getContentSize().width/2;
+            shadows.color = fzColor4B(light->getShadowColor().r, light->getShadowColor().g, light->getShadowColor().b, 0);
+        }
+        WorkerPool::Instance().parallelFor(generateShadows, this, index);
+        
+        if(m_atlasMode) {
+            renderAtlas(dirtyFlags);
+            return;
+        }
+        
+        // ITERATE LIGHTS
+        index = 0;
+        FZ_LIST_FOREACH(m_children, light)
+        {
             // FBO
             m_grabber.begin();
             
 #if !FZ_GL_SHADERS
             glLoadMatrixf(MS::getMatrix());
 #endif
-
             
             // DRAW LIGHT TEXTURE
             drawTexture();
             
+            // DRAW SHADOWS
+            drawShadows(m_shadows[index++], light->getShadowBlendFunc());
             
-            FZ_LIST_FOREACH(p_batch->getChildren(), sprite)
-            {
-                FZ_ASSERT(dynamic_cast<Sprite*>(sprite), "All children must be sprites.");
-                
-                if(reference.distanceSquared(sprite->getPosition()) > radius_2)
-                    continue;
-                
-                shapeSize = 4;
-                sprite->getVertices(shapeFloats);
-                for(fzUInt i = 0; i < shapeSize; ++i)
-                    shape[i] = convertPoint(shape[i], reference);
-
+            m_grabber.end();
 
-                fzUInt i1 = 0, i2 = 1;
-                fzPoint dv1;
-                fzPoint dv2;
-                
+            
+            light->makeDirty(dirtyFlags);
+            light->internalVisit();
+        }
+    }
+    
+    
+    void LightSystem::configAtlas(fzUInt lights)
+    {
+        if(p_atlas && lights <= m_atlasColumns * m_atlasRows)
+            return;
+        
+        const fzSize& size = p_texture->getContentSize();
+        fzFloat factor = p_texture->getFactor();
+        fzFloat maxSize = fzMin<fzInt>(FZ_LIGHT_ATLAS_MAX_SIZE, DeviceConfig::Instance().getMaxTextureSize()) / factor;
+        
+        fzUInt maxColumns = fzMax<fzInt>(maxSize / (size.width + FZ_LIGHT_ATLAS_PADDING), 1);
+        fzUInt maxRows = fzMax<fzInt>(maxSize / (size.height + FZ_LIGHT_ATLAS_PADDING), 1);
+        fzUInt columns = fzMin<fzUInt>(lights, maxColumns);
+        fzUInt rows = fzMin<fzUInt>((lights + columns - 1) / columns, maxRows);
+        
+        // the atlas is already as big as possible
+        if(p_atlas && columns * rows <= m_atlasColumns * m_atlasRows)
+            return;
+        
+        delete p_atlas;
+        
+        fzFloat quality = factor / (fzFloat)Director::Instance().getResourcesFactor();
+        fzSize atlasSize(columns * (size.width + FZ_LIGHT_ATLAS_PADDING), rows * (size.height + FZ_LIGHT_ATLAS_PADDING));
+        p_atlas = new FBOTexture(kFZTextureFormat_RGBA8888, atlasSize, quality);
+        m_atlasColumns = columns;
+        m_atlasRows = rows;
+    }
+    
+    
+    void LightSystem::renderAtlas(unsigned char dirtyFlags)
+    {
+        if(m_shadows.empty())
+            return;
+        
+        configAtlas(m_shadows.size());
+        
+        Texture2D *texture = p_atlas->getTexture();
+        const fzSize& size = p_texture->getContentSize();
+        const fzSize& atlasSize = texture->getContentSize();
+        const fzFloat factor = texture->getFactor();
+        const fzUInt capacity = m_atlasColumns * m_atlasRows;
+        
+        // The lights that do not fit in the atlas are rendered in the next passes.
+        Light *first = static_cast<Light*>(m_children.front());
+        fzUInt index = 0;
+        while(first)
+        {
+            // FBO
+            p_atlas->begin();
+            glEnable(GL_SCISSOR_TEST);
+            
+            Light *light = first;
+            for(fzUInt tile = 0; light && tile < capacity; ++tile, ++index)
+            {
+                fzRect rect(fzPoint((tile % m_atlasColumns) * (size.width + FZ_LIGHT_ATLAS_PADDING),
+                                    (tile / m_atlasColumns) * (size.height + FZ_LIGHT_ATLAS_PADDING)), size);
                 
-                // GET DETERMINANT VERTICES
-                fzFloat maxAngle = 1000000;
-                {
-                    for(fzUInt i = 0; i < (shapeSize-1); ++i)
-                    {
-                        for(fzUInt w = i+1; w < shapeSize; ++w)
-                        {
-                            fzFloat angle = fastAngle(shape[i], shape[w]);
-                            if(angle < maxAngle) {
-                                maxAngle = angle;
-                                dv1 = shape[i]; i1 = i;
-                                dv2 = shape[w]; i2 = w;
-                            }
-                        }
-                    }
-                }
+                // Same projection as the grabber, centered in the tile.
+                fzFloat anchorX = rect.origin.x + size.width/2;
+                fzFloat anchorY = atlasSize.height - rect.origin.y - size.height/2;
+                fzMath_mat4OrthoProjection(-anchorX, atlasSize.width - anchorX,
+                                           atlasSize.height - anchorY, -anchorY,
+                                           -1500, 1500, m_tileTransform);
+                MS::loadMatrix(m_tileTransform);
                 
+#if !FZ_GL_SHADERS
+                glLoadMatrixf(m_tileTransform);
+#endif
+                // the shadows can go further than the light texture
+                glScissor((GLint)(rect.origin.x * factor), (GLint)(rect.origin.y * factor),
+                          (GLsizei)(size.width * factor), (GLsizei)(size.height * factor));
                 
-                // GET INTERSECCION POINTS
-                { 
-                    dv1.normalize();
-                    dv2.normalize();
-
-                    fzPoint mv(dv1);
-                    mv += dv2;
-                    mv.normalize();
-                    mv *= radius;
-                    
-                    fzPoint mp = mv;
-                    mv = mv.getPerp();
-                    
-                    fzFloat num = dv1.x*mp.y - dv1.y*mp.x;
-                    fzFloat fi = num/(mv.x*dv1.y-mv.y*dv1.x);
-                    fzPoint add = mv * fi;
-                    finalShape[0] = fzVec2( mp - add );
-                    finalShape[1] = fzVec2( mp + add );
-                }
-                polySize = 2;
+                // DRAW LIGHT TEXTURE
+                drawTexture();
                 
+                // DRAW SHADOWS
+                drawShadows(m_shadows[index], light->getShadowBlendFunc());
                 
-                // GET FACE
-                {
-                    fzInt prev = previousVertex(i1, shapeSize);
-                    fzInt next = nextVertex(i1, shapeSize);
-                    
-                    fzFloat anglePrev = fastAngle(dv1, shape[prev]-shape[i1]);
-                    fzFloat angleNext = fastAngle(dv1, shape[next]-shape[i1]);
-                    
-                    if(angleNext < anglePrev) {
-                        // NEXT IS THE FACE
-                        for(fzUInt i = i1; i <= i2; ++i, ++polySize)
-                            finalShape[polySize] = shape[i];
-                    }
-                    else{
-                        // PREV IS THE FACE
-                        fzUInt faceCount = shapeSize-i2+i1+1;
-                        fzUInt current = i1;
-                        for(fzUInt i = 0; i < faceCount; ++i, ++polySize) {
-                            finalShape[polySize] = shape[current];
-                            current = previousVertex(current, shapeSize);
-                        }
-                    }
+                if(light->getTexture() != texture || light->getTextureRect() != rect) {
+                    light->setTexture(texture);
+                    light->setTextureRect(rect);
                 }
-                
-                
-                // ENSAMBLING POLYGON
-                generateShape(finalShape, shape, polySize);
-                
-                fzGLBlendFunc(light->getShadowBlendFunc());
-
-                fzColor4F color(light->getShadowColor());
-                color.a = 0;
-
-                fzGLColor(color);
-                fzDrawShape(shape, polySize);
+                light = static_cast<Light*>(light->next());
             }
-            m_grabber.end();
-
             
-            light->makeDirty(dirtyFlags);
-            light->internalVisit();
+            glDisable(GL_SCISSOR_TEST);
+            p_atlas->end();
+            
+            
+            // COMPOSITE
+            for(; first != light; first = static_cast<Light*>(first->next())) {
+                first->makeDirty(dirtyFlags);
+                first->internalVisit();
+            }
         }
     }
     
@@ -33,12 +33,51 @@
 #include "FZSprite.h"
 #include "FZLayer.h"
 #include "FZGrabber.h"
+#include STL_VECTOR
 
 
 using namespace STD;
 
 namespace FORZE {
     
+    //! Shadow caster, in LightSystem coordinates.
+    struct fzOccluder
+    {
+        //! Sprite of the batch, NULL for the tiles of a TMXLayer.
+        const Sprite *p_sprite;
+        
+        //! Vertices as returned by Sprite::getVertices(), used to detect the occluders that moved.
+        fzVec2 vertices[4];
+        
+        //! Vertices in LightSystem coordinates.
+        fzVec2 shape[4];
+        fzVec2 center;
+        
+        //! Grid cells covered by the occluder: first column, first row, last column, last row.
+        fzInt cells[4];
+    };
+    
+    
+    //! Shadow vertex, colored per vertex so the shadows of a light are drawn in a single call.
+    struct fzV2_C4
+    {
+        fzVec2      vertex;
+        fzColor4B   color;
+    };
+    
+    
+    //! Shadows of a light, generated by the workers before the rendering.
+    struct fzLightShadows
+    {
+        fzPoint position;
+        fzFloat radius;
+        fzColor4B color;
+        
+        //! Triangles in light coordinates.
+        vector<fzV2_C4> vertices;
+    };
+    
+    
     class LightSystem;
     class Light : public Sprite
     {
@@ -78,10 +117,39 @@ namespace FORZE {
     protected:
         Texture2D *p_texture;
         FBOTexture m_grabber;
+        FBOTexture *p_atlas;
+        fzUInt m_atlasColumns;
+        fzUInt m_atlasRows;
+        fzMat4 m_tileTransform;
+        bool m_atlasMode;
         Node *p_batch;
         _fzT2_V2_Quad m_quad;
         
+        // Uniform grid of occluders, cells of FZ_LIGHT_GRID_CELL_SIZE points.
+        // Only the occluders that moved since the last frame are moved to other cells.
+        vector<fzOccluder> m_occluders;
+        vector< vector<fzUInt> > m_cells;
+        fzInt m_columns;
+        fzInt m_rows;
+        fzUInt m_spriteOccluders;
+        fzUInt m_meshVersion;
+        fzMat4 m_occludersTransform;
+        
+        // shadow geometry of every light
+        vector<fzLightShadows> m_shadows;
+        GLProgram *p_shadowProgram;
+        
+        void updateOccluders();
+        void insertOccluder(fzUInt index);
+        void removeOccluder(fzUInt index);
+        void removeOccluders(fzUInt first);
+        void setOccluder(fzOccluder& occluder, const fzVec2 *vertices, const float *inverse);
+        
+        static void generateShadows(void *lightSystem, fzUInt index);
+        void drawShadows(const fzLightShadows& shadows, const fzBlendFunc& blend);
         void drawTexture();
+        void configAtlas(fzUInt lights);
+        void renderAtlas(unsigned char dirtyFlags);
         virtual void insertChild(Node* node) override;
         
     public:
@@ -100,6 +168,18 @@ namespace FORZE {
         void setBatch(Node *batch);
         
         
+        //! Enables the atlas mode, disabled by default.
+        //! In atlas mode the lights are rendered to the tiles of a single offscreen target in one pass,
+        //! instead of switching the render target once per light.
+        //! @see FZ_LIGHT_ATLAS_MAX_SIZE
+        void setAtlasMode(bool atlasMode);
+        
+        //! Returns true if the atlas mode is enabled.
+        bool isAtlasMode() const {
+            return m_atlasMode;
+        }
+        
+        
         // Redefined
         virtual void setTexture(Texture2D*) override;
         virtual Texture2D *getTexture() const override;
@@ -0,0 +1,166 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include "FZMemoryManager.h"
+#include "FZScheduler.h"
+#include "FZMacros.h"
+
+
+using namespace STD;
+
+namespace FORZE {
+    
+    MemoryManager* MemoryManager::p_instance = NULL;
+    
+    MemoryManager& MemoryManager::Instance()
+    {
+        if (p_instance == NULL)
+            p_instance = new MemoryManager();
+        
+        return *p_instance;
+    }
+    
+    
+    MemoryManager::MemoryManager()
+    : m_caches()
+    , m_softLimit(0)
+    , m_coldFrames(600)
+    {
+        memset(&m_lastReport, 0, sizeof(m_lastReport));
+    }
+    
+    
+    void MemoryManager::addCache(Protocol::Memory *cache)
+    {
+        FZ_ASSERT(cache != NULL, "Cache can not be NULL.");
+        FZ_ASSERT(find(m_caches.begin(), m_caches.end(), cache) == m_caches.end(), "Cache is already registered.");
+        
+        m_caches.push_back(cache);
+    }
+    
+    
+    void MemoryManager::removeCache(Protocol::Memory *cache)
+    {
+        vector<Protocol::Memory*>::iterator it(find(m_caches.begin(), m_caches.end(), cache));
+        if(it != m_caches.end())
+            m_caches.erase(it);
+    }
+    
+    
+    fzUInt MemoryManager::getMemoryUsage() const
+    {
+        fzUInt usage = 0;
+        vector<Protocol::Memory*>::const_iterator it(m_caches.begin());
+        for(; it != m_caches.end(); ++it)
+            usage += (*it)->getMemoryUsage();
+        
+        return usage;
+    }
+    
+    
+    const fzMemoryReport& MemoryManager::purge(fzUInt maxMemory)
+    {
+        memset(&m_lastReport, 0, sizeof(m_lastReport));
+        
+        fzUInt usage = getMemoryUsage();
+        m_lastReport.before = usage;
+        
+        for(fzUInt tier = 0; tier < kFZMemoryTier_Count && usage > maxMemory; ++tier)
+        {
+            // Releasing an object can make others unused (a font retains its texture),
+            // so the tier is purged again while it keeps releasing memory.
+            fzUInt freed;
+            do {
+                freed = 0;
+                vector<Protocol::Memory*>::iterator it(m_caches.begin());
+                for(; it != m_caches.end() && usage > maxMemory; ++it)
+                {
+                    fzUInt cacheUsage = (*it)->getMemoryUsage();
+                    (*it)->releaseMemory(static_cast<fzMemoryTier>(tier));
+                    fzUInt newUsage = (*it)->getMemoryUsage();
+                    
+                    if(newUsage < cacheUsage) {
+                        freed += cacheUsage - newUsage;
+                        usage -= cacheUsage - newUsage;
+                    }
+                }
+                m_lastReport.freed[tier] += freed;
+                
+            } while(freed > 0 && usage > maxMemory);
+        }
+        m_lastReport.after = usage;
+        
+        FZLOGINFO("MemoryManager: %d KB released (cold: %d KB, unused: %d KB, reloadable: %d KB). %d KB in use.",
+                  (m_lastReport.before - usage) / 1024,
+                  m_lastReport.freed[kFZMemoryTier_Cold] / 1024,
+                  m_lastReport.freed[kFZMemoryTier_Unused] / 1024,
+                  m_lastReport.freed[kFZMemoryTier_Reloadable] / 1024,
+                  usage / 1024);
+        
+        return m_lastReport;
+    }
+    
+    
+    void MemoryManager::didReceiveMemoryWarning()
+    {
+        purge(0);
+    }
+    
+    
+    void MemoryManager::setSoftLimit(fzUInt bytes)
+    {
+        if(m_softLimit == 0 && bytes > 0)
+            Scheduler::Instance().scheduleSelector(SEL_FLOAT(MemoryManager::checkSoftLimit), this, 1, false, 2, kFZUpdatePhase_PostUpdate);
+        
+        else if(m_softLimit > 0 && bytes == 0)
+            Scheduler::Instance().unscheduleSelector(SEL_FLOAT(MemoryManager::checkSoftLimit), this);
+        
+        m_softLimit = bytes;
+    }
+    
+    
+    void MemoryManager::checkSoftLimit(fzFloat)
+    {
+        if(m_softLimit > 0 && getMemoryUsage() > m_softLimit)
+            purge(m_softLimit);
+    }
+    
+    
+    void MemoryManager::log() const
+    {
+        FZLog("MemoryManager: %d KB (soft limit: %d KB)", getMemoryUsage() / 1024, m_softLimit / 1024);
+        
+        vector<Protocol::Memory*>::const_iterator it(m_caches.begin());
+        for(; it != m_caches.end(); ++it)
+            FZLog(" - %s: %d KB", (*it)->getMemoryName(), (*it)->getMemoryUsage() / 1024);
+    }
+}
@@ -0,0 +1,142 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZMEMORYMANAGER_H_INCLUDED__
+#define __FZMEMORYMANAGER_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZProtocols.h"
+#include "FZSelectors.h"
+#include STL_VECTOR
+
+using namespace STD;
+
+namespace FORZE {
+    
+    //! Memory released by MemoryManager::purge().
+    struct fzMemoryReport
+    {
+        fzUInt before;
+        fzUInt after;
+        fzUInt freed[kFZMemoryTier_Count];
+    };
+    
+    
+    /** MemoryManager reclaims memory across all the engine's caches.
+     * Each cache (TextureCache, SpriteFrameCache, AnimationCache, FontCache, ShaderCache,
+     * ResourcesManager and DataStore) registers itself and reports its usage.
+     * When memory must be released, the tiers are purged from the cheapest to the most expensive
+     * (cold, unused, reloadable), cache by cache, and it stops as soon as the target is reached.
+     *
+     * It is triggered by the OS memory warnings (Director::applicationDidReceiveMemoryWarning())
+     * and, if it is set, by a soft limit checked once per second.
+     */
+    class MemoryManager : public SELProtocol
+    {
+    private:
+        // Manager's instance
+        static MemoryManager* p_instance;
+        
+        vector<Protocol::Memory*> m_caches;
+        fzMemoryReport m_lastReport;
+        fzUInt m_softLimit;
+        fzUInt m_coldFrames;
+        
+        void checkSoftLimit(fzFloat dt);
+        
+        
+    protected:
+        // Constructors
+        MemoryManager();
+        MemoryManager(const MemoryManager&);
+        MemoryManager &operator = (const MemoryManager&);
+        
+        
+    public:
+        //! Gets and allocates the singleton.
+        static MemoryManager& Instance();
+        
+        
+        //! Registers a cache. The caches register themselves when they are created.
+        void addCache(Protocol::Memory *cache);
+        
+        
+        //! Unregisters a cache.
+        void removeCache(Protocol::Memory *cache);
+        
+        
+        //! Returns the memory used by all the registered caches in bytes.
+        fzUInt getMemoryUsage() const;
+        
+        
+        //! Releases memory, cheapest tier first, until the usage is lower or equal than maxMemory.
+        //! purge(0) releases everything that can be released.
+        //! @return what was released.
+        const fzMemoryReport& purge(fzUInt maxMemory);
+        
+        
+        //! Called by the Director when the OS sends a memory warning.
+        //! Everything that can be released is released.
+        void didReceiveMemoryWarning();
+        
+        
+        //! Sets a soft limit in bytes. If the caches use more memory, they are purged down to the limit.
+        //! 0 means no limit (default).
+        void setSoftLimit(fzUInt bytes);
+        
+        
+        //! @see setSoftLimit()
+        fzUInt getSoftLimit() const {
+            return m_softLimit;
+        }
+        
+        
+        //! Sets the number of frames a cached object must be unrequested to be considered cold.
+        //! 600 by default (10 seconds at 60fps).
+        void setColdFrames(fzUInt frames) {
+            m_coldFrames = frames;
+        }
+        
+        
+        //! @see setColdFrames()
+        fzUInt getColdFrames() const {
+            return m_coldFrames;
+        }
+        
+        
+        //! Returns the report of the last purge.
+        const fzMemoryReport& getLastReport() const {
+            return m_lastReport;
+        }
+        
+        
+        //! Logs the memory used by each cache.
+        void log() const;
+    };
+}
+#endif
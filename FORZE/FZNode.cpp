@@ -49,6 +49,11 @@ namespace FORZE {
     Node::Node()
     : m_children                 ()
     , m_dirtyFlags               (kFZDirty_all)
+    , m_updatePolicy             (kFZUpdatePolicy_Always)
+    , m_updateDecision           (kFZUpdateDecision_Update)
+    , m_updateFrames             (1)
+    , m_updateOffset             (0)
+    , m_updateDecisionFrame      (0)
     , m_isRunning                (false)
     , m_isVisible                (true)
     , m_isRelativeAnchorPoint    (true)
@@ -288,6 +293,28 @@ namespace FORZE {
     }
     
     
+    bool Node::isVisibleInHierarchy() const
+    {
+        const Node *node = this;
+        for(; node; node = node->p_parent) {
+            if(!node->m_isVisible)
+                return false;
+        }
+        return true;
+    }
+    
+    
+    bool Node::isOnScreen()
+    {
+        // m_transformMV is only valid after the node was rendered.
+        if(m_dirtyFlags & kFZDirty_transform_absolute)
+            return true;
+        
+        fzRect canvas(FZPointZero, Director::Instance().getCanvasSize());
+        return getBoundingBox().intersect(canvas);
+    }
+    
+    
     fzRect Node::getLocalBoundingBox()
     {
         fzRect rect(FZPointZero, m_contentSize);
@@ -624,7 +651,7 @@ namespace FORZE {
     
     Action* Node::runAction(Action *action)
     {        
-        ActionManager::Instance().addAction(action, this, !m_isRunning);
+        ActionManager::Instance().addAction(action, this, !m_isRunning, getActivePolicy());
         return action;
     }
     
@@ -676,9 +703,9 @@ namespace FORZE {
     }
 
     
-    void Node::schedule(const SELECTOR_FLOAT selector, fzFloat interval)
+    void Node::schedule(const SELECTOR_FLOAT selector, fzFloat interval, fzUpdatePhase phase, bool concurrent)
     {        
-        Scheduler::Instance().scheduleSelector(selector, this, interval, !m_isRunning);
+        Scheduler::Instance().scheduleSelector(selector, this, interval, !m_isRunning, 2, phase, concurrent, getActivePolicy());
     }
     
     
@@ -711,6 +738,54 @@ namespace FORZE {
     }
     
     
+    void Node::setUpdatePolicy(fzUpdatePolicy policy, fzUInt frames)
+    {
+        FZ_ASSERT(frames > 0, "Number of frames must be positive.");
+        
+        // throttled nodes are distributed across the frames.
+        static fzUInt offset = 0;
+        
+        m_updatePolicy = policy;
+        m_updateFrames = (policy == kFZUpdatePolicy_Throttled) ? frames : 1;
+        m_updateOffset = offset++;
+        m_updateDecisionFrame = 0;
+        
+        Scheduler::Instance().setUpdatePolicy(this, getActivePolicy());
+        ActionManager::Instance().setUpdatePolicy(this, getActivePolicy());
+    }
+    
+    
+    fzUpdateDecision Node::getUpdateDecision(fzUInt frame)
+    {
+        // The decision is computed once per frame, all timers and actions share it.
+        if(m_updateDecisionFrame == frame)
+            return static_cast<fzUpdateDecision>(m_updateDecision);
+        
+        fzUpdateDecision decision;
+        switch (m_updatePolicy) {
+            case kFZUpdatePolicy_WhenVisible:
+                decision = isVisibleInHierarchy() ? kFZUpdateDecision_Update : kFZUpdateDecision_Sleep;
+                break;
+                
+            case kFZUpdatePolicy_WhenOnScreen:
+                decision = (isVisibleInHierarchy() && isOnScreen()) ? kFZUpdateDecision_Update : kFZUpdateDecision_Sleep;
+                break;
+                
+            case kFZUpdatePolicy_Throttled:
+                decision = ((frame + m_updateOffset) % m_updateFrames == 0) ? kFZUpdateDecision_Update : kFZUpdateDecision_Skip;
+                break;
+                
+            default:
+                decision = kFZUpdateDecision_Update;
+                break;
+        }
+        m_updateDecision = decision;
+        m_updateDecisionFrame = frame;
+        
+        return decision;
+    }
+    
+    
     void Node::resumeSchedulerAndActions()
     {
         Scheduler::Instance().resumeTarget(this);
@@ -36,6 +36,7 @@
 #include "FZLifeCycle.h"
 #include "FZAutoList.h"
 #include "FZSelectors.h"
+#include "FZScheduler.h"
 #include "FZMath.h"
 #include "FZDirector.h"
 
@@ -81,6 +82,26 @@ namespace FORZE {
     };
     
     
+    /** @enum fzUpdatePolicy
+     * Update level of detail. It decides when the scheduled selectors and the actions of a node are triggered.
+     * Useful to stop spending CPU in cosmetic animations that can not be seen.
+     */
+    enum fzUpdatePolicy
+    {
+        //! Always updated. Default value.
+        kFZUpdatePolicy_Always,
+        
+        //! Only updated while the node and all its ancestors are visible.
+        kFZUpdatePolicy_WhenVisible,
+        
+        //! Only updated while visible and its bounding box intersects the canvas.
+        kFZUpdatePolicy_WhenOnScreen,
+        
+        //! Updated once every N frames, the delta time is accumulated.
+        kFZUpdatePolicy_Throttled
+    };
+    
+    
     enum {
         NODE_BACK = INTPTR_MIN,
         NODE_TOP = INTPTR_MAX,
@@ -99,7 +120,7 @@ namespace FORZE {
     /** Node is the main element.
      * Everything to be rendered inside FORZE must be a subclass of Node.
      */
-    class Node : public fzListItem, public LifeCycle
+    class Node : public fzListItem, public LifeCycle, public UpdatePolicyProtocol
     {
         friend class NodeManager;
         friend class NodeList;
@@ -118,6 +139,13 @@ namespace FORZE {
         // dirty tags
         unsigned char m_dirtyFlags;
         
+        // update policy
+        unsigned char m_updatePolicy;
+        unsigned char m_updateDecision;
+        fzUInt m_updateFrames;
+        fzUInt m_updateOffset;
+        fzUInt m_updateDecisionFrame;
+        
         // cached absolute transform matrix
         fzMat4 m_transformMV;
         
@@ -192,6 +220,13 @@ namespace FORZE {
         //! Pauses all scheduled selectors and actions.
         void pauseSchedulerAndActions();
         
+        
+        //! Returns the policy passed to the Scheduler and the ActionManager.
+        //! NULL if the node is always updated.
+        UpdatePolicyProtocol* getActivePolicy() {
+            return (m_updatePolicy == kFZUpdatePolicy_Always) ? NULL : this;
+        }
+        
 
 #pragma mark - Internal children management
 
@@ -375,6 +410,15 @@ namespace FORZE {
         }
         
         
+        //! Returns true if the node and all its ancestors are visible.
+        bool isVisibleInHierarchy() const;
+        
+        
+        //! Returns true if the bounding box of the node, as it was rendered the last time, intersects the canvas.
+        //! If the node was not rendered since it was transformed, it returns true.
+        bool isOnScreen();
+        
+        
         //! Returns if the node is running.
         //! @see onEnter()
         //! @see onExit()
@@ -581,9 +625,13 @@ namespace FORZE {
 
         //! Schedules a custom selector with an calling interval.
         //! @param interval cannot be negative.
+        //! @param phase in which the selector is called.
+        //! @param concurrent if true, the selector may be called from a worker thread. It must only modify this node.
+        //! @see Scheduler
         //! @see unschedule()
         //! @see unscheduleAllSelectors()
-        void schedule(const SELECTOR_FLOAT selector, fzFloat interval);
+        void schedule(const SELECTOR_FLOAT selector, fzFloat interval,
+                      fzUpdatePhase phase = kFZUpdatePhase_Update, bool concurrent = false);
         
         
         //! Schedules the update(fzFloat) selector.
@@ -611,6 +659,24 @@ namespace FORZE {
         void unscheduleAllSelectors();
         
         
+        //! Sets the update policy (update level of detail) of the node.
+        //! It is honoured by the scheduled selectors and the running actions of this node (NOT INCLUDING children).
+        //! @param frames number of frames between updates, only used by kFZUpdatePolicy_Throttled.
+        //! @see fzUpdatePolicy
+        void setUpdatePolicy(fzUpdatePolicy policy, fzUInt frames = 1);
+        
+        
+        //! Returns the update policy.
+        //! @see setUpdatePolicy()
+        fzUpdatePolicy getUpdatePolicy() const {
+            return static_cast<fzUpdatePolicy>(m_updatePolicy);
+        }
+        
+        
+        //! UpdatePolicyProtocol implementation.
+        fzUpdateDecision getUpdateDecision(fzUInt frame);
+        
+        
 #pragma mark - Actions management
         
         //! Executes an action.
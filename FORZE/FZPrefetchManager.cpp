@@ -0,0 +1,247 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include <string.h>
+#include <typeinfo>
+
+#include "FZPrefetchManager.h"
+#include "FZPreloader.h"
+#include "FZResourcesManager.h"
+#include "FZScheduler.h"
+#include "FZDataStore.h"
+#include "FZTransitions.h"
+#include "FZHash.h"
+#include "FZMacros.h"
+#include "external/tinythread/tinythread.h"
+
+
+#define STRING_MAX_SIZE 512
+
+using namespace STD;
+
+namespace FORZE {
+    
+    static thread::id s_mainThread;
+    
+    PrefetchManager* PrefetchManager::p_instance = NULL;
+    
+    PrefetchManager& PrefetchManager::Instance()
+    {
+        if (p_instance == NULL)
+            p_instance = new PrefetchManager();
+        
+        return *p_instance;
+    }
+    
+    
+    PrefetchManager::PrefetchManager()
+    : m_recorded()
+    , p_recordingKey(NULL)
+    , m_recordingTime(3)
+    , m_isEnabled(false)
+    {
+        // the singleton is created by the Director, in the main thread.
+        s_mainThread = this_thread::get_id();
+    }
+    
+    
+    void PrefetchManager::record(fzPrefetchType type, const char *filename)
+    {
+        // The requests done by the workers (preloaders) are not part of the scene.
+        if(p_instance == NULL || this_thread::get_id() != s_mainThread)
+            return;
+        
+        if(p_instance->p_recordingKey)
+            p_instance->addEntry(type, filename);
+    }
+    
+    
+    void PrefetchManager::setEnabled(bool enabled)
+    {
+        if(!enabled)
+            stopRecording(0);
+        
+        m_isEnabled = enabled;
+    }
+    
+    
+    void PrefetchManager::addEntry(char type, const char *filename)
+    {
+        FZ_ASSERT(filename != NULL, "Filename can not be NULL.");
+        
+        uint32_t hash = fzHash(filename) ^ static_cast<uint32_t>(type);
+        vector<fzManifestEntry>::const_iterator it(m_recorded.begin());
+        for(; it != m_recorded.end(); ++it) {
+            if(it->hash == hash)
+                return;
+        }
+        
+        fzManifestEntry entry = {type, hash, fzStrcpy(filename)};
+        m_recorded.push_back(entry);
+    }
+    
+    
+    void PrefetchManager::clearEntries()
+    {
+        vector<fzManifestEntry>::iterator it(m_recorded.begin());
+        for(; it != m_recorded.end(); ++it)
+            delete [] it->filename;
+        
+        m_recorded.clear();
+    }
+    
+    
+    void PrefetchManager::sceneWillEnter(Scene *scene)
+    {
+        if(!m_isEnabled || scene == NULL)
+            return;
+        
+        // The transition's incoming scene is the one that matters.
+        Transition *transition = dynamic_cast<Transition*>(scene);
+        if(transition)
+            scene = transition->getInScene();
+        
+        if(scene == NULL)
+            return;
+        
+        char key[STRING_MAX_SIZE];
+        snprintf(key, STRING_MAX_SIZE, "fz.manifest.%s", typeid(*scene).name());
+        
+        // already prefetched and recording since the scene was constructed.
+        if(p_recordingKey && strcmp(p_recordingKey, key) == 0) {
+            Scheduler::Instance().scheduleSelector(SEL_FLOAT(PrefetchManager::stopRecording), this, m_recordingTime, false);
+            return;
+        }
+        
+        stopRecording(0);
+        prefetch(key);
+        startRecording(key);
+    }
+    
+    
+    void PrefetchManager::prefetchScene(const char *className)
+    {
+        FZ_ASSERT(className != NULL, "Class name can not be NULL.");
+        
+        if(!m_isEnabled)
+            return;
+        
+        char key[STRING_MAX_SIZE];
+        snprintf(key, STRING_MAX_SIZE, "fz.manifest.%s", className);
+        
+        stopRecording(0);
+        prefetch(key);
+        startRecording(key);
+    }
+    
+    
+    void PrefetchManager::removeManifest(Scene *scene)
+    {
+        FZ_ASSERT(scene != NULL, "Scene can not be NULL.");
+        
+        char key[STRING_MAX_SIZE];
+        snprintf(key, STRING_MAX_SIZE, "fz.manifest.%s", typeid(*scene).name());
+        DataStore::Instance().removeForKey(key);
+    }
+    
+    
+    void PrefetchManager::prefetch(const char *key)
+    {
+        const char *manifest = DataStore::Instance().stringForKey(key);
+        if(manifest == NULL)
+            return;
+        
+        // One entry per line: "t:texture.png", "r:file.xml"
+        Preloader *preloader = new Preloader();
+        char filename[STRING_MAX_SIZE];
+        const char *line = manifest;
+        while(*line != '\0')
+        {
+            const char *end = strchr(line, '\n');
+            if(end == NULL)
+                end = line + strlen(line);
+            
+            fzUInt length = end - line;
+            if(length > 2 && line[1] == ':' && length - 2 < STRING_MAX_SIZE) {
+                memcpy(filename, line + 2, length - 2);
+                filename[length - 2] = '\0';
+                
+                switch (line[0]) {
+                    case kFZPrefetch_Texture: preloader->addTexture(filename); break;
+                    case kFZPrefetch_Resource: preloader->addResource(filename); break;
+                    default: break;
+                }
+            }
+            line = (*end == '\0') ? end : end + 1;
+        }
+        preloader->start();
+    }
+    
+    
+    void PrefetchManager::startRecording(const char *key)
+    {
+        FZ_ASSERT(p_recordingKey == NULL, "Already recording.");
+        
+        p_recordingKey = fzStrcpy(key);
+        Scheduler::Instance().scheduleSelector(SEL_FLOAT(PrefetchManager::stopRecording), this, m_recordingTime, false);
+    }
+    
+    
+    void PrefetchManager::stopRecording(fzFloat)
+    {
+        if(p_recordingKey == NULL)
+            return;
+        
+        Scheduler::Instance().unscheduleSelector(SEL_FLOAT(PrefetchManager::stopRecording), this);
+        
+        if(m_recorded.empty())
+            DataStore::Instance().removeForKey(p_recordingKey);
+        
+        else {
+            fzUInt length = 1;
+            vector<fzManifestEntry>::const_iterator it(m_recorded.begin());
+            for(; it != m_recorded.end(); ++it)
+                length += strlen(it->filename) + 3;
+            
+            char *manifest = new char[length];
+            char *ptr = manifest;
+            for(it = m_recorded.begin(); it != m_recorded.end(); ++it)
+                ptr += sprintf(ptr, "%c:%s\n", it->type, it->filename);
+            
+            DataStore::Instance().setString(manifest, p_recordingKey);
+            delete [] manifest;
+        }
+        clearEntries();
+        delete [] p_recordingKey;
+        p_recordingKey = NULL;
+        
+        // the prefetched files nobody asked for are not needed anymore.
+        ResourcesManager::Instance().removePrefetchedResources();
+    }
+}
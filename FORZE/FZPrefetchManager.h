@@ -0,0 +1,153 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZPREFETCHMANAGER_H_INCLUDED__
+#define __FZPREFETCHMANAGER_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include <typeinfo>
+
+#include "FZTypes.h"
+#include "FZSelectors.h"
+#include STL_VECTOR
+
+using namespace STD;
+
+namespace FORZE {
+    
+    enum fzPrefetchType
+    {
+        kFZPrefetch_Texture = 't',
+        kFZPrefetch_Resource = 'r'
+    };
+    
+    class Scene;
+    class Preloader;
+    
+    /** PrefetchManager learns which resources each scene class needs and loads them in advance.
+     * When it is enabled:
+     * - During the first seconds after Director::replaceScene() or pushScene(), every texture requested
+     *   through TextureCache::addImage() and every file loaded through ResourcesManager::loadResource()
+     *   is recorded. The list (manifest) is stored in the DataStore, one per scene class.
+     * - The next time the same scene class is presented, its manifest is prefetched with a Preloader
+     *   while the outgoing scene is still running (during the transition, if any).
+     *   Textures end up in the TextureCache, the rest of the files are kept by the ResourcesManager
+     *   until they are requested or the recording window ends.
+     *
+     * FORZE scenes usually load their resources in the constructor, before replaceScene() is called.
+     * Call prefetchScene<SceneClass>() right before constructing the scene: its manifest is prefetched before
+     * the constructor asks for anything and the constructor's requests are recorded as well.
+     * Otherwise the resources loaded before replaceScene() are not recorded.
+     * @code
+     * PrefetchManager::Instance().prefetchScene<GameScene>();
+     * Director::Instance().replaceScene(new TransitionFade(1, new GameScene()));
+     * @endcode
+     */
+    class PrefetchManager : public SELProtocol
+    {
+    private:
+        struct fzManifestEntry {
+            char type;
+            uint32_t hash;
+            char *filename;
+        };
+        
+        // Manager's instance
+        static PrefetchManager* p_instance;
+        
+        vector<fzManifestEntry> m_recorded;
+        char *p_recordingKey;
+        fzFloat m_recordingTime;
+        bool m_isEnabled;
+        
+        void prefetch(const char *key);
+        void prefetchScene(const char *className);
+        void startRecording(const char *key);
+        void stopRecording(fzFloat dt);
+        void addEntry(char type, const char *filename);
+        void clearEntries();
+        
+        
+    protected:
+        // Constructors
+        PrefetchManager();
+        PrefetchManager(const PrefetchManager&);
+        PrefetchManager &operator = (const PrefetchManager&);
+        
+        
+    public:
+        //! Gets and allocates the singleton.
+        static PrefetchManager& Instance();
+        
+        
+        //! Used internally by the TextureCache and the ResourcesManager to record the requested resources.
+        //! Only the requests made from the main thread are recorded.
+        static void record(fzPrefetchType type, const char *filename);
+        
+        
+        //! Enables the recording and prefetching. Disabled by default.
+        void setEnabled(bool enabled);
+        
+        
+        //! @see setEnabled()
+        bool isEnabled() const {
+            return m_isEnabled;
+        }
+        
+        
+        //! Sets how many seconds are recorded after a scene is presented. 3 seconds by default.
+        void setRecordingTime(fzFloat seconds) {
+            m_recordingTime = seconds;
+        }
+        
+        
+        //! @see setRecordingTime()
+        fzFloat getRecordingTime() const {
+            return m_recordingTime;
+        }
+        
+        
+        //! Prefetches the manifest of the scene class and starts recording a new one.
+        //! Call it before constructing the scene, so the resources loaded by its constructor are recorded.
+        template <typename T>
+        void prefetchScene() {
+            prefetchScene(typeid(T).name());
+        }
+        
+        
+        //! Called by the Director when a new scene is going to be presented.
+        //! It prefetches the scene's manifest and starts recording a new one, unless prefetchScene() was
+        //! called for its class; in that case the recording window is restarted.
+        void sceneWillEnter(Scene *scene);
+        
+        
+        //! Removes the stored manifest of the scene class.
+        void removeManifest(Scene *scene);
+    };
+}
+#endif
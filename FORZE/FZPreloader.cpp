@@ -0,0 +1,439 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include <sys/time.h>
+#include <string.h>
+
+#include "FZPreloader.h"
+#include "FZWorkerPool.h"
+#include "FZScheduler.h"
+#include "FZResourcesManager.h"
+#include "FZTextureCache.h"
+#include "FZSpriteFrameCache.h"
+#include "FZFontCache.h"
+#include "FZFont.h"
+#include "FZShaderCache.h"
+#include "FZMacros.h"
+#include "external/tinythread/tinythread.h"
+#include "external/rapidxml/rapidxml.hpp"
+
+
+using namespace rapidxml;
+using namespace STD;
+
+namespace FORZE {
+    
+    // Seconds elapsed since the given time. The epoch time does not fit in a float.
+    static fzFloat fzPreloaderElapsed(const struct timeval& start)
+    {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000000.0f;
+    }
+    
+    
+    Preloader::Preloader()
+    : m_items()
+    , m_ready()
+    , p_mutex(new mutex())
+    , m_nextDecode(0)
+    , m_activeWorkers(0)
+    , m_loaded(0)
+    , m_failed(0)
+    , m_budget(0.004f)
+    , m_isRunning(false)
+    , p_target(NULL)
+    , m_selector(NULL)
+    { }
+    
+    
+    Preloader::~Preloader()
+    {
+        FZ_ASSERT(m_isRunning == false, "The preloader is still running.");
+        
+        vector<fzPreloadItem>::iterator it(m_items.begin());
+        for(; it != m_items.end(); ++it) {
+            delete [] it->filename;
+            delete [] it->filename2;
+            delete [] it->name;
+            it->source.data.free();
+            it->sources[0].free();
+            it->sources[1].free();
+        }
+        delete p_mutex;
+    }
+    
+    
+    Preloader::fzPreloadItem& Preloader::addItem(fzPreloadType type, const char* filename, const char* filename2)
+    {
+        FZ_ASSERT(m_isRunning == false && m_loaded == 0, "Items can not be added once the preloader started.");
+        FZ_ASSERT(filename != NULL, "Filename can not be NULL.");
+        
+        fzPreloadItem item;
+        item.type = type;
+        item.filename = fzStrcpy(filename);
+        item.filename2 = (filename2) ? fzStrcpy(filename2) : NULL;
+        item.name = NULL;
+        item.lineHeight = 0;
+        item.factor = 0;
+        item.sources[0] = fzBuffer::empty();
+        item.sources[1] = fzBuffer::empty();
+        
+        m_items.push_back(item);
+        return m_items.back();
+    }
+    
+    
+    void Preloader::addTexture(const char* filename)
+    {
+        FZ_ASSERT(filename != NULL, "Filename can not be NULL.");
+
+        // already loaded, nothing to do.
+        if(TextureCache::Instance().getTextureByName(filename))
+            return;
+        
+        addItem(kFZPreload_Texture, filename, NULL);
+    }
+    
+    
+    void Preloader::addSpriteFrames(const char* filename)
+    {
+        addItem(kFZPreload_SpriteFrames, filename, NULL);
+    }
+    
+    
+    void Preloader::addFont(const char* filename, fzFloat lineHeight)
+    {
+        FZ_ASSERT(filename != NULL, "Filename can not be NULL.");
+
+        if(FontCache::Instance().getFontByName(filename))
+            return;
+        
+        addItem(kFZPreload_Font, filename, NULL).lineHeight = lineHeight;
+    }
+    
+    
+    void Preloader::addShader(const char* name, const char* vertexFilename, const char* fragmentFilename)
+    {
+        FZ_ASSERT(name != NULL, "Name can not be NULL.");
+        FZ_ASSERT(fragmentFilename != NULL, "Filename can not be NULL.");
+
+        addItem(kFZPreload_Shader, vertexFilename, fragmentFilename).name = fzStrcpy(name);
+    }
+    
+    
+    void Preloader::addResource(const char* filename)
+    {
+        addItem(kFZPreload_Resource, filename, NULL);
+    }
+    
+    
+    void Preloader::setCallback(SELProtocol *target, SELECTOR_PTR selector)
+    {
+        p_target = target;
+        m_selector = selector;
+    }
+    
+    
+    fzFloat Preloader::getProgress() const
+    {
+        if(m_items.empty())
+            return 1;
+        
+        return m_loaded / static_cast<fzFloat>(m_items.size());
+    }
+    
+    
+    void Preloader::start()
+    {
+        FZ_ASSERT(m_isRunning == false, "The preloader is already running.");
+        
+        retain();
+        m_isRunning = true;
+        
+        if(m_items.empty()) {
+            finishAll();
+            return;
+        }
+        
+        fzUInt nuWorkers = WorkerPool::Instance().getNumberOfWorkers();
+        if(nuWorkers > m_items.size())
+            nuWorkers = m_items.size();
+        
+        m_activeWorkers = nuWorkers;
+        for(fzUInt i = 0; i < nuWorkers; ++i)
+            WorkerPool::Instance().dispatch(decodeItem, this);
+        
+        Scheduler::Instance().scheduleSelector(SEL_FLOAT(Preloader::update), this, 0, false, 2, kFZUpdatePhase_PreUpdate);
+    }
+    
+    
+    bool Preloader::claim(fzUInt *index)
+    {
+        p_mutex->lock();
+        *index = m_nextDecode;
+        bool valid = (m_nextDecode < m_items.size());
+        if(valid)
+            ++m_nextDecode;
+        
+        p_mutex->unlock();
+        return valid;
+    }
+    
+    
+    void Preloader::decodeItem(void *context, fzUInt)
+    {
+        // Each worker keeps decoding until there are no items left.
+        Preloader *preloader = static_cast<Preloader*>(context);
+        fzUInt index;
+        while(preloader->claim(&index))
+        {
+            preloader->decode(preloader->m_items[index]);
+            
+            preloader->p_mutex->lock();
+            preloader->m_ready.push_back(index);
+            preloader->p_mutex->unlock();
+        }
+        
+        // the preloader can not finish until all the workers left.
+        preloader->p_mutex->lock();
+        --preloader->m_activeWorkers;
+        preloader->p_mutex->unlock();
+    }
+    
+    
+    void Preloader::decode(fzPreloadItem& item)
+    {
+        try {
+            switch (item.type) {
+                case kFZPreload_Texture:
+                    Texture2D::decode(item.filename, item.source);
+                    break;
+                    
+                case kFZPreload_SpriteFrames:
+                {
+                    // Only the texture's name is needed, the frames are parsed in the main thread.
+                    fzBuffer data = ResourcesManager::Instance().loadResource(item.filename, &item.factor);
+                    if(data.isEmpty())
+                        return;
+                    
+                    try {
+                        xml_document<> doc;
+                        doc.parse<parse_fastest>(data.getPointer());
+                        
+                        xml_node<> *node = doc.first_node("metadata");
+                        if(node)
+                            node = node->first_node("textureFileName");
+                        
+                        if(node)
+                            item.name = fzStrcpy(node->value(), node->value_size());
+                        
+                    } catch(...) {
+                        data.free();
+                        throw;
+                    }
+                    data.free();
+                    
+                    if(item.name)
+                        Texture2D::decode(item.name, item.source);
+                    
+                    break;
+                }
+                case kFZPreload_Font:
+                {
+                    fzBuffer data = ResourcesManager::Instance().loadResource(item.filename, &item.factor);
+                    if(data.isEmpty())
+                        return;
+                    
+                    uint32_t magic = 0;
+                    if(data.getLength() > sizeof(fzFontHeader))
+                        memcpy(&magic, data.getPointer(), sizeof(magic));
+                    
+                    if(magic == FZ_FONT_MAGIC) {
+                        // FZF: the texture follows the header.
+                        item.name = fzStrcpy(data.getPointer() + sizeof(fzFontHeader));
+                        
+                    }else{
+                        // FNT: page id=0 file="texture.png"
+                        const char *start = strstr(data.getPointer(), "file=\"");
+                        if(start) {
+                            start += 6;
+                            const char *end = strchr(start, '"');
+                            if(end && end > start)
+                                item.name = fzStrcpy(start, end - start);
+                        }
+                    }
+                    data.free();
+                    
+                    if(item.name)
+                        Texture2D::decode(item.name, item.source);
+                    
+                    break;
+                }
+                case kFZPreload_Shader:
+                    item.sources[0] = ResourcesManager::Instance().loadResource(item.filename);
+                    item.sources[1] = ResourcesManager::Instance().loadResource(item.filename2);
+                    break;
+                    
+                case kFZPreload_Resource:
+                    item.sources[0] = ResourcesManager::Instance().loadResource(item.filename, &item.factor);
+                    break;
+            }
+        } catch(std::exception& error) {
+            FZLOGERROR("Preloader: Error decoding \"%s\". %s", item.filename, error.what());
+        }
+    }
+    
+    
+    void Preloader::finish(fzPreloadItem& item)
+    {
+        bool loaded = true;
+        switch (item.type) {
+            case kFZPreload_Texture:
+                loaded = (!item.source.data.isEmpty() &&
+                          TextureCache::Instance().addDecodedImage(item.filename, item.source) != NULL);
+                break;
+                
+            case kFZPreload_SpriteFrames:
+                // if the texture could not be decoded, the SpriteFrameCache will try it again.
+                if(item.name && !item.source.data.isEmpty())
+                    TextureCache::Instance().addDecodedImage(item.name, item.source);
+                
+                SpriteFrameCache::Instance().addSpriteFrames(item.filename);
+                break;
+                
+            case kFZPreload_Font:
+                if(item.name && !item.source.data.isEmpty())
+                    TextureCache::Instance().addDecodedImage(item.name, item.source);
+                
+                loaded = (FontCache::Instance().addFont(item.filename, item.lineHeight) != NULL);
+                break;
+                
+            case kFZPreload_Shader:
+#if FZ_GL_SHADERS
+                loaded = (!item.sources[0].isEmpty() && !item.sources[1].isEmpty() &&
+                          ShaderCache::Instance().addProgram(item.name, item.sources[0].getPointer(), item.sources[1].getPointer()) != NULL);
+#endif
+                item.sources[0].free();
+                item.sources[1].free();
+                break;
+                
+            case kFZPreload_Resource:
+                loaded = !item.sources[0].isEmpty();
+                if(loaded) {
+                    ResourcesManager::Instance().addPrefetchedResource(item.filename, item.sources[0], item.factor);
+                    item.sources[0] = fzBuffer::empty();
+                }
+                break;
+        }
+        if(!loaded) {
+            FZLOGERROR("Preloader: \"%s\" could not be loaded.", item.filename);
+            ++m_failed;
+        }
+        ++m_loaded;
+    }
+    
+    
+    bool Preloader::step(bool block)
+    {
+        fzUInt index;
+        bool found = false;
+        
+        p_mutex->lock();
+        if(!m_ready.empty()) {
+            index = m_ready.back();
+            m_ready.pop_back();
+            found = true;
+        }
+        bool helping = (block || m_activeWorkers == 0);
+        p_mutex->unlock();
+        
+        // Without workers (or while waiting) the main thread decodes as well.
+        if(!found && helping) {
+            found = claim(&index);
+            if(found)
+                decode(m_items[index]);
+        }
+        
+        if(found)
+            finish(m_items[index]);
+        
+        return found;
+    }
+    
+    
+    void Preloader::update(fzFloat)
+    {
+        struct timeval start;
+        gettimeofday(&start, NULL);
+        
+        while(step(false) && fzPreloaderElapsed(start) < m_budget) { }
+        
+        if(isDone())
+            finishAll();
+    }
+    
+    
+    void Preloader::wait()
+    {
+        FZ_ASSERT(m_isRunning, "The preloader must be started.");
+        
+        while(!isDone()) {
+            if(!step(true))
+                this_thread::yield();
+        }
+        finishAll();
+    }
+    
+    
+    void Preloader::finishAll()
+    {
+        if(!m_isRunning)
+            return;
+        
+        // workers leave right after their last item, wait for them before releasing.
+        for(;;) {
+            p_mutex->lock();
+            fzUInt active = m_activeWorkers;
+            p_mutex->unlock();
+            if(active == 0)
+                break;
+            
+            this_thread::yield();
+        }
+        
+        m_isRunning = false;
+        Scheduler::Instance().unscheduleSelector(SEL_FLOAT(Preloader::update), this);
+        
+        if(p_target && m_selector)
+            (p_target->*m_selector)(this);
+        
+        release();
+    }
+}
@@ -0,0 +1,191 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZPRELOADER_H_INCLUDED__
+#define __FZPRELOADER_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZLifeCycle.h"
+#include "FZTexture2D.h"
+#include STL_VECTOR
+
+using namespace STD;
+
+namespace FORZE {
+    
+    class mutex;
+    
+    /** Preloader loads a batch of resources without blocking the game loop.
+     * - The files are read and the images are decoded in the WorkerPool.
+     * - The OpenGL work (texture uploading, shader compilation) is done in the main thread,
+     *   a few items per frame, without exceeding the frame budget.
+     *
+     * The loaded resources end up in the usual caches (TextureCache, SpriteFrameCache,
+     * FontCache, ShaderCache and ResourcesManager), so the rest of the code does not change.
+     *
+     * @code
+     * Preloader *preloader = new Preloader();
+     * preloader->addTexture("background.png");
+     * preloader->addSpriteFrames("sprites.xml");
+     * preloader->addFont("font.fnt");
+     * preloader->setCallback(this, SEL_PTR(LoadingScene::loaded));
+     * preloader->start();
+     * @endcode
+     *
+     * The preloader retains itself while it is running, so it is safe to release it just after start().
+     */
+    class Preloader : public LifeCycle
+    {
+    private:
+        enum fzPreloadType {
+            kFZPreload_Texture,
+            kFZPreload_SpriteFrames,
+            kFZPreload_Font,
+            kFZPreload_Shader,
+            kFZPreload_Resource
+        };
+        
+        struct fzPreloadItem {
+            fzPreloadType type;
+            char *filename;
+            char *filename2;
+            char *name;
+            fzFloat lineHeight;
+            fzUInt factor;
+            fzTextureSource source;
+            fzBuffer sources[2];
+        };
+        
+        vector<fzPreloadItem> m_items;
+        vector<fzUInt> m_ready;
+        mutex *p_mutex;
+        
+        fzUInt m_nextDecode;
+        fzUInt m_activeWorkers;
+        fzUInt m_loaded;
+        fzUInt m_failed;
+        fzFloat m_budget;
+        bool m_isRunning;
+        
+        SELProtocol *p_target;
+        SELECTOR_PTR m_selector;
+        
+        fzPreloadItem& addItem(fzPreloadType type, const char* filename, const char* filename2);
+        
+        static void decodeItem(void *preloader, fzUInt index);
+        bool claim(fzUInt *index);
+        void decode(fzPreloadItem& item);
+        void finish(fzPreloadItem& item);
+        bool step(bool block);
+        void finishAll();
+        void update(fzFloat dt);
+        
+        
+    protected:
+        Preloader(const Preloader&);
+        Preloader &operator = (const Preloader&);
+        
+        
+    public:
+        //! Constructs an empty preloader.
+        Preloader();
+        
+        // Destructor
+        ~Preloader();
+        
+        
+        //! Adds a texture (.png, .pvr, .pvr.ccz) to the batch.
+        //! @see TextureCache::addImage()
+        void addTexture(const char* filename);
+        
+        
+        //! Adds a sprite frames file to the batch, its texture is decoded in background as well.
+        //! @see SpriteFrameCache::addSpriteFrames()
+        void addSpriteFrames(const char* filename);
+        
+        
+        //! Adds a font to the batch, its texture is decoded in background as well.
+        //! @see FontCache::addFont()
+        void addFont(const char* filename, fzFloat lineHeight = 0);
+        
+        
+        //! Adds a GLSL program to the batch. The source files are read in background,
+        //! the program is compiled in the main thread and stored in the ShaderCache with the given name.
+        //! @see ShaderCache::addProgram()
+        void addShader(const char* name, const char* vertexFilename, const char* fragmentFilename);
+        
+        
+        //! Adds a generic file to the batch. It is read in background and kept by the ResourcesManager,
+        //! the next ResourcesManager::loadResource() of the file does not touch the disk.
+        //! @see ResourcesManager::addPrefetchedResource()
+        void addResource(const char* filename);
+        
+        
+        //! Starts loading the batch. No more items can be added after this call.
+        void start();
+        
+        
+        //! Blocks until the whole batch is loaded.
+        //! Useful when the resources are needed right now, the decoding is still done in parallel.
+        void wait();
+        
+        
+        //! Sets the maximum time (in seconds) the preloader can spend in the main thread per frame.
+        //! At least one item is uploaded every frame. 0.004 (4ms) by default.
+        void setFrameBudget(fzFloat budget) {
+            m_budget = budget;
+        }
+        
+        
+        //! @see setFrameBudget()
+        fzFloat getFrameBudget() const {
+            return m_budget;
+        }
+        
+        
+        //! The selector is called (with the preloader as argument) when the whole batch is loaded.
+        void setCallback(SELProtocol *target, SELECTOR_PTR selector);
+        
+        
+        //! Returns the loading progress, from 0 to 1.
+        fzFloat getProgress() const;
+        
+        
+        //! Returns true if the batch was completely loaded.
+        bool isDone() const {
+            return m_loaded == m_items.size();
+        }
+        
+        
+        //! Returns the number of items that could not be loaded.
+        fzUInt getNumberOfFailures() const {
+            return m_failed;
+        }
+    };
+}
+#endif
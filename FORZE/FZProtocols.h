@@ -41,6 +41,26 @@ namespace FORZE {
     class GLProgram;
     
     
+#pragma mark - fzMemoryTier
+    
+    /** @typedef fzMemoryTier
+     Kinds of memory a cache can release, from the cheapest to the most expensive.
+     */
+    enum fzMemoryTier
+    {
+        //! Cached objects nobody retains that were not requested for a while.
+        kFZMemoryTier_Cold,
+        
+        //! Every cached object nobody retains. They are reloaded if they are requested again.
+        kFZMemoryTier_Unused,
+        
+        //! Memory in use that the engine can rebuild from disk by itself when it is needed again.
+        kFZMemoryTier_Reloadable,
+        
+        kFZMemoryTier_Count
+    };
+    
+    
 #pragma mark - AppDelegateProtocol
     
     //! APPDelegate protocol
@@ -143,6 +163,26 @@ namespace FORZE {
             //! @see setTexture()
             virtual Texture2D* getTexture() const = 0;
         };
+        
+        
+#pragma mark - Protocol::Memory
+        
+        //! Memory protocol, implemented by the caches registered in the MemoryManager.
+        class Memory
+        {
+        public:
+            virtual ~Memory(){}
+            
+            //! Returns the name used in the memory reports.
+            virtual const char* getMemoryName() const = 0;
+            
+            //! Returns the number of bytes used by the cache (estimated if not exact).
+            virtual fzUInt getMemoryUsage() const = 0;
+            
+            //! Releases the memory of the given tier.
+            //! @see fzMemoryTier
+            virtual void releaseMemory(fzMemoryTier tier) = 0;
+        };
     };
 }
 #endif
@@ -0,0 +1,165 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include <algorithm>
+
+#include "FZResourceGroup.h"
+#include "FZTextureCache.h"
+#include "FZSpriteFrameCache.h"
+#include "FZFontCache.h"
+#include "FZAnimationCache.h"
+#include "FZMacros.h"
+
+
+using namespace STD;
+
+namespace FORZE {
+    
+    vector<ResourceGroup*> ResourceGroup::s_groups;
+    vector<ResourceGroup*> ResourceGroup::s_openGroups;
+    
+    
+    ResourceGroup::ResourceGroup()
+    : m_isSorted(true)
+    {
+        s_groups.push_back(this);
+    }
+    
+    
+    ResourceGroup::~ResourceGroup()
+    {
+        end();
+        releaseResources();
+        s_groups.erase(find(s_groups.begin(), s_groups.end(), this));
+    }
+    
+    
+    void ResourceGroup::tag(fzResourceType type, uint32_t hash)
+    {
+        if(s_openGroups.empty())
+            return;
+        
+        ResourceGroup *group = s_openGroups.back();
+        group->m_resources[type].push_back(hash);
+        group->m_isSorted = false;
+    }
+    
+    
+    ResourceGroup* ResourceGroup::getOpenGroup()
+    {
+        return (s_openGroups.empty()) ? NULL : s_openGroups.back();
+    }
+    
+    
+    void ResourceGroup::begin()
+    {
+        FZ_ASSERT(find(s_openGroups.begin(), s_openGroups.end(), this) == s_openGroups.end(), "The group is already open.");
+        s_openGroups.push_back(this);
+    }
+    
+    
+    void ResourceGroup::end()
+    {
+        vector<ResourceGroup*>::iterator it(find(s_openGroups.begin(), s_openGroups.end(), this));
+        if(it != s_openGroups.end())
+            s_openGroups.erase(it);
+    }
+    
+    
+    void ResourceGroup::sort() const
+    {
+        if(m_isSorted)
+            return;
+        
+        for(fzUInt i = 0; i < kFZResource_Count; ++i) {
+            vector<uint32_t>& resources = m_resources[i];
+            STD::sort(resources.begin(), resources.end());
+            resources.erase(unique(resources.begin(), resources.end()), resources.end());
+        }
+        m_isSorted = true;
+    }
+    
+    
+    bool ResourceGroup::contains(fzResourceType type, uint32_t hash) const
+    {
+        FZ_ASSERT(type < kFZResource_Count, "Invalid resource type.");
+        
+        sort();
+        return binary_search(m_resources[type].begin(), m_resources[type].end(), hash);
+    }
+    
+    
+    fzUInt ResourceGroup::getNumberOfResources() const
+    {
+        sort();
+        
+        fzUInt count = 0;
+        for(fzUInt i = 0; i < kFZResource_Count; ++i)
+            count += m_resources[i].size();
+        
+        return count;
+    }
+    
+    
+    void ResourceGroup::releaseResources()
+    {
+        sort();
+        
+        // Dependants first: the frames and the fonts use the textures.
+        static const fzResourceType order[] = {
+            kFZResource_Animation, kFZResource_Font, kFZResource_SpriteFrame, kFZResource_Texture
+        };
+        
+        for(fzUInt i = 0; i < kFZResource_Count; ++i)
+        {
+            fzResourceType type = order[i];
+            vector<uint32_t>::const_iterator it(m_resources[type].begin());
+            for(; it != m_resources[type].end(); ++it)
+            {
+                // shared with another group
+                bool shared = false;
+                vector<ResourceGroup*>::const_iterator group(s_groups.begin());
+                for(; group != s_groups.end() && !shared; ++group)
+                    shared = (*group != this && (*group)->contains(type, *it));
+                
+                if(shared)
+                    continue;
+                
+                switch (type) {
+                    case kFZResource_Texture: TextureCache::Instance().removeTextureByHash(*it); break;
+                    case kFZResource_SpriteFrame: SpriteFrameCache::Instance().removeSpriteFrameByHash(*it); break;
+                    case kFZResource_Font: FontCache::Instance().removeFontByHash(*it); break;
+                    case kFZResource_Animation: AnimationCache::Instance().removeAnimationByHash(*it); break;
+                    default: break;
+                }
+            }
+            m_resources[type].clear();
+        }
+    }
+}
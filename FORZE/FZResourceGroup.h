@@ -0,0 +1,114 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZRESOURCEGROUP_H_INCLUDED__
+#define __FZRESOURCEGROUP_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZLifeCycle.h"
+#include STL_VECTOR
+
+using namespace STD;
+
+namespace FORZE {
+    
+    enum fzResourceType
+    {
+        kFZResource_Texture,
+        kFZResource_SpriteFrame,
+        kFZResource_Font,
+        kFZResource_Animation,
+        kFZResource_Count
+    };
+    
+    
+    /** ResourceGroup tags the resources requested while it is open and releases them all at once.
+     * Every texture (TextureCache), sprite frame (SpriteFrameCache), font (FontCache) and
+     * animation (AnimationCache) added between begin() and end() belongs to the group.
+     * releaseResources() removes them from their caches in one pass, except the ones
+     * that also belong to another alive group.
+     *
+     * Groups can be nested, the resources are tagged with the innermost open group.
+     * The resources are released when the group is destroyed.
+     * @see Scene::beginResources()
+     */
+    class ResourceGroup : public LifeCycle
+    {
+    private:
+        mutable vector<uint32_t> m_resources[kFZResource_Count];
+        mutable bool m_isSorted;
+        
+        static vector<ResourceGroup*> s_groups;
+        static vector<ResourceGroup*> s_openGroups;
+        
+        void sort() const;
+        
+        
+    protected:
+        ResourceGroup(const ResourceGroup&);
+        ResourceGroup &operator = (const ResourceGroup&);
+        
+        
+    public:
+        //! Constructs an empty group.
+        ResourceGroup();
+        
+        // Destructor
+        ~ResourceGroup();
+        
+        
+        //! Used internally by the caches to tag a resource with the open group.
+        static void tag(fzResourceType type, uint32_t hash);
+        
+        
+        //! Returns the innermost open group, NULL if there is not one.
+        static ResourceGroup* getOpenGroup();
+        
+        
+        //! Opens the group, the resources requested from now on are tagged with it.
+        void begin();
+        
+        
+        //! Closes the group.
+        void end();
+        
+        
+        //! Returns true if the resource belongs to the group.
+        bool contains(fzResourceType type, uint32_t hash) const;
+        
+        
+        //! Returns the number of resources of the group.
+        fzUInt getNumberOfResources() const;
+        
+        
+        //! Removes all the group's resources from the caches and empties the group.
+        //! Objects still retained by someone else (nodes, actions...) stay alive until they are released.
+        void releaseResources();
+    };
+}
+#endif
@@ -0,0 +1,206 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <zlib.h>
+#include <algorithm>
+
+#include "FZResourcesArchive.h"
+#include "FZBitOrder.h"
+#include "FZHash.h"
+#include "FZMacros.h"
+
+
+namespace FORZE {
+    
+    static bool compareEntries(const fzArchiveEntry& a, const fzArchiveEntry& b)
+    {
+        return a.hash < b.hash;
+    }
+    
+    
+    ResourcesArchive::ResourcesArchive(const char *absolutePath)
+    : p_data(NULL)
+    , m_length(0)
+    , m_entries()
+    , m_paths()
+    {
+        FZ_ASSERT(absolutePath, "Absolute path can not be NULL.");
+
+        int fd = open(absolutePath, O_RDONLY);
+        if(fd < 0)
+            FZ_RAISE("ResourcesArchive:IO: Archive not found.");
+        
+        struct stat info;
+        if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(fzArchiveHeader)) {
+            close(fd);
+            FZ_RAISE("ResourcesArchive:IO: Invalid archive.");
+        }
+        
+        // the mapping stays valid after closing the descriptor
+        void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(data == MAP_FAILED)
+            FZ_RAISE("ResourcesArchive:IO: Archive could not be mapped.");
+        
+        p_data = (char*)data;
+        m_length = info.st_size;
+        
+        // HEADER
+        const fzArchiveHeader *header = (const fzArchiveHeader*)p_data;
+        uint32_t count = fzBitOrder_int32LittleToHost(header->count);
+        if(fzBitOrder_int32LittleToHost(header->magic) != FZ_ARCHIVE_MAGIC ||
+           fzBitOrder_int32LittleToHost(header->version) != FZ_ARCHIVE_VERSION ||
+           sizeof(fzArchiveHeader) + count * sizeof(fzArchiveEntry) > m_length)
+        {
+            munmap(p_data, m_length);
+            FZ_RAISE("ResourcesArchive: Invalid header.");
+        }
+        
+        // INDEX
+        const fzArchiveEntry *entries = (const fzArchiveEntry*)(p_data + sizeof(fzArchiveHeader));
+        m_entries.resize(count);
+        for(fzUInt i = 0; i < count; ++i)
+        {
+            fzArchiveEntry& entry = m_entries[i];
+            entry.hash          = fzBitOrder_int32LittleToHost(entries[i].hash);
+            entry.offset        = fzBitOrder_int32LittleToHost(entries[i].offset);
+            entry.size          = fzBitOrder_int32LittleToHost(entries[i].size);
+            entry.length        = fzBitOrder_int32LittleToHost(entries[i].length);
+            entry.compression   = fzBitOrder_int16LittleToHost(entries[i].compression);
+            entry.factor        = fzBitOrder_int16LittleToHost(entries[i].factor);
+            
+            // the '\0' after the blob is part of the archive
+            if((size_t)entry.offset + entry.size >= m_length) {
+                munmap(p_data, m_length);
+                FZ_RAISE("ResourcesArchive: Corrupted index.");
+            }
+        }
+        FZ_ASSERT(is_sorted(m_entries.begin(), m_entries.end(), compareEntries), "Archive index must be sorted.");
+        
+        // PATHS
+        const char *path = (const char*)(entries + count);
+        const char *end = p_data + m_length;
+        m_paths.resize(count);
+        for(fzUInt i = 0; i < count; ++i)
+        {
+            const char *terminator = (const char*)memchr(path, '\0', end - path);
+            if(terminator == NULL) {
+                munmap(p_data, m_length);
+                FZ_RAISE("ResourcesArchive: Corrupted paths.");
+            }
+            m_paths[i] = path;
+            path = terminator + 1;
+        }
+    }
+    
+    
+    ResourcesArchive::~ResourcesArchive()
+    {
+        munmap(p_data, m_length);
+    }
+    
+    
+    const fzArchiveEntry* ResourcesArchive::getEntry(const char *relativePath) const
+    {
+        FZ_ASSERT(relativePath, "Relative path can not be NULL.");
+
+        fzArchiveEntry key;
+        key.hash = fzHashLowercase(relativePath);
+        
+        // the hash is only a hint, the paths are compared to discard collisions
+        vector<fzArchiveEntry>::const_iterator it(lower_bound(m_entries.begin(), m_entries.end(), key, compareEntries));
+        for(; it != m_entries.end() && it->hash == key.hash; ++it) {
+            if(strcasecmp(getPath(&(*it)), relativePath) == 0)
+                return &(*it);
+        }
+        return NULL;
+    }
+    
+    
+    const char* ResourcesArchive::getPath(const fzArchiveEntry *entry) const
+    {
+        FZ_ASSERT(entry >= &m_entries.front() && entry <= &m_entries.back(), "Entry is not part of this archive.");
+        return m_paths[entry - &m_entries.front()];
+    }
+    
+    
+    fzBuffer ResourcesArchive::getView(const fzArchiveEntry *entry) const
+    {
+        FZ_ASSERT(entry, "Entry can not be NULL.");
+        
+        if(entry->compression == kFZArchiveCompression_None)
+            return fzBuffer::view(p_data + entry->offset, entry->size + 1);
+        
+        return getCopy(entry);
+    }
+    
+    
+    fzBuffer ResourcesArchive::getCopy(const fzArchiveEntry *entry) const
+    {
+        FZ_ASSERT(entry, "Entry can not be NULL.");
+
+        char *buffer = new(std::nothrow) char[entry->length + 1];
+        if(buffer == NULL) {
+            FZLOGERROR("ResourcesArchive: Impossible to allocate memory.");
+            return fzBuffer::empty();
+        }
+        
+        switch (entry->compression) {
+            case kFZArchiveCompression_None:
+                memcpy(buffer, p_data + entry->offset, entry->size);
+                break;
+                
+            case kFZArchiveCompression_Zlib:
+            {
+                // the uncompressed length is known, inflate straight into the final buffer
+                uLongf length = entry->length;
+                int status = uncompress((Bytef*)buffer, &length, (const Bytef*)(p_data + entry->offset), entry->size);
+                if(status != Z_OK || length != entry->length) {
+                    FZLOGERROR("ResourcesArchive: Error inflating entry. Error code: %d.", status);
+                    delete [] buffer;
+                    return fzBuffer::empty();
+                }
+                break;
+            }
+            default:
+                FZLOGERROR("ResourcesArchive: Unknown compression.");
+                delete [] buffer;
+                return fzBuffer::empty();
+        }
+        
+        // NULL TERMINATED
+        buffer[entry->length] = '\0';
+        return fzBuffer(buffer, entry->length + 1);
+    }
+}
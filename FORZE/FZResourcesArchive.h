@@ -0,0 +1,125 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZRESOURCESARCHIVE_H_INCLUDED__
+#define __FZRESOURCESARCHIVE_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZAllocator.h"
+#include STL_VECTOR
+
+
+using namespace STD;
+
+namespace FORZE {
+    
+#define FZ_ARCHIVE_MAGIC 0x4b505a46 // "FZPK"
+#define FZ_ARCHIVE_VERSION 2
+    
+    enum fzArchiveCompression
+    {
+        kFZArchiveCompression_None = 0,
+        kFZArchiveCompression_Zlib = 1
+    };
+    
+    /** Packed archive format (little endian), built offline with tools/fzpack.
+     * - fzArchiveHeader
+     * - fzArchiveEntry[count], sorted by hash.
+     * - Paths of the entries, in the same order, each one followed by '\0'.
+     * - Blobs, each one starting at a page boundary and followed by at least one '\0'.
+     */
+    struct fzArchiveHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;
+        uint32_t alignment;
+    };
+    
+    struct fzArchiveEntry
+    {
+        //! fzHashLowercase() of the path relative to the resources directory. "textures/hero@x2.png"
+        uint32_t hash;
+        uint32_t offset;
+        
+        //! Stored length.
+        uint32_t size;
+        
+        //! Uncompressed length.
+        uint32_t length;
+        uint16_t compression;
+        
+        //! Scaling factor, parsed from the @xN suffix of the file.
+        uint16_t factor;
+    };
+    
+    
+    //! ResourcesArchive maps a packed archive into memory.
+    //! The archive is opened once and its pages are loaded lazily by the kernel,
+    //! so uncompressed entries can be read without any copy.
+    //! @see ResourcesManager::mountArchive()
+    class ResourcesArchive
+    {
+    private:
+        char *p_data;
+        size_t m_length;
+        vector<fzArchiveEntry> m_entries;
+        vector<const char*> m_paths;
+        
+    public:
+        //! Maps the archive at the absolute path.
+        //! An exception is raised if the file is not a valid archive.
+        explicit ResourcesArchive(const char *absolutePath);
+        ~ResourcesArchive();
+        
+        
+        //! Returns the entry for the relative path, compared ignoring case. NULL if it is not archived.
+        const fzArchiveEntry* getEntry(const char *relativePath) const;
+        
+        
+        //! Returns the entry's relative path, as it was packed.
+        const char* getPath(const fzArchiveEntry *entry) const;
+        
+        
+        //! Returns the sorted entries.
+        const vector<fzArchiveEntry>& getEntries() const {
+            return m_entries;
+        }
+        
+        
+        //! Returns a read-only buffer with the entry's content.
+        //! Uncompressed entries are returned as a view of the mapped archive, compressed ones are inflated.
+        //! free() must be called anyway.
+        fzBuffer getView(const fzArchiveEntry *entry) const;
+        
+        
+        //! Returns a writable and NULL-terminated copy of the entry's content.
+        fzBuffer getCopy(const fzArchiveEntry *entry) const;
+    };
+}
+#endif
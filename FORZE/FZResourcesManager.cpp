@@ -31,12 +31,21 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <ctype.h>
+#include <algorithm>
 
 #include "FZResourcesManager.h"
+#include "FZResourcesArchive.h"
+#include "FZPrefetchManager.h"
+#include "FZMemoryManager.h"
 #include "FZDeviceConfig.h"
 #include "FZDirector.h"
 #include "FZIO.h"
+#include "FZHash.h"
 #include "FZMacros.h"
+#include "external/tinythread/tinythread.h"
 
 #define STRING_MAX_SIZE 512
 
@@ -44,6 +53,15 @@ namespace FORZE {
     
     ResourcesManager* ResourcesManager::p_instance = NULL;
     
+    
+    static void fzLowercase(string& str)
+    {
+        string::iterator it(str.begin());
+        for(; it != str.end(); ++it)
+            *it = (char)tolower((unsigned char)*it);
+    }
+    
+    
     ResourcesManager& ResourcesManager::Instance()
     {
         if (p_instance == NULL)
@@ -55,6 +73,14 @@ namespace FORZE {
     
     ResourcesManager::ResourcesManager()
     : m_nuRules(0)
+    , m_index()
+    , m_indexPaths()
+    , m_isIndexed(false)
+    , m_archives()
+    , m_resolved()
+    , m_resolvedFactor(0)
+    , m_prefetched()
+    , p_mutex(new mutex())
     {
         // GET RESOURCES PATH
         char tmp[STRING_MAX_SIZE];
@@ -65,11 +91,20 @@ namespace FORZE {
         
         
         setupDefaultRules();
+        reloadIndex();
+        
+        MemoryManager::Instance().addCache(this);
     }
     
     ResourcesManager::~ResourcesManager()
     {
+        removePrefetchedResources();
         delete p_resourcesPath;
+        delete p_mutex;
+        
+        vector<ResourcesArchive*>::iterator it(m_archives.begin());
+        for(; it != m_archives.end(); ++it)
+            delete *it;
     }
 
     
@@ -121,6 +156,11 @@ namespace FORZE {
             
             FZLOGINFO("ResourcesManager: New rule:\"%c%s\" Factor:%d.", FZ_IO_SUBFIX_CHAR, m_rules[m_nuRules].flag, m_rules[m_nuRules].factor);
             ++m_nuRules;
+            
+            // the resolutions depend on the rules
+            p_mutex->lock();
+            m_resolved.clear();
+            p_mutex->unlock();
         }
     }
     
@@ -142,21 +182,16 @@ namespace FORZE {
             if(extension == NULL)
                 extension = filename + strlen(filename);
             
-            // GET NAME
-            size_t nameLength = extension - filename;
-            char *name = fzStrcpy(filename, nameLength);
-
             // BUILD
+            int nameLength = extension - filename;
             if(filename[0] == '/')
-                sprintf(absolutePath, "%s%c%s%s", name, FZ_IO_SUBFIX_CHAR, suffix, extension);
+                sprintf(absolutePath, "%.*s%c%s%s", nameLength, filename, FZ_IO_SUBFIX_CHAR, suffix, extension);
             else
             {
                 char relativePath[STRING_MAX_SIZE];
-                sprintf(relativePath, "%s%c%s%s", name, FZ_IO_SUBFIX_CHAR, suffix, extension);
+                sprintf(relativePath, "%.*s%c%s%s", nameLength, filename, FZ_IO_SUBFIX_CHAR, suffix, extension);
                 IO::appendPaths(p_resourcesPath, relativePath, absolutePath);
             }
-
-            delete [] name;
         }
     }
     
@@ -198,33 +233,365 @@ namespace FORZE {
     }
     
     
+    void ResourcesManager::reloadIndex()
+    {
+        p_mutex->lock();
+        
+        m_index.clear();
+        m_indexPaths.clear();
+        m_resolved.clear();
+        m_isIndexed = false;
+        
+        size_t length = strlen(p_resourcesPath);
+        if(length > 0 && length < STRING_MAX_SIZE)
+        {
+            m_isIndexed = loadManifest();
+            if(!m_isIndexed) {
+                char path[STRING_MAX_SIZE];
+                memcpy(path, p_resourcesPath, length+1);
+                
+                DIR *dir = opendir(path);
+                if(dir) {
+                    closedir(dir);
+                    indexDirectory(path, length);
+                    m_isIndexed = true;
+                }
+            }
+        }
+        vector<ResourcesArchive*>::const_iterator it(m_archives.begin());
+        for(; it != m_archives.end(); ++it)
+            indexArchive(*it);
+        
+        sortIndex();
+        p_mutex->unlock();
+        
+        if(m_isIndexed)
+            FZLOGINFO("ResourcesManager: %d files indexed.", (fzUInt)m_index.size());
+        else
+            FZLOGERROR("ResourcesManager: The resources directory could not be indexed, files will be probed.");
+    }
+    
+    
+    bool ResourcesManager::loadManifest()
+    {
+        char absolutePath[STRING_MAX_SIZE];
+        IO::appendPaths(p_resourcesPath, FZ_RESOURCES_MANIFEST, absolutePath);
+        
+        fzBuffer buffer = IO::loadFile(absolutePath);
+        if(buffer.isEmpty())
+            return false;
+        
+        // one relative path per line
+        const char *line = buffer.getPointer();
+        while(*line != '\0')
+        {
+            size_t lineLength = strcspn(line, "\r\n");
+            if(lineLength > 0)
+                addToIndex(line, lineLength);
+            
+            line += lineLength;
+            line += strspn(line, "\r\n");
+        }
+        buffer.free();
+        return true;
+    }
+    
+    
+    void ResourcesManager::indexDirectory(char *path, size_t length)
+    {
+        DIR *dir = opendir(path);
+        if(dir == NULL)
+            return;
+        
+        size_t rootLength = strlen(p_resourcesPath);
+        struct dirent *entry;
+        while((entry = readdir(dir)) != NULL)
+        {
+            // skips ".", ".." and hidden files
+            if(entry->d_name[0] == '.')
+                continue;
+            
+            size_t nameLength = strlen(entry->d_name);
+            if(length + nameLength + 2 > STRING_MAX_SIZE)
+                continue;
+            
+            path[length] = '/';
+            memcpy(path + length + 1, entry->d_name, nameLength + 1);
+            
+            bool isDirectory = (entry->d_type == DT_DIR);
+            if(entry->d_type == DT_UNKNOWN) {
+                struct stat info;
+                isDirectory = (stat(path, &info) == 0 && S_ISDIR(info.st_mode));
+            }
+            
+            if(isDirectory)
+                indexDirectory(path, length + 1 + nameLength);
+            else
+                addToIndex(path + rootLength + 1, length + nameLength - rootLength);
+        }
+        path[length] = '\0';
+        closedir(dir);
+    }
+    
+    
+    void ResourcesManager::indexArchive(const ResourcesArchive *archive)
+    {
+        const vector<fzArchiveEntry>& entries = archive->getEntries();
+        vector<fzArchiveEntry>::const_iterator it(entries.begin());
+        for(; it != entries.end(); ++it) {
+            const char *path = archive->getPath(&(*it));
+            addToIndex(path, strlen(path));
+        }
+    }
+    
+    
+    void ResourcesManager::addToIndex(const char *relativePath, size_t length)
+    {
+        // the path is stored, the hash only speeds up the lookup
+        fzIndexedFile file;
+        file.path = m_indexPaths.size();
+        m_indexPaths.insert(m_indexPaths.end(), relativePath, relativePath + length);
+        m_indexPaths.push_back('\0');
+        file.hash = fzHashLowercase(&m_indexPaths[file.path]);
+        m_index.push_back(file);
+    }
+    
+    
+    void ResourcesManager::sortIndex()
+    {
+        sort(m_index.begin(), m_index.end());
+    }
+    
+    
+    bool ResourcesManager::mountArchive(const char *filename)
+    {
+        FZ_ASSERT(filename != NULL, "Filename can not be NULL.");
+
+        char absolutePath[STRING_MAX_SIZE];
+        generateAbsolutePath(filename, 1, absolutePath);
+        
+        ResourcesArchive *archive = NULL;
+        try {
+            archive = new ResourcesArchive(absolutePath);
+            
+        } catch(std::exception& error) {
+            FZLOGERROR("ResourcesManager: \"%s\" could not be mounted. %s", filename, error.what());
+            return false;
+        }
+        
+        p_mutex->lock();
+        m_archives.push_back(archive);
+        indexArchive(archive);
+        sortIndex();
+        m_resolved.clear();
+        p_mutex->unlock();
+        
+        FZLOGINFO("ResourcesManager: \"%s\" mounted, %d files.", filename, (fzUInt)archive->getEntries().size());
+        return true;
+    }
+    
+    
+    const char* ResourcesManager::getRelativePath(const char *absolutePath) const
+    {
+        size_t length = strlen(p_resourcesPath);
+        if(length == 0)
+            return (absolutePath[0] == '/') ? NULL : absolutePath;
+        
+        if(strncmp(absolutePath, p_resourcesPath, length) == 0 && absolutePath[length] == '/')
+            return absolutePath + length + 1;
+        
+        return NULL;
+    }
+    
+    
+    bool ResourcesManager::isIndexed(char *absolutePath) const
+    {
+        char *relativePath = const_cast<char*>(getRelativePath(absolutePath));
+        if(relativePath == NULL)
+            return false;
+        
+        fzIndexedFile key;
+        key.hash = fzHashLowercase(relativePath);
+        
+        vector<fzIndexedFile>::const_iterator it(lower_bound(m_index.begin(), m_index.end(), key));
+        for(; it != m_index.end() && it->hash == key.hash; ++it)
+        {
+            const char *indexedPath = &m_indexPaths[it->path];
+            if(strcasecmp(indexedPath, relativePath) == 0) {
+                // same length, only the case can differ
+                memcpy(relativePath, indexedPath, strlen(indexedPath));
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    
+    bool ResourcesManager::exists(char *absolutePath) const
+    {
+        // the index also contains the archived files
+        if(isIndexed(absolutePath))
+            return true;
+        
+        if(m_isIndexed && getRelativePath(absolutePath))
+            return false;
+        
+        return IO::checkFile(absolutePath);
+    }
+    
+    
+    bool ResourcesManager::resolvePath(const char *filename, char *absolutePath, fzUInt *factor) const
+    {
+        FZ_ASSERT(filename != NULL, "Filename can not be NULL.");
+        FZ_ASSERT(absolutePath != NULL, "AbsolutePath must be a valid pointer.");
+        FZ_ASSERT(factor != NULL, "Factor can not be NULL.");
+        
+        // files outside the resources directory are probed
+        if(!m_isIndexed || filename[0] == '/') {
+            fzUInt priority = 0;
+            while (getPath(filename, priority, absolutePath, factor)) {
+                p_mutex->lock();
+                bool found = exists(absolutePath);
+                p_mutex->unlock();
+                
+                if(found)
+                    return true;
+                ++priority;
+            }
+            return false;
+        }
+        
+        // the index ignores case, so does the cache
+        string key(filename);
+        fzLowercase(key);
+        bool found = false;
+        
+        p_mutex->lock();
+        fzUInt preferedFactor = Director::Instance().getResourcesFactor();
+        if(preferedFactor != m_resolvedFactor) {
+            m_resolved.clear();
+            m_resolvedFactor = preferedFactor;
+        }
+        
+        map<string, fzInt>::const_iterator it(m_resolved.find(key));
+        if(it != m_resolved.end()) {
+            // looked up again to get the case of the indexed file
+            fzInt priority = it->second;
+            found = (priority >= 0 && getPath(filename, priority, absolutePath, factor) && isIndexed(absolutePath));
+        }
+        else {
+            fzInt priority = -1;
+            for(fzUInt i = 0; getPath(filename, i, absolutePath, factor); ++i) {
+                if(isIndexed(absolutePath)) {
+                    priority = i;
+                    found = true;
+                    break;
+                }
+            }
+            m_resolved.insert(pair<string, fzInt>(key, priority));
+        }
+        p_mutex->unlock();
+        
+        if(!found)
+            *factor = 0;
+        
+        return found;
+    }
+    
+    
+    fzBuffer ResourcesManager::loadPath(const char *absolutePath, bool view) const
+    {
+        const char *relativePath = getRelativePath(absolutePath);
+        if(relativePath)
+        {
+            const ResourcesArchive *archive = NULL;
+            const fzArchiveEntry *entry = NULL;
+            
+            // the last mounted archive wins
+            p_mutex->lock();
+            vector<ResourcesArchive*>::const_reverse_iterator it(m_archives.rbegin());
+            for(; it != m_archives.rend() && entry == NULL; ++it) {
+                archive = *it;
+                entry = archive->getEntry(relativePath);
+            }
+            p_mutex->unlock();
+            
+            if(entry)
+                return view ? archive->getView(entry) : archive->getCopy(entry);
+        }
+        return IO::loadFile(absolutePath);
+    }
+    
+    
     fzBuffer ResourcesManager::loadResource(const char *filename, fzUInt *outFactor) const
     {
         FZ_ASSERT(filename != NULL, "Filename can not be NULL.");
         FZ_ASSERT(outFactor != NULL, "outFactor can not be NULL.");
 
         // REMOVING FORCED FLAGS
-        char *filenameCpy = fzStrcpy(filename);
+        char filenameCpy[STRING_MAX_SIZE];
+        strncpy(filenameCpy, filename, STRING_MAX_SIZE-1);
+        filenameCpy[STRING_MAX_SIZE-1] = '\0';
         IO::removeFileSuffix(filenameCpy);
         
-        // LOOK FOR TEXTURE
-        *outFactor = 0;
+        PrefetchManager::record(kFZPrefetch_Resource, filenameCpy);
+        
+        // PREFETCHED
+        p_mutex->lock();
+        if(!m_prefetched.empty()) {
+            map<string, fzPrefetched>::iterator it(m_prefetched.find(filenameCpy));
+            if(it != m_prefetched.end()) {
+                fzBuffer buffer = it->second.buffer;
+                *outFactor = it->second.factor;
+                m_prefetched.erase(it);
+                p_mutex->unlock();
+                return buffer;
+            }
+        }
+        p_mutex->unlock();
+        
+        // LOOK FOR FILE
         char absolutePath[STRING_MAX_SIZE];
-        fzUInt factor, priority = 0;
+        fzUInt factor;
+        if(resolvePath(filenameCpy, absolutePath, &factor))
+        {
+            fzBuffer buffer = loadPath(absolutePath, false);
+            if(!buffer.isEmpty()) {
+                *outFactor = factor;
+                return buffer;
+            }
+        }
         
-        while (getPath(filenameCpy, priority, absolutePath, &factor))
+        FZLOGERROR("IO: \"%s\" not found.", filename);
+        *outFactor = 0;
+        return fzBuffer::empty();
+    }
+    
+    
+    fzBuffer ResourcesManager::mapResource(const char *filename, fzUInt *outFactor) const
+    {
+        FZ_ASSERT(filename != NULL, "Filename can not be NULL.");
+        FZ_ASSERT(outFactor != NULL, "outFactor can not be NULL.");
+        
+        // REMOVING FORCED FLAGS
+        char filenameCpy[STRING_MAX_SIZE];
+        strncpy(filenameCpy, filename, STRING_MAX_SIZE-1);
+        filenameCpy[STRING_MAX_SIZE-1] = '\0';
+        IO::removeFileSuffix(filenameCpy);
+        
+        char absolutePath[STRING_MAX_SIZE];
+        fzUInt factor;
+        if(resolvePath(filenameCpy, absolutePath, &factor))
         {
-            fzBuffer buffer = IO::loadFile(absolutePath);
+            fzBuffer buffer = loadPath(absolutePath, true);
             if(!buffer.isEmpty()) {
                 *outFactor = factor;
-                delete filenameCpy;
                 return buffer;
             }
-            ++priority;
         }
         
         FZLOGERROR("IO: \"%s\" not found.", filename);
-        delete filenameCpy;
+        *outFactor = 0;
         return fzBuffer::empty();
     }
     
@@ -235,7 +602,7 @@ namespace FORZE {
         char absolutePath[STRING_MAX_SIZE];
         generateAbsolutePath(filename, 1, absolutePath);
         
-        fzBuffer buffer = IO::loadFile(absolutePath);
+        fzBuffer buffer = loadPath(absolutePath, false);
         if(buffer.isEmpty())
             FZLOGERROR("IO: \"%s\" not found.", filename);
         
@@ -243,6 +610,82 @@ namespace FORZE {
     }
     
     
+    void ResourcesManager::addPrefetchedResource(const char *filename, fzBuffer buffer, fzUInt factor)
+    {
+        FZ_ASSERT(filename != NULL, "Filename can not be NULL.");
+        
+        char filenameCpy[STRING_MAX_SIZE];
+        strncpy(filenameCpy, filename, STRING_MAX_SIZE-1);
+        filenameCpy[STRING_MAX_SIZE-1] = '\0';
+        IO::removeFileSuffix(filenameCpy);
+        
+        fzPrefetched prefetched = {buffer, factor};
+        
+        p_mutex->lock();
+        pair<map<string, fzPrefetched>::iterator, bool> result =
+        m_prefetched.insert(pair<string, fzPrefetched>(filenameCpy, prefetched));
+        p_mutex->unlock();
+        
+        // already prefetched
+        if(!result.second)
+            buffer.free();
+    }
+    
+    
+    void ResourcesManager::removePrefetchedResources()
+    {
+        p_mutex->lock();
+        map<string, fzPrefetched>::iterator it(m_prefetched.begin());
+        for(; it != m_prefetched.end(); ++it)
+            it->second.buffer.free();
+        
+        m_prefetched.clear();
+        p_mutex->unlock();
+    }
+    
+    
+    const char* ResourcesManager::getMemoryName() const
+    {
+        return "ResourcesManager";
+    }
+    
+    
+    fzUInt ResourcesManager::getMemoryUsage() const
+    {
+        p_mutex->lock();
+        fzUInt usage = m_index.capacity() * sizeof(fzIndexedFile) + m_indexPaths.capacity();
+        
+        map<string, fzInt>::const_iterator resolved(m_resolved.begin());
+        for(; resolved != m_resolved.end(); ++resolved)
+            usage += sizeof(*resolved) + resolved->first.capacity();
+        
+        map<string, fzPrefetched>::const_iterator it(m_prefetched.begin());
+        for(; it != m_prefetched.end(); ++it)
+            usage += it->second.buffer.getLength();
+        
+        p_mutex->unlock();
+        return usage;
+    }
+    
+    
+    void ResourcesManager::releaseMemory(fzMemoryTier tier)
+    {
+        switch (tier) {
+            case kFZMemoryTier_Cold:
+                removePrefetchedResources();
+                break;
+            case kFZMemoryTier_Reloadable:
+                // resolutions are cached again on demand.
+                p_mutex->lock();
+                m_resolved.clear();
+                p_mutex->unlock();
+                break;
+            default:
+                break;
+        }
+    }
+    
+    
     void ResourcesManager::checkFile(const char* filename) const
     {
         if(filename == NULL)
@@ -258,16 +701,18 @@ namespace FORZE {
         
         FZLog("ResourcesManager:");
         
+        p_mutex->lock();
         while (getPath(filenameCpy, priority, absolutePath, &factor))
         {
-            if(IO::checkFile(absolutePath))
+            if(exists(absolutePath))
                 printf(" - FOUND: %s\n", absolutePath);
             else
                 printf(" - NOT FOUND: %s\n", absolutePath);
 
             ++priority;
         }
+        p_mutex->unlock();
         
-        delete filenameCpy;
+        delete [] filenameCpy;
     }
 }
@@ -34,14 +34,28 @@
 #include "FZTypes.h"
 #include "FZAllocator.h"
 #include "FZSelectors.h"
+#include "FZProtocols.h"
+#include STL_VECTOR
+#include STL_STRING
+#include STL_MAP
 
 
+using namespace STD;
+
 namespace FORZE {
     
 #define FZRULE_MAXSIZE 8
 #define FZRULE_NU 6
+    
+    class mutex;
+    class ResourcesArchive;
 
-    class ResourcesManager : public SELProtocol
+    //! ResourcesManager resolves the filenames to the best file for the device (rules and scaling factor).
+    //! The resources directory is indexed once, from FZ_RESOURCES_MANIFEST if it exists (one relative path
+    //! per line) or by scanning it, so resolving a filename is a lookup instead of several failed fopen() calls.
+    //! Like the file system of iOS and Mac OS X, the indexed paths are matched ignoring case; the resolved path
+    //! gets the case of the indexed file. Resolutions, including misses, are cached.
+    class ResourcesManager : public SELProtocol, public Protocol::Memory
     {
     private:
         static ResourcesManager* p_instance;
@@ -53,9 +67,47 @@ namespace FORZE {
         
         fzUInt m_nuRules;
         char *p_resourcesPath;
+        
+        // Indexed files, sorted by the fzHashLowercase() of their path relative to the resources directory
+        struct fzIndexedFile {
+            uint32_t hash;
+            uint32_t path; // offset in m_indexPaths
+            
+            bool operator < (const fzIndexedFile& other) const {
+                return hash < other.hash;
+            }
+        };
+        vector<fzIndexedFile> m_index;
+        vector<char> m_indexPaths;
+        bool m_isIndexed;
+        
+        // Mounted archives
+        vector<ResourcesArchive*> m_archives;
+        
+        // Resolved priority for each lowercased filename, -1 if not found
+        mutable map<string, fzInt> m_resolved;
+        mutable fzUInt m_resolvedFactor;
+        
+        // Files read in advance (see PrefetchManager), handed over by the next loadResource()
+        struct fzPrefetched {
+            fzBuffer buffer;
+            fzUInt factor;
+        };
+        mutable map<string, fzPrefetched> m_prefetched;
+        mutex *p_mutex;
 
         void _generateAbsolutePath(const char *filename, const char *suffix, char *absolutePath) const;
         
+        void indexDirectory(char *path, size_t length);
+        bool loadManifest();
+        void indexArchive(const ResourcesArchive *archive);
+        void addToIndex(const char *relativePath, size_t length);
+        void sortIndex();
+        const char* getRelativePath(const char *absolutePath) const;
+        bool isIndexed(char *absolutePath) const;
+        bool exists(char *absolutePath) const;
+        fzBuffer loadPath(const char *absolutePath, bool view) const;
+        
         
     protected:
         ResourcesManager();
@@ -76,6 +128,24 @@ namespace FORZE {
         bool getPath(const char *filename, fzUInt priority, char *absolutePath, fzUInt *factor) const;
         
         
+        //! Returns the absolute path of the best existing file for the filename.
+        //! @param factor. Returns the scaling factor of the file, 0 if the file was not found.
+        //! @return false if the file was not found.
+        bool resolvePath(const char *filename, char *absolutePath, fzUInt *factor) const;
+        
+        
+        //! Mounts a packed archive (see tools/fzpack), its files are resolved like any other resource
+        //! and they take precedence over the loose files with the same path.
+        //! @param filename relative to the resources directory or absolute.
+        //! @return false if the archive could not be mapped.
+        bool mountArchive(const char *filename);
+        
+        
+        //! Rebuilds the index of the resources directory.
+        //! Call it if new files were added to the resources directory at runtime.
+        void reloadIndex();
+        
+        
         //! Adding new rules, you can load specified files for each platform version.
         void addRule(const char *device, const char *prefix, fzUInt factor = 1);
         
@@ -85,9 +155,28 @@ namespace FORZE {
         fzBuffer loadResource(const char *filename, fzUInt *factor) const;
         
         
+        //! Like loadResource(), but the returned buffer is read-only: archived files are not copied.
+        //! Use it for data that is only read (compressed textures for example). free() must be called anyway.
+        fzBuffer mapResource(const char *filename, fzUInt *factor) const;
+        
+        
         //! High level method to load a file without scaling factor.
         fzBuffer loadResource(const char *filename) const;
         
+        
+        //! Keeps a file loaded in advance, the next loadResource(filename, factor) returns it without any IO.
+        //! The manager takes the buffer's ownership.
+        void addPrefetchedResource(const char *filename, fzBuffer buffer, fzUInt factor);
+        
+        
+        //! Releases the prefetched files that were never requested.
+        void removePrefetchedResources();        
+        
+        // Protocol::Memory
+        const char* getMemoryName() const override;
+        fzUInt getMemoryUsage() const override;
+        void releaseMemory(fzMemoryTier tier) override;
+        
         void checkFile(const char* file) const;
     };
 }
@@ -31,11 +31,13 @@
 #include "FZScene.h"
 #include "FZDirector.h"
 #include "FZMS.h"
+#include "FZResourceGroup.h"
 
 
 namespace FORZE {
     
     Scene::Scene()
+    : p_resources(NULL)
     {        
         // Config node
         setIsRelativeAnchorPoint(false);
@@ -43,6 +45,32 @@ namespace FORZE {
         setContentSize(Director::Instance().getCanvasSize());
     }
     
+    
+    Scene::~Scene()
+    {
+        // the children still retain what they use, the caches let it go.
+        if(p_resources)
+            p_resources->release();
+    }
+    
+    
+    void Scene::beginResources()
+    {
+        if(p_resources == NULL) {
+            p_resources = new ResourceGroup();
+            p_resources->retain();
+        }
+        p_resources->begin();
+    }
+    
+    
+    void Scene::endResources()
+    {
+        if(p_resources)
+            p_resources->end();
+    }
+    
+    
     void Scene::updateStuff()
     {
         // UPDATE TRANSFORM
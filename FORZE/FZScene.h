@@ -36,6 +36,8 @@
 
 namespace FORZE {
     
+    class ResourceGroup;
+    
     /** Scene is a subclass of Node that is used only as an abstract concept.
      
      Scene an Node are almost identical with the difference that Scene has it's
@@ -45,13 +47,36 @@ namespace FORZE {
      additional logic.
      
      It is a good practice to use and Scene as the parent of all your nodes.
+     
+     The textures, sprite frames, fonts and animations loaded between beginResources() and
+     endResources() (usually the constructor of the subclass) are released with the scene.
      */
     class Scene : public Node
     {
+    protected:
+        ResourceGroup *p_resources;
+        
     public:
         //! Constructs an empty scene.
         explicit Scene();
         
+        // Destructor
+        ~Scene();
+        
+        
+        //! Tags the resources loaded from now on with the scene's ResourceGroup.
+        void beginResources();
+        
+        
+        //! Stops tagging resources with the scene's ResourceGroup.
+        void endResources();
+        
+        
+        //! Returns the scene's ResourceGroup, NULL if beginResources() was never called.
+        ResourceGroup* getResourceGroup() const {
+            return p_resources;
+        }
+        
         virtual void updateStuff() override;
     };
 }
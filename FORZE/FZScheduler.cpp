@@ -29,6 +29,7 @@
  */
 
 #include "FZScheduler.h"
+#include "FZWorkerPool.h"
 #include "FZMacros.h"
 
 
@@ -68,7 +69,12 @@ namespace FORZE {
     
     Scheduler::Scheduler()
     : m_timeScale(1.0f)
-    , m_timers()
+    , m_frame(0)
+    , m_concurrentTimers()
+    , m_concurrentDelta(0)
+    , m_isRunningConcurrent(false)
+    , m_pendingMoves()
+    , m_isTicking(false)
     , p_currentTimer(NULL)
     { }
     
@@ -98,39 +104,93 @@ namespace FORZE {
     }
     
     
-    void Scheduler::scheduleSelector(const SELECTOR_FLOAT selector, SELProtocol *target, fzFloat interval, bool paused, fzUInt priority)
+    fzUInt Scheduler::getFrame() const
+    {
+        return m_frame;
+    }
+    
+    
+    bool Scheduler::findTimer(const SELECTOR_FLOAT selector, SELProtocol *target, fzUpdatePhase *phase, timersList::iterator *timer)
+    {
+        for(fzUInt i = 0; i < kFZUpdatePhase_Count; ++i) {
+            timersList::iterator it(m_timers[i].begin());
+            for(; it != m_timers[i].end(); ++it) {
+                if((it->getTarget() == target) && compareSEL(it->getSelector(), selector)) {
+                    *phase = static_cast<fzUpdatePhase>(i);
+                    *timer = it;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    
+    
+    void Scheduler::scheduleSelector(const SELECTOR_FLOAT selector, SELProtocol *target, fzFloat interval, bool paused, fzUInt priority,
+                                     fzUpdatePhase phase, bool concurrent, UpdatePolicyProtocol *policy)
     {
         FZ_ASSERT( selector != NULL, "Selector must be non-NULL.");
         FZ_ASSERT( target != NULL, "Target must be non-NULL.");
         FZ_ASSERT( interval >= 0, "Interval must be positive.");
+        FZ_ASSERT( phase < kFZUpdatePhase_Count, "Invalid update phase.");
+        FZ_ASSERT( !m_isRunningConcurrent, "Concurrent timers can not schedule selectors.");
 
-        Timer *updatedTimer = NULL;
-        fzUInt i = 0;
-        timersList::iterator it(m_timers.begin());
-        for (; it != m_timers.end(); ++it, ++i) {
-            if ((it->getTarget() == target) && compareSEL(it->getSelector(), selector)) {
-                updatedTimer = &(*it);
-                break;
-            }
-        }
+        fzUpdatePhase oldPhase;
+        timersList::iterator it;
         
-        if(updatedTimer != NULL) {
+        if(findTimer(selector, target, &oldPhase, &it)) {
             
             // Update interval
-            updatedTimer->setInterval(interval);
-            updatedTimer->setIsPaused(paused);
+            it->setInterval(interval);
+            it->setIsPaused(paused);
+            it->m_isConcurrent = concurrent;
+            it->p_policy = policy;
             
-            if (updatedTimer->getPriority() != priority) {
-                updatedTimer->m_priority = priority;
-                m_timers.splice(it, m_timers, indexForPriority(priority));
-            }
+            // the last request wins, even if it restores the current position
+            if(m_isTicking) {
+                fzTimerMove move = {selector, target, priority, phase};
+                m_pendingMoves.push_back(move);
+            }else
+                moveTimer(it, oldPhase, priority, phase);
             
         }else{
-            Timer timer(target, selector, priority, interval);
+            Timer timer(target, selector, priority, interval, phase, concurrent);
             timer.setIsPaused(paused);
+            timer.p_policy = policy;
+            
+            // inserting does not invalidate the iterators of the phase being triggered
+            m_timers[phase].insert(indexForPriority(m_timers[phase], priority), timer);
             
-            m_timers.insert(indexForPriority(priority), timer);
+            // overrides the moves requested for a previous, unscheduled timer
+            if(m_isTicking) {
+                fzTimerMove move = {selector, target, priority, phase};
+                m_pendingMoves.push_back(move);
+            }
+        }
+    }
+    
+    
+    void Scheduler::moveTimer(timersList::iterator timer, fzUpdatePhase oldPhase, fzUInt priority, fzUpdatePhase phase)
+    {
+        if(timer->getPriority() != priority || oldPhase != phase) {
+            timer->m_priority = priority;
+            timer->m_phase = phase;
+            m_timers[phase].splice(indexForPriority(m_timers[phase], priority), m_timers[oldPhase], timer);
+        }
+    }
+    
+    
+    void Scheduler::applyPendingMoves()
+    {
+        // timers unscheduled in the meantime are not found
+        vector<fzTimerMove>::const_iterator move(m_pendingMoves.begin());
+        for(; move != m_pendingMoves.end(); ++move) {
+            fzUpdatePhase oldPhase;
+            timersList::iterator it;
+            if(findTimer(move->selector, move->target, &oldPhase, &it))
+                moveTimer(it, oldPhase, move->priority, move->phase);
         }
+        m_pendingMoves.clear();
     }
     
     
@@ -138,27 +198,26 @@ namespace FORZE {
     {
         FZ_ASSERT( selector != NULL, "Selector must be non-NULL.");
         FZ_ASSERT( target != NULL, "Target must be non-NULL.");
+        FZ_ASSERT( !m_isRunningConcurrent, "Concurrent timers can not unschedule selectors.");
         
-        timersList::iterator it(m_timers.begin());
-        for(; it != m_timers.end(); ++it) {
-            Timer *timer = &(*it);
-            
-            if((timer->getTarget() == target) && compareSEL(timer->getSelector(), selector)) {
-                timer->p_target = NULL;
-                break;
-            }
-        }
+        fzUpdatePhase phase;
+        timersList::iterator it;
+        if(findTimer(selector, target, &phase, &it))
+            it->p_target = NULL;
     }
     
     
     void Scheduler::unscheduleAllSelectors(SELProtocol *target)
     {
         FZ_ASSERT(target != NULL, "Target must be non-NULL.");
+        FZ_ASSERT( !m_isRunningConcurrent, "Concurrent timers can not unschedule selectors.");
         
-        timersList::iterator it(m_timers.begin());
-        for(; it != m_timers.end(); ++it) {
-            if(it->getTarget() == target)
-                it->p_target = NULL;
+        for(fzUInt i = 0; i < kFZUpdatePhase_Count; ++i) {
+            timersList::iterator it(m_timers[i].begin());
+            for(; it != m_timers[i].end(); ++it) {
+                if(it->getTarget() == target)
+                    it->p_target = NULL;
+            }
         }
     }
     
@@ -166,20 +225,25 @@ namespace FORZE {
     void Scheduler::unscheduleAllSelectors()
     {
         FZLOGINFO("Scheduler: warning: unscheduleAllSelectors() is dangerous, actions could stop working.");
-        timersList::iterator it(m_timers.begin());
-        for(; it != m_timers.end(); ++it)
-            it->p_target = NULL;
+        for(fzUInt i = 0; i < kFZUpdatePhase_Count; ++i) {
+            timersList::iterator it(m_timers[i].begin());
+            for(; it != m_timers[i].end(); ++it)
+                it->p_target = NULL;
+        }
     }
     
     
     void Scheduler::pauseTarget(SELProtocol *target)
     {
         FZ_ASSERT(target, "Target can not be NULL.");
+        FZ_ASSERT( !m_isRunningConcurrent, "Concurrent timers can not pause targets.");
         
-        timersList::iterator it(m_timers.begin());
-        for(; it != m_timers.end(); ++it) {
-            if(it->getTarget() == target)
-                it->setIsPaused(true);
+        for(fzUInt i = 0; i < kFZUpdatePhase_Count; ++i) {
+            timersList::iterator it(m_timers[i].begin());
+            for(; it != m_timers[i].end(); ++it) {
+                if(it->getTarget() == target)
+                    it->setIsPaused(true);
+            }
         }
     }
     
@@ -187,19 +251,37 @@ namespace FORZE {
     void Scheduler::resumeTarget(SELProtocol *target)
     {
         FZ_ASSERT(target, "Target can not be NULL.");
+        FZ_ASSERT( !m_isRunningConcurrent, "Concurrent timers can not resume targets.");
 
-        timersList::iterator it(m_timers.begin());
-        for(; it != m_timers.end(); ++it) {
-            if(it->getTarget() == target)
-                it->setIsPaused(false);
+        for(fzUInt i = 0; i < kFZUpdatePhase_Count; ++i) {
+            timersList::iterator it(m_timers[i].begin());
+            for(; it != m_timers[i].end(); ++it) {
+                if(it->getTarget() == target)
+                    it->setIsPaused(false);
+            }
         }
     }
     
     
-    Scheduler::timersList::iterator Scheduler::indexForPriority(fzUInt priority)
+    void Scheduler::setUpdatePolicy(SELProtocol *target, UpdatePolicyProtocol *policy)
     {
-        timersList::iterator it(m_timers.begin());
-        for(; it != m_timers.end(); ++it) {    
+        FZ_ASSERT(target, "Target can not be NULL.");
+        FZ_ASSERT( !m_isRunningConcurrent, "Concurrent timers can not change update policies.");
+        
+        for(fzUInt i = 0; i < kFZUpdatePhase_Count; ++i) {
+            timersList::iterator it(m_timers[i].begin());
+            for(; it != m_timers[i].end(); ++it) {
+                if(it->getTarget() == target)
+                    it->p_policy = policy;
+            }
+        }
+    }
+    
+    
+    Scheduler::timersList::iterator Scheduler::indexForPriority(timersList& timers, fzUInt priority)
+    {
+        timersList::iterator it(timers.begin());
+        for(; it != timers.end(); ++it) {    
             if( priority <= it->getPriority())
                 return it;
         }
@@ -207,26 +289,82 @@ namespace FORZE {
     }
     
     
-    void Scheduler::tick(fzFloat dt)
+    void Scheduler::updateConcurrentTimer(void *ptr, fzUInt index)
     {
-        FZ_ASSERT(dt >= 0.0f, "Tick delta must be positive.");
-        FZ_ASSERT(p_currentTimer == NULL, "Scheduler::tick() can not call himself.");
-        dt *= m_timeScale;
+        Scheduler *scheduler = static_cast<Scheduler*>(ptr);
+        scheduler->m_concurrentTimers[index]->update(scheduler->m_concurrentDelta);
+    }
+    
+    
+    void Scheduler::flushConcurrentTimers(fzFloat dt)
+    {
+        if(m_concurrentTimers.empty())
+            return;
+        
+        p_currentTimer = NULL;
+        m_concurrentDelta = dt;
+        m_isRunningConcurrent = true;
+        WorkerPool::Instance().parallelFor(updateConcurrentTimer, this, m_concurrentTimers.size());
+        m_isRunningConcurrent = false;
         
-        timersList::iterator it(m_timers.begin());
-        for(; it != m_timers.end(); ) {
+        m_concurrentTimers.clear();
+    }
+    
+    
+    void Scheduler::tickPhase(timersList& timers, fzFloat dt)
+    {
+        timersList::iterator it(timers.begin());
+        for(; it != timers.end(); ) {
             if(it->getTarget() == NULL) {
                 p_currentTimer = NULL;
-                m_timers.erase(it++);
+                timers.erase(it++);
             
             } else {
                 if(!it->isPaused()) {
-                    p_currentTimer = &(*it);
-                    it->update(dt);
+                    // dormant targets (kFZUpdateDecision_Sleep) discard the delta time.
+                    fzUpdateDecision decision = (it->p_policy == NULL)
+                    ? kFZUpdateDecision_Update
+                    : it->p_policy->getUpdateDecision(m_frame);
+                    
+                    if(decision == kFZUpdateDecision_Skip)
+                        it->skip(dt);
+                    
+                    else if(decision == kFZUpdateDecision_Update) {
+                        if(it->isConcurrent()) {
+                            // consecutive concurrent timers are triggered together,
+                            // before the next serial timer.
+                            m_concurrentTimers.push_back(&(*it));
+                            
+                        }else{
+                            flushConcurrentTimers(dt);
+                            p_currentTimer = &(*it);
+                            it->update(dt);
+                        }
+                    }
                 }
                 ++it;
             }
         }
+        flushConcurrentTimers(dt);
         p_currentTimer = NULL;
     }
+    
+    
+    void Scheduler::tick(fzFloat dt, fzUpdatePhase first, fzUpdatePhase last)
+    {
+        FZ_ASSERT(dt >= 0.0f, "Tick delta must be positive.");
+        FZ_ASSERT(p_currentTimer == NULL, "Scheduler::tick() can not call himself.");
+        FZ_ASSERT(first <= last && last < kFZUpdatePhase_Count, "Invalid range of phases.");
+        dt *= m_timeScale;
+        
+        if(first == kFZUpdatePhase_Input)
+            ++m_frame;
+        
+        m_isTicking = true;
+        for(fzUInt i = first; i <= last; ++i) {
+            tickPhase(m_timers[i], dt);
+            applyPendingMoves();
+        }
+        m_isTicking = false;
+    }
 }
@@ -34,11 +34,78 @@
 #include "FZTypes.h"
 #include "FZSelectors.h"
 #include STL_LIST
+#include STL_VECTOR
 
 
 using namespace STD;
 
 namespace FORZE {
+    
+    /** @enum fzUpdatePhase
+     * Phases in which the scheduled timers are triggered, in this order, every frame.
+     * Inside a phase, timers are sorted by priority.
+     *
+     * Every phase declares what its timers are expected to read and write:
+     */
+    enum fzUpdatePhase
+    {
+        //! Runs right after the input events were dispatched.
+        //! Reads: input state. Writes: gameplay intents (not the nodes).
+        kFZUpdatePhase_Input = 0,
+        
+        //! Prepares the frame.
+        //! Reads: anything. Writes: game state.
+        kFZUpdatePhase_PreUpdate,
+        
+        //! Actions are stepped here by the ActionManager.
+        //! Reads: game state. Writes: node properties (position, scale, opacity...).
+        kFZUpdatePhase_Actions,
+        
+        //! Default phase, game logic.
+        //! Reads: anything. Writes: game state and nodes.
+        kFZUpdatePhase_Update,
+        
+        //! Runs once the logic of the frame is done (camera follow, physics sync...).
+        //! Reads: final state of the frame. Writes: nodes.
+        kFZUpdatePhase_PostUpdate,
+        
+        //! Runs after the scene switching, right before the scene is rendered.
+        //! Reads: nodes. Writes: rendering-related node properties only.
+        kFZUpdatePhase_PreRender,
+        
+        kFZUpdatePhase_Count
+    };
+    
+    
+    /** @enum fzUpdateDecision
+     * What happens with the timers and actions of a target in the current frame.
+     */
+    enum fzUpdateDecision
+    {
+        //! Triggered normally, the delta time includes the time accumulated while skipped.
+        kFZUpdateDecision_Update,
+        
+        //! Not triggered this frame, the delta time is accumulated.
+        kFZUpdateDecision_Skip,
+        
+        //! Not triggered, the delta time is discarded. The target is dormant.
+        kFZUpdateDecision_Sleep
+    };
+    
+    
+    /** Targets that implement this protocol decide, frame by frame, if their timers and actions are triggered.
+     * Both the Scheduler and the ActionManager honour it. Node implements it, see Node::setUpdatePolicy().
+     */
+    class UpdatePolicyProtocol
+    {
+    public:
+        virtual ~UpdatePolicyProtocol() {}
+        
+        //! Returns the decision for the given frame number.
+        //! It is called from the main thread, once per timer and action.
+        virtual fzUpdateDecision getUpdateDecision(fzUInt frame) = 0;
+    };
+    
 
     class Scheduler;
     class Timer
@@ -47,11 +114,14 @@ namespace FORZE {
         
     protected:
         bool m_paused;
+        bool m_isConcurrent;
+        fzUpdatePhase m_phase;
         fzFloat m_elapsed;
         fzFloat m_interval;
         fzUInt m_priority;
         SELECTOR_FLOAT m_selector;
         SELProtocol *p_target;
+        UpdatePolicyProtocol *p_policy;
         
         //! triggers the timer
         void update(fzFloat dt)
@@ -67,13 +137,26 @@ namespace FORZE {
             }
         }
         
+        //! accumulates the delta time without triggering the timer
+        void skip(fzFloat dt)
+        {
+            if( m_elapsed == -1)
+                m_elapsed = 0;
+            else
+                m_elapsed += dt;
+        }
+        
     public:
         //! Constructs a timer with a target, a selector and an interval in seconds.
-        Timer(SELProtocol* target, SELECTOR_FLOAT selector, fzUInt priority, fzFloat interval)
+        Timer(SELProtocol* target, SELECTOR_FLOAT selector, fzUInt priority, fzFloat interval,
+              fzUpdatePhase phase = kFZUpdatePhase_Update, bool concurrent = false)
         : p_target(target)
+        , p_policy(NULL)
         , m_selector(selector)
         , m_interval(interval)
         , m_priority(priority)
+        , m_phase(phase)
+        , m_isConcurrent(concurrent)
         , m_elapsed(-1)
         , m_paused(true)
         { }
@@ -99,6 +182,18 @@ namespace FORZE {
         }
         
         
+        //! Returns the phase in which the timer is triggered.
+        fzUpdatePhase getPhase() const {
+            return m_phase;
+        }
+        
+        
+        //! Returns true if the timer can run in a worker thread.
+        bool isConcurrent() const {
+            return m_isConcurrent;
+        }
+        
+        
         //! Enables or disables the timer.
         void setIsPaused(bool p) {
             m_paused = p;
@@ -121,6 +216,12 @@ namespace FORZE {
         SELECTOR_FLOAT getSelector() const {
             return m_selector;
         }
+        
+        
+        //! Returns the update policy, NULL if the timer is always triggered.
+        UpdatePolicyProtocol* getUpdatePolicy() const {
+            return p_policy;
+        }
     };
 
 
@@ -134,6 +235,12 @@ namespace FORZE {
      - custom selector: A custom selector will be called every frame, or with a custom interval of time
      
      The 'custom selectors' should be avoided when possible. It is faster, and consumes less memory to use the 'update selector'.
+     
+     Timers are grouped in phases (see fzUpdatePhase), the phases are triggered in order every frame.
+     A timer scheduled as "concurrent" declares that its target is independent: it only writes its own state,
+     so the consecutive concurrent timers of a phase are triggered in parallel by the WorkerPool.
+     Concurrent timers must not schedule/unschedule selectors, run actions, add or remove nodes, retain or release
+     shared objects or call OpenGL.
      */
     class Scheduler
     {
@@ -147,16 +254,52 @@ namespace FORZE {
         // time scale
         fzFloat m_timeScale;
         
-        // list of timers
-        timersList m_timers;
+        // frame number
+        fzUInt m_frame;
+        
+        // list of timers per phase
+        timersList m_timers[kFZUpdatePhase_Count];
+        
+        // concurrent timers waiting to be triggered
+        vector<Timer*> m_concurrentTimers;
+        fzFloat m_concurrentDelta;
+        bool m_isRunningConcurrent;
+        
+        // priority and phase changes requested while the timers are triggered,
+        // applied when the phase finishes so the list being iterated is not modified.
+        struct fzTimerMove {
+            SELECTOR_FLOAT selector;
+            SELProtocol *target;
+            fzUInt priority;
+            fzUpdatePhase phase;
+        };
+        vector<fzTimerMove> m_pendingMoves;
+        bool m_isTicking;
         
         //! Returns the index giving a priority
-        timersList::iterator indexForPriority(fzUInt priority);
+        timersList::iterator indexForPriority(timersList& timers, fzUInt priority);
+        
+        //! Returns the timer for a given selector and target.
+        //! Returns false if the timer is not scheduled.
+        bool findTimer(const SELECTOR_FLOAT selector, SELProtocol *target, fzUpdatePhase *phase, timersList::iterator *timer);
+        
+        //! Moves the timer to the position of its priority in the phase.
+        void moveTimer(timersList::iterator timer, fzUpdatePhase oldPhase, fzUInt priority, fzUpdatePhase phase);
+        
+        //! Applies the moves requested during the last phase.
+        void applyPendingMoves();
         
         Timer *p_currentTimer;
         
-        // 'tick' the scheduler.
-        void tick(fzFloat);
+        // 'tick' the scheduler. Phases from "first" to "last" are triggered.
+        void tick(fzFloat, fzUpdatePhase first = kFZUpdatePhase_Input, fzUpdatePhase last = kFZUpdatePhase_PreRender);
+        
+        // triggers the timers of a phase.
+        void tickPhase(timersList& timers, fzFloat dt);
+        
+        // triggers the pending concurrent timers.
+        void flushConcurrentTimers(fzFloat dt);
+        static void updateConcurrentTimer(void *scheduler, fzUInt index);
         
         
     protected:
@@ -186,12 +329,23 @@ namespace FORZE {
         Timer* getCurrentTimer() const;
         
         
+        //! Returns the number of frames triggered by the scheduler.
+        //! This value is passed to UpdatePolicyProtocol::getUpdateDecision().
+        fzUInt getFrame() const;
+        
+        
         /** The scheduled method will be called every 'interval' seconds.
          If paused is YES, then it won't be called until it is resumed.
          If 'interval' is 0, it will be called every frame, but if so, it recommened to use 'scheduleUpdateForTarget:' instead.
          If the selector is already scheduled, then only the interval parameter will be updated without re-scheduling it again.
+         If it is scheduled while the timers are triggered, the new priority and phase are applied when the current phase finishes.
+         @param phase in which the selector is called. kFZUpdatePhase_Update by default.
+         @param concurrent if true, the selector can be called from a worker thread. See the Scheduler's rules for concurrent timers.
+         @param policy decides frame by frame if the selector is triggered. NULL by default (always triggered).
         */
-        void scheduleSelector(const SELECTOR_FLOAT selector, SELProtocol *target, fzFloat interval, bool paused, fzUInt priority = 2);
+        void scheduleSelector(const SELECTOR_FLOAT selector, SELProtocol *target, fzFloat interval, bool paused, fzUInt priority = 2,
+                              fzUpdatePhase phase = kFZUpdatePhase_Update, bool concurrent = false,
+                              UpdatePolicyProtocol *policy = NULL);
 
         
         /** Unshedules a selector for a given target.
@@ -221,6 +375,12 @@ namespace FORZE {
         //! If the target is not present, nothing happens.
         void resumeTarget(SELProtocol *target);
         
+        
+        //! Sets the update policy used by all the scheduled selectors of the target.
+        //! Selectors scheduled later should receive the policy through scheduleSelector().
+        //! @param policy NULL means that the selectors are always triggered.
+        void setUpdatePolicy(SELProtocol *target, UpdatePolicyProtocol *policy);
+        
     };
 }
 #endif
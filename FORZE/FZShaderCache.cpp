@@ -29,6 +29,9 @@
  */
 
 #include "FZShaderCache.h"
+#include "FZMacros.h"
+#include "FZHash.h"
+#include "FZMemoryManager.h"
 
 #if FZ_GL_SHADERS
 
@@ -38,6 +41,7 @@
 #include "Shaders/_fz_mat_aC4.shader.h"
 #include "Shaders/_fz_mat_uC4.shader.h"
 #include "Shaders/_fz_mat_uC4_TEX.shader.h"
+#include "Shaders/_fz_aC4_SDF.shader.h"
 
 
 namespace FORZE {
@@ -56,6 +60,7 @@ namespace FORZE {
     ShaderCache::ShaderCache()
     {
         loadDefaultShaders();
+        MemoryManager::Instance().addCache(this);
     }
     
     
@@ -123,6 +128,15 @@ namespace FORZE {
         p->retain();
         
         m_programs[kFZShader_nomat_aC4_TEX] = p;
+        
+        
+        // DISTANCE FIELD TEXT
+        p = new GLProgram(GLShader(__fz_vert_nomat_aC4_TEX, GL_VERTEX_SHADER), GLShader(__fz_frag_aC4_SDF, GL_FRAGMENT_SHADER));
+        p->addGenericAttributes();
+        p->link();
+        p->retain();
+        
+        m_programs[kFZShader_nomat_aC4_SDF] = p;
                 
         
         glEnableVertexAttribArray(kFZAttribPosition);
@@ -139,5 +153,90 @@ namespace FORZE {
         
         return m_programs[key];
     }
+    
+    
+    GLProgram* ShaderCache::addProgram(const char* name, const char* vertexSource, const char* fragmentSource)
+    {
+        FZ_ASSERT(name != NULL, "Name can not be NULL.");
+        
+        uint32_t hash = fzHash(name);
+        GLProgram *p = getProgramByName(name);
+        if(p)
+            return p;
+        
+        try {
+            p = new GLProgram(GLShader(vertexSource, GL_VERTEX_SHADER), GLShader(fragmentSource, GL_FRAGMENT_SHADER));
+            p->addGenericAttributes();
+            if(!p->link()) {
+                p->release();
+                FZ_RAISE("GLProgram: Error linking program.");
+            }
+            p->retain();
+            
+        } catch(std::exception& error) {
+            FZLOGERROR("ShaderCache: Error compiling \"%s\". %s", name, error.what());
+            return NULL;
+        }
+        m_namedPrograms.insert(programsPair(hash, p));
+        
+        return p;
+    }
+    
+    
+    GLProgram* ShaderCache::getProgramByName(const char* name) const
+    {
+        FZ_ASSERT(name != NULL, "Name can not be NULL.");
+        
+        programsMap::const_iterator it(m_namedPrograms.find(fzHash(name)));
+        if(it == m_namedPrograms.end())
+            return NULL;
+        
+        return it->second;
+    }
+    
+    
+    void ShaderCache::removeProgramByName(const char* name)
+    {
+        FZ_ASSERT(name != NULL, "Name can not be NULL.");
+        
+        programsMap::iterator it(m_namedPrograms.find(fzHash(name)));
+        if(it != m_namedPrograms.end()) {
+            it->second->release();
+            m_namedPrograms.erase(it);
+        }
+    }
+    
+    
+    void ShaderCache::removeUnusedPrograms()
+    {
+        programsMap::iterator it(m_namedPrograms.begin());
+        for(; it != m_namedPrograms.end(); ) {
+            if(it->second->retainCount() <= 1) {
+                it->second->release();
+                m_namedPrograms.erase(it++);
+            }else
+                ++it;
+        }
+    }
+    
+    
+    const char* ShaderCache::getMemoryName() const
+    {
+        return "ShaderCache";
+    }
+    
+    
+    fzUInt ShaderCache::getMemoryUsage() const
+    {
+        // the program binaries live in the driver, only the objects are counted.
+        return (NUM_SHADERS + m_namedPrograms.size()) * sizeof(GLProgram);
+    }
+    
+    
+    void ShaderCache::releaseMemory(fzMemoryTier tier)
+    {
+        if(tier == kFZMemoryTier_Unused)
+            removeUnusedPrograms();
+    }
 }
 #endif
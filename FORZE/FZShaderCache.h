@@ -32,6 +32,12 @@
  */
 
 #include "FZGLProgram.h"
+#include "FZProtocols.h"
+#if FZ_STL_CPLUSPLUS11
+#include STL_UNORDERED_MAP
+#else
+#include STL_MAP
+#endif
 
 
 namespace FORZE {
@@ -44,18 +50,31 @@ namespace FORZE {
         kFZShader_mat_uC4_TEX,
         kFZShader_mat_uC4,
         
-        kFZShader_nomat_aC4_TEX
+        kFZShader_nomat_aC4_TEX,
+        
+        //! Signed distance field text (see DistanceField), it uses the TEXTURE ATLAS vertex shader.
+        //! Uniforms: u_outlineColor, u_outlineWidth, u_glowColor, u_glowWidth.
+        kFZShader_nomat_aC4_SDF
     };
     
 #if FZ_GL_SHADERS
-#define NUM_SHADERS 6
+#define NUM_SHADERS 7
 
-    class ShaderCache
+    class ShaderCache : public Protocol::Memory
     {
     private:
         static ShaderCache* p_instance;
         GLProgram *m_programs[NUM_SHADERS];
         
+#if FZ_STL_CPLUSPLUS11
+        typedef unordered_map<uint32_t, GLProgram*> programsMap;
+#else
+        typedef map<uint32_t, GLProgram*> programsMap;
+#endif
+        typedef pair<uint32_t, GLProgram*> programsPair;
+        
+        programsMap m_namedPrograms;
+        
         
     protected:
         // Constructors
@@ -75,6 +94,30 @@ namespace FORZE {
         //! Returns the GLProgram associated with the key.
         //! @return NULL if key is invalid.
         GLProgram* getProgramByKey(fzUInt key) const;
+        
+        
+        //! Compiles and links a program with the generic attributes and stores it with the given name.
+        //! If a program with the same name was already added, it is returned instead.
+        //! @return NULL if the program could not be compiled.
+        GLProgram* addProgram(const char* name, const char* vertexSource, const char* fragmentSource);
+        
+        
+        //! Returns the program added with addProgram().
+        //! @return NULL if the name is not found.
+        GLProgram* getProgramByName(const char* name) const;
+        
+        
+        //! Releases the program added with addProgram().
+        void removeProgramByName(const char* name);
+        
+        
+        //! Releases the programs added with addProgram() that are only retained by the cache.
+        void removeUnusedPrograms();        
+        
+        // Protocol::Memory
+        const char* getMemoryName() const override;
+        fzUInt getMemoryUsage() const override;
+        void releaseMemory(fzMemoryTier tier) override;
     };
 #endif
 }
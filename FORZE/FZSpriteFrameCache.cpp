@@ -34,6 +34,8 @@
 #include "FZMacros.h"
 #include "FZSprite.h"
 #include "FZIO.h"
+#include "FZMemoryManager.h"
+#include "FZResourceGroup.h"
 #include "external/rapidxml/rapidxml.hpp"
 
 
@@ -54,7 +56,9 @@ namespace FORZE {
     
     SpriteFrameCache::SpriteFrameCache()
     : m_frames()
-    { }
+    {
+        MemoryManager::Instance().addCache(this);
+    }
     
     
     void SpriteFrameCache::addSpriteFrames(const char* coordsFilename, Texture2D *texture)
@@ -124,6 +128,7 @@ namespace FORZE {
                 continue;
             }
             uint32_t hash = fzHash(attribute->value(), attribute->value_size());
+            ResourceGroup::tag(kFZResource_SpriteFrame, hash);
             
             if(getSpriteFrameByHash(hash).isValid())
                 continue;
@@ -226,7 +231,9 @@ namespace FORZE {
     
     void SpriteFrameCache::addSpriteFrame(const fzSpriteFrame& frame, const char* name)
     {
-        m_frames.insert(framesPair(fzHash(name), frame));
+        uint32_t hash = fzHash(name);
+        ResourceGroup::tag(kFZResource_SpriteFrame, hash);
+        m_frames.insert(framesPair(hash, frame));
     }
     
     
@@ -238,7 +245,13 @@ namespace FORZE {
     
     void SpriteFrameCache::removeSpriteFrameByName(const char* name)
     {
-        m_frames.erase(fzHash(name));
+        removeSpriteFrameByHash(fzHash(name));
+    }
+    
+    
+    void SpriteFrameCache::removeSpriteFrameByHash(uint32_t hash)
+    {
+        m_frames.erase(hash);
     }
     
     
@@ -311,4 +324,23 @@ namespace FORZE {
         }
         return frame;
     }
+    
+    
+    const char* SpriteFrameCache::getMemoryName() const
+    {
+        return "SpriteFrameCache";
+    }
+    
+    
+    fzUInt SpriteFrameCache::getMemoryUsage() const
+    {
+        return m_frames.size() * sizeof(framesPair);
+    }
+    
+    
+    void SpriteFrameCache::releaseMemory(fzMemoryTier)
+    {
+        // Frames are tiny and they can not be reloaded transparently.
+        // The TextureCache never purges the textures referenced by frames.
+    }
 }
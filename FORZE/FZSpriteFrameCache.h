@@ -32,6 +32,7 @@
  */
 
 #include "FZSpriteFrame.h"
+#include "FZProtocols.h"
 
 #if FZ_STL_CPLUSPLUS11
 #include STL_UNORDERED_MAP
@@ -46,15 +47,17 @@ namespace FORZE {
     
     class Texture2D;
     class Sprite;
-    class SpriteFrameCache
+    class SpriteFrameCache : public Protocol::Memory
     {
-    private:
+    public:
         // Simplified types
 #if FZ_STL_CPLUSPLUS11
         typedef unordered_map<uint32_t, fzSpriteFrame> framesMap;
 #else
         typedef map<uint32_t, fzSpriteFrame> framesMap;
 #endif
+        
+    private:
         typedef pair<uint32_t, fzSpriteFrame> framesPair;
 
 
@@ -98,6 +101,10 @@ namespace FORZE {
         void removeSpriteFrameByName(const char* name);
         
         
+        //! Deletes an sprite frame from the sprite frame cache given the hash of its name.
+        void removeSpriteFrameByHash(uint32_t hash);
+        
+        
         /** Removes multiple Sprite Frames from a plist file.
          * Sprite Frames stored in this file will be removed.
          * It is convinient to call this method when a specific texture needs to be removed.
@@ -121,6 +128,12 @@ namespace FORZE {
         const framesMap& getFrames() const {
             return m_frames;
         }
+        
+        
+        // Protocol::Memory
+        const char* getMemoryName() const override;
+        fzUInt getMemoryUsage() const override;
+        void releaseMemory(fzMemoryTier tier) override;
     };
 }
 #endif
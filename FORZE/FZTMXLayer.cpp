@@ -28,11 +28,13 @@
  @author Manuel Martínez-Almeida
  */
 
+#include <sys/mman.h>
+#include <algorithm>
 #include "FZTMXLayer.h"
 #include "FZMacros.h"
 #include "FZMS.h"
 #include "FZSprite.h"
-#include "FZBitOrder.h"
+#include "FZTexture2D.h"
 #include "FZTMXTiledMap.h"
 
 
@@ -41,15 +43,42 @@ using namespace STD;
 using namespace FORZE;
 namespace FORZE {
     
-    TMXLayer::TMXLayer(TMXTiledMap *tiledMap, TMXLayerInfo *layerInfo)
+    static void expandBounds(fzRect& bounds, const fzTMXTileQuad& quad)
+    {
+        // tile quads are axis aligned, vertices[0] is the bottom left corner and vertices[3] the top right one.
+        fzRect rect(quad.vertices[0].x, quad.vertices[0].y,
+                    quad.vertices[3].x - quad.vertices[0].x, quad.vertices[3].y - quad.vertices[0].y);
+        if(bounds.size == FZSizeZero) {
+            bounds = rect;
+            return;
+        }
+        fzFloat minX = fzMin(bounds.origin.x, rect.origin.x);
+        fzFloat minY = fzMin(bounds.origin.y, rect.origin.y);
+        fzFloat maxX = fzMax(bounds.origin.x + bounds.size.width, rect.origin.x + rect.size.width);
+        fzFloat maxY = fzMax(bounds.origin.y + bounds.size.height, rect.origin.y + rect.size.height);
+        bounds = fzRect(minX, minY, maxX - minX, maxY - minY);
+    }
+    
+    
+    TMXLayer::TMXLayer(TMXTiledMap *tiledMap, TMXLayerInfo *layerInfo, bool streaming)
     : m_minGID(INT_MAX)
     , m_maxGID(0)
     , m_orientation(tiledMap->m_mapInfo.getOrientation())
     , m_mapTileSize(tiledMap->m_mapInfo.getTileSize())
     , p_tiles(layerInfo->getTiles())
+    , m_tilesAreMapped(layerInfo->areTilesMapped())
     , m_layerSize(layerInfo->getSize())
     , vertexZvalue_(0)
     , p_batch(tiledMap)
+    , m_chunks()
+    , m_visibleChunks()
+    , m_loadedChunks()
+    , m_chunkColumns(0)
+    , m_chunkRows(0)
+    , m_frame(1)
+    , m_meshVersion(0)
+    , m_isStreaming(streaming)
+    , p_compactTiles(NULL)
     {     
         setTag(layerInfo->getHashName());
         
@@ -68,8 +97,7 @@ namespace FORZE {
     
     TMXLayer::~TMXLayer()
     {
-        if(p_tiles)
-            free( p_tiles);
+        freeTiles();
     }
     
     
@@ -90,7 +118,7 @@ namespace FORZE {
     }
     
     
-    void TMXLayer::appendTileForGID(uint32_t GID, const fzPoint& coord)
+    Sprite* TMXLayer::createTileForGID(uint32_t GID, const fzPoint& coord)
     {
         fzInt idx = coord.x + coord.y * m_layerSize.width;
         fzRect rect = getTileset()->rectForGID(GID);
@@ -104,25 +132,124 @@ namespace FORZE {
 
         newTile->setFlipX((GID & kFlippedHorizontallyFlag));
         newTile->setFlipY((GID & kFlippedVerticallyFlag));
+        
+        return newTile;
+    }
+    
+    
+    void TMXLayer::makeTileQuad(uint32_t GID, const fzPoint& coord, fzTMXTileQuad& quad) const
+    {
+        fzRect rect = getTileset()->rectForGID(GID);
+        fzPoint position = positionAt(coord);
+        
+        // VERTICES
+        quad.vertices[0] = position;
+        quad.vertices[1] = fzVec2(position.x + rect.size.width, position.y);
+        quad.vertices[2] = fzVec2(position.x, position.y + rect.size.height);
+        quad.vertices[3] = fzVec2(position.x + rect.size.width, position.y + rect.size.height);
+        
+        
+        // TEXTURE COORDS
+        // Same mapping than Sprite::updateTextureCoords(), tiles are never rotated.
+        Texture2D *texture = p_batch->getTexture();
+        fzFloat wide = texture->getPixelsWide();
+        fzFloat high = texture->getPixelsHigh();
+        
+        rect *= texture->getFactor();
+        
+#if FZ_FIX_ARTIFACTS_BY_STRECHING_TEXEL
+        wide *= 2;
+        high *= 2;
+        rect.origin.x       = rect.origin.x*2+1;
+        rect.origin.y       = rect.origin.y*2+1;
+        rect.size.width     = rect.size.width*2-2;
+        rect.size.height    = rect.size.height*2-2;
+#endif // ! FZ_FIX_ARTIFACTS_BY_STRECHING_TEXEL
+        
+        fzFloat A = rect.origin.x / wide;
+        fzFloat B = A + rect.size.width / wide;
+        fzFloat C = rect.origin.y / high;
+        fzFloat D = C + rect.size.height / high;
+        
+        if( GID & kFlippedHorizontallyFlag )
+            FZ_SWAP(A, B);
+        
+        if( GID & kFlippedVerticallyFlag )
+            FZ_SWAP(C, D);
+        
+        quad.texCoords[0] = fzVec2(A, D);
+        quad.texCoords[1] = fzVec2(B, D);
+        quad.texCoords[2] = fzVec2(A, C);
+        quad.texCoords[3] = fzVec2(B, C);
+    }
+    
+    
+    void TMXLayer::updateTileQuad(uint32_t GID, const fzPoint& coord)
+    {
+        fzUInt x = coord.x;
+        fzUInt y = coord.y;
+        fzTMXChunk& chunk = chunkAt(x, y);
+        
+        // the quads will be built from the tiles map when the chunk is loaded
+        if( !chunk.isLoaded )
+            return;
+        
+        ++m_meshVersion;
+        uint16_t tile = (x % FZ_TMX_CHUNK_SIZE) + (y % FZ_TMX_CHUNK_SIZE) * FZ_TMX_CHUNK_SIZE;
+        
+        vector<uint16_t>::iterator it(lower_bound(chunk.tiles.begin(), chunk.tiles.end(), tile));
+        fzUInt index = it - chunk.tiles.begin();
+        bool exists = (it != chunk.tiles.end() && *it == tile);
+        
+        if( GID == 0 ) {
+            if( !exists )
+                return;
+            
+            chunk.tiles.erase(it);
+            chunk.quads.erase(chunk.quads.begin() + index);
+            
+            // the following quads were shifted
+            chunk.dirtyBegin = fzMin(chunk.dirtyBegin, index);
+            chunk.dirtyEnd = chunk.quads.size();
+            
+        } else {
+            fzTMXTileQuad quad;
+            makeTileQuad(GID, coord, quad);
+            expandBounds(chunk.bounds, quad);
+            
+            if( exists ) {
+                // patch a single quad
+                chunk.quads[index] = quad;
+                chunk.dirtyBegin = fzMin(chunk.dirtyBegin, index);
+                chunk.dirtyEnd = fzMax(chunk.dirtyEnd, index + 1);
+                
+            } else {
+                chunk.tiles.insert(it, tile);
+                chunk.quads.insert(chunk.quads.begin() + index, quad);
+                chunk.dirtyBegin = fzMin(chunk.dirtyBegin, index);
+                chunk.dirtyEnd = chunk.quads.size();
+            }
+        }
     }
 
     
     void TMXLayer::setupTiles()
     {
-        for( fzUInt y = 0; y < m_layerSize.height; ++y ) {
-            for( fzUInt x = 0; x < m_layerSize.width; ++x ) {
-                
-                fzUInt idx = x + y * m_layerSize.width;
-                uint32_t GID = fzBitOrder_int32LittleToHost(p_tiles[idx]);
-                
-                // XXX: gid == 0 --> empty tile
-                if( GID != 0 ) {
-                    appendTileForGID(GID, fzPoint(x, y));
-                    
-                    // Optimization: update min and max GID rendered by the layer
-                    m_minGID = fzMin(GID, m_minGID);
-                    m_maxGID = fzMax(GID, m_maxGID);
-                }
+        m_chunkColumns = (m_layerSize.width + FZ_TMX_CHUNK_SIZE - 1) / FZ_TMX_CHUNK_SIZE;
+        m_chunkRows = (m_layerSize.height + FZ_TMX_CHUNK_SIZE - 1) / FZ_TMX_CHUNK_SIZE;
+        
+        m_chunks.clear();
+        m_chunks.resize(m_chunkColumns * m_chunkRows);
+        
+        // Streaming layers do not visit the tiles until the chunks come near the screen.
+        if( m_isStreaming ) {
+            compactTiles();
+            return;
+        }
+        
+        for( fzUInt row = 0; row < m_chunkRows; ++row ) {
+            for( fzUInt column = 0; column < m_chunkColumns; ++column ) {
+                loadChunk(column, row);
             }
         }
         
@@ -131,39 +258,164 @@ namespace FORZE {
     }
     
     
-    void TMXLayer::releaseMap()
+    void TMXLayer::compactTiles()
+    {
+        // tiles mapped from the cache are already loaded lazily, compacting them would read the whole map.
+        if( m_tilesAreMapped )
+            return;
+        
+        const fzUInt count = m_layerSize.width * m_layerSize.height;
+        
+        for( fzUInt i = 0; i < count; ++i ) {
+            uint32_t GID = p_tiles[i];
+            if( (GID & kFlippedMask) > 0x3fff )
+                return;
+        }
+        
+        p_compactTiles = new(std::nothrow) uint16_t[count];
+        if( p_compactTiles == NULL )
+            return;
+        
+        // the flip flags are moved to the two highest bits
+        for( fzUInt i = 0; i < count; ++i ) {
+            uint32_t GID = p_tiles[i];
+            p_compactTiles[i] = static_cast<uint16_t>((GID & kFlippedMask) | ((GID & ~kFlippedMask) >> 16));
+        }
+        
+        delete [] reinterpret_cast<char*>(p_tiles);
+        p_tiles = NULL;
+    }
+    
+    
+    void TMXLayer::freeTiles()
     {
-        if( p_tiles) {
-            free( p_tiles);
+        if( p_tiles ) {
+            if( m_tilesAreMapped )
+                munmap(p_tiles, m_layerSize.width * m_layerSize.height * sizeof(uint32_t));
+            else
+                delete [] reinterpret_cast<char*>(p_tiles);
+            
             p_tiles = NULL;
         }
+        if( p_compactTiles ) {
+            delete [] p_compactTiles;
+            p_compactTiles = NULL;
+        }
+    }
+    
+    
+    uint32_t TMXLayer::getGID(fzUInt index) const
+    {
+        if( p_compactTiles ) {
+            uint32_t GID = p_compactTiles[index];
+            return (GID & 0x3fff) | ((GID & 0xc000) << 16);
+        }
+        return p_tiles[index];
+    }
+    
+    
+    void TMXLayer::setGID(fzUInt index, uint32_t GID)
+    {
+        if( p_compactTiles ) {
+            FZ_ASSERT( (GID & kFlippedMask) <= 0x3fff, "TMXLayer: the GID does not fit in the compact tile map.");
+            p_compactTiles[index] = static_cast<uint16_t>((GID & kFlippedMask) | ((GID & ~kFlippedMask) >> 16));
+        }else
+            p_tiles[index] = GID;
+    }
+    
+    
+    void TMXLayer::loadChunk(fzUInt column, fzUInt row)
+    {
+        fzTMXChunk& chunk = m_chunks[column + row * m_chunkColumns];
+        FZ_ASSERT( !chunk.isLoaded, "TMXLayer: the chunk is already loaded.");
+        
+        const fzUInt width = m_layerSize.width;
+        const fzUInt beginX = column * FZ_TMX_CHUNK_SIZE;
+        const fzUInt beginY = row * FZ_TMX_CHUNK_SIZE;
+        const fzUInt endX = fzMin<fzUInt>(beginX + FZ_TMX_CHUNK_SIZE, width);
+        const fzUInt endY = fzMin<fzUInt>(beginY + FZ_TMX_CHUNK_SIZE, m_layerSize.height);
+        
+        // Tiles are visited row by row, so the quads are appended sorted by tile index.
+        for( fzUInt y = beginY; y < endY; ++y ) {
+            for( fzUInt x = beginX; x < endX; ++x ) {
+                
+                fzUInt idx = x + y * width;
+                uint32_t GID = getGID(idx);
+                
+                // XXX: gid == 0 --> empty tile
+                if( GID == 0 )
+                    continue;
+                
+                // the tile is rendered by a sprite created in tileAt()
+                if( chunk.sprites > 0 && getChildByTag(idx) )
+                    continue;
+                
+                fzTMXTileQuad quad;
+                makeTileQuad(GID, fzPoint(x, y), quad);
+                expandBounds(chunk.bounds, quad);
+                
+                chunk.quads.push_back(quad);
+                chunk.tiles.push_back((x - beginX) + (y - beginY) * FZ_TMX_CHUNK_SIZE);
+                
+                // Optimization: update min and max GID rendered by the layer
+                m_minGID = fzMin<fzUInt>(GID, m_minGID);
+                m_maxGID = fzMax<fzUInt>(GID, m_maxGID);
+            }
+        }
+        chunk.isLoaded = true;
+        chunk.p_lastQuad = NULL;
+        ++m_meshVersion;
+        
+        if( m_isStreaming )
+            m_loadedChunks.push_back(&chunk);
+    }
+    
+    
+    void TMXLayer::unloadChunk(fzTMXChunk& chunk)
+    {
+        // swap() releases the memory, clear() does not.
+        vector<fzTMXTileQuad>().swap(chunk.quads);
+        vector<uint16_t>().swap(chunk.tiles);
+        
+        chunk.bounds = FZRectZero;
+        chunk.p_lastQuad = NULL;
+        chunk.dirtyBegin = 0;
+        chunk.dirtyEnd = 0;
+        chunk.isLoaded = false;
+        ++m_meshVersion;
+    }
+    
+    
+    void TMXLayer::releaseMap()
+    {
+        FZ_ASSERT( !m_isStreaming, "TMXLayer: streaming layers can not release the tiles map.");
+        
+        freeTiles();
     }
     
     
     Sprite* TMXLayer::tileAt(const fzPoint& coord)
     {
         FZ_ASSERT( coord.x < m_layerSize.width && coord.y < m_layerSize.height && coord.x >=0 && coord.y >=0, "TMXLayer: invalid position.");
-        FZ_ASSERT( p_tiles, "TMXLayer: the tiles map has been released.");
+        FZ_ASSERT( hasTiles(), "TMXLayer: the tiles map has been released.");
         
         Sprite *tile = NULL;
-        uint32_t gid = tileGIDAt(coord);
+        uint32_t gid = tileGIDAt(coord, true);
         
         // if GID == 0, then no tile is present
         if( gid ) {
             fzInt idx = coord.x + coord.y * m_layerSize.width;
-            tile = static_cast<Sprite*>( getChildByTag(idx) );
+            fzTMXChunk& chunk = chunkAt(coord.x, coord.y);
+            if( chunk.sprites > 0 )
+                tile = static_cast<Sprite*>( getChildByTag(idx) );
             
-            // tile not created yet. create it
+            // tile not created yet. create it, since now the sprite renders the tile instead of the mesh.
             if( ! tile ) {
-                const fzRect& rect = getTileset()->rectForGID(gid);
-                
-                tile = new Sprite(rect);
-                tile->setTag(idx);
-                tile->setAnchorPoint(FZPointZero);
-                tile->setPosition(positionAt(coord));
+                tile = createTileForGID(gid, coord);
                 //tile->setVertexZ(vertexZAt(coord));
-
-                addChild(tile, idx);
+                
+                updateTileQuad(0, coord);
+                ++chunk.sprites;
             }
         }
         return tile;
@@ -173,42 +425,50 @@ namespace FORZE {
     uint32_t TMXLayer::tileGIDAt(const fzPoint& coord, bool flags) const
     {
         FZ_ASSERT( coord.x < m_layerSize.width && coord.y < m_layerSize.height && coord.x >=0 && coord.y >=0, "TMXLayer: invalid position.");
-        FZ_ASSERT( p_tiles, "TMXLayer: the tiles map has been released.");
+        FZ_ASSERT( hasTiles(), "TMXLayer: the tiles map has been released.");
         
-        fzInt idx = coord.x + coord.y * m_layerSize.width;
-        return (flags) ? p_tiles[ idx ] : (p_tiles[ idx ] & kFlippedMask);
+        uint32_t GID = getGID(coord.x + coord.y * m_layerSize.width);
+        return (flags) ? GID : (GID & kFlippedMask);
     }
     
     
     void TMXLayer::setTileGID(uint32_t GID, const fzPoint& coord, bool flags)
     {
         FZ_ASSERT( coord.x < m_layerSize.width && coord.y < m_layerSize.height && coord.x >=0 && coord.y >=0, "TMXLayer: invalid position.");
-        FZ_ASSERT( p_tiles, "TMXLayer: the tiles map has been released.");
-        FZ_ASSERT( GID == 0 || GID >= getTileset()->getFirstGID(), "TMXLayer: invalid gid." );
+        FZ_ASSERT( hasTiles(), "TMXLayer: the tiles map has been released.");
+        FZ_ASSERT( GID == 0 || (GID & kFlippedMask) >= getTileset()->getFirstGID(), "TMXLayer: invalid gid." );
         
-        uint32_t currentGID = tileGIDAt(coord, flags);
+        uint32_t currentGID = tileGIDAt(coord, true);
+        
+        // keep the flip flags of the current tile
+        if( !flags && GID != 0 )
+            GID |= currentGID & (kFlippedHorizontallyFlag | kFlippedVerticallyFlag);
         
         if (currentGID != GID) 
         {
             // setting gid=0 is equal to remove the tile
-            if( GID == 0 )
+            if( GID == 0 ) {
                 removeTileAt(coord);
+                return;
+            }
+            
+            fzInt idx = coord.x + coord.y * m_layerSize.width;
+            setGID(idx, GID);
             
-            // empty tile. create a new one
-            else if( currentGID == 0 )
-                appendTileForGID(GID, coord);
+            m_minGID = fzMin<fzUInt>(GID, m_minGID);
+            m_maxGID = fzMax<fzUInt>(GID, m_maxGID);
             
-            // modifying an existing tile with a non-empty tile
-            else {
-                
-                fzInt idx = coord.x + coord.y * m_layerSize.width;
-                Sprite *sprite = static_cast<Sprite*>(getChildByTag(idx));
-                
-                FZ_ASSERT(sprite, "Sprite was not found.");
+            // the tile is rendered by a sprite created in tileAt()
+            Sprite *sprite = (currentGID != 0 && chunkAt(coord.x, coord.y).sprites > 0)
+            ? static_cast<Sprite*>(getChildByTag(idx)) : NULL;
+            
+            if( sprite ) {
+                sprite->setTextureRect(getTileset()->rectForGID(GID));
+                sprite->setFlipX((GID & kFlippedHorizontallyFlag));
+                sprite->setFlipY((GID & kFlippedVerticallyFlag));
                 
-                const fzRect& rect = getTileset()->rectForGID(GID);
-                sprite->setTextureRect(rect);
-            }
+            } else
+                updateTileQuad(GID, coord);
         }
     }
     
@@ -216,17 +476,23 @@ namespace FORZE {
     void TMXLayer::removeTileAt(const fzPoint& coord)
     {
         FZ_ASSERT( coord.x < m_layerSize.width && coord.y < m_layerSize.height && coord.x >=0 && coord.y >=0, "TMXLayer: invalid position.");
-        FZ_ASSERT( p_tiles, "TMXLayer: the tiles map has been released.");
+        FZ_ASSERT( hasTiles(), "TMXLayer: the tiles map has been released.");
         
         fzInt idx = coord.x + coord.y * m_layerSize.width;
-        uint32_t GID = p_tiles[idx];
+        uint32_t GID = getGID(idx);
         
         if( GID != 0 ) {
             // remove tile from GID map
-            p_tiles[idx] = 0;
+            setGID(idx, 0);
             
-            // remove it from sprites and/or texture atlas
-            removeChildByTag(idx);
+            // remove it from sprites and/or the tile mesh
+            fzTMXChunk& chunk = chunkAt(coord.x, coord.y);
+            Sprite *sprite = (chunk.sprites > 0) ? static_cast<Sprite*>(getChildByTag(idx)) : NULL;
+            if( sprite ) {
+                removeChild(sprite);
+                --chunk.sprites;
+            } else
+                updateTileQuad(0, coord);
         }
     }
     
@@ -265,6 +531,34 @@ namespace FORZE {
         return FZPointZero;
     }
     
+    fzPoint TMXLayer::tileCoordinateAt(const fzPoint& position) const
+    {
+        switch( m_orientation ) {
+            case kFZTMXOrientationOrtho:
+                
+                return fzPoint(position.x / m_mapTileSize.width,
+                               m_layerSize.height - 1 - position.y / m_mapTileSize.height);
+                
+            case kFZTMXOrientationIso:
+            {
+                fzFloat diff = position.x * 2 / m_mapTileSize.width - m_layerSize.width + 1;  // x - y
+                fzFloat sum = m_layerSize.height * 2 - 2 - position.y * 2 / m_mapTileSize.height; // x + y
+                
+                return fzPoint((sum + diff) / 2, (sum - diff) / 2);
+            }
+            case kFZTMXOrientationHex:
+                
+                return fzPoint(position.x / (m_mapTileSize.width * 3/4),
+                               m_layerSize.height - 1 - position.y / m_mapTileSize.height);
+                
+            default:
+                FZ_ASSERT(false, "Invalid map orientation.");
+                break;
+        }
+        return FZPointZero;
+    }
+    
+    
     fzFloat TMXLayer::vertexZAt(const fzPoint& coord) const
     {
         fzFloat ret = 0;
@@ -321,14 +615,176 @@ namespace FORZE {
     }
     
     
+    fzUInt TMXLayer::cullTMXLayer()
+    {
+        m_visibleChunks.clear();
+        ++m_frame;
+        
+        if (!m_isVisible)
+            return 0;
+        
+        if(m_dirtyFlags & kFZDirty_transform_absolute)
+            ++m_meshVersion;
+        
+        updateStuff();
+        
+        // m_transformMV includes the projection, the screen is the (-1, -1) (1, 1) square.
+        const fzRect screen(-1, -1, 2, 2);
+        
+        // CHUNKS UNDER THE SCREEN
+        // The screen is converted to tile coordinates, big tiles can overlap the next ones.
+        fzUInt beginColumn = 0, endColumn = 0, beginRow = 0, endRow = 0;
+        float inverse[16];
+        if( fzMath_mat4Invert(m_transformMV, inverse) ) {
+            fzRect area = fzRect(screen).applyTransform(inverse);
+            const fzPoint corners[4] = {
+                tileCoordinateAt(area.origin),
+                tileCoordinateAt(fzPoint(area.origin.x + area.size.width, area.origin.y)),
+                tileCoordinateAt(fzPoint(area.origin.x, area.origin.y + area.size.height)),
+                tileCoordinateAt(area.origin + area.size)
+            };
+            const fzSize& tileSize = getTileset()->getTileSize();
+            fzFloat margin = fzMax(tileSize.width / m_mapTileSize.width, tileSize.height / m_mapTileSize.height) + 1;
+            
+            fzFloat minX = corners[0].x, maxX = corners[0].x, minY = corners[0].y, maxY = corners[0].y;
+            for(fzUInt i = 1; i < 4; ++i) {
+                minX = fzMin(minX, corners[i].x);
+                maxX = fzMax(maxX, corners[i].x);
+                minY = fzMin(minY, corners[i].y);
+                maxY = fzMax(maxY, corners[i].y);
+            }
+            
+            const fzFloat chunkSize = FZ_TMX_CHUNK_SIZE;
+            beginColumn = fzMax<fzFloat>(floorf((minX - margin) / chunkSize), 0);
+            beginRow = fzMax<fzFloat>(floorf((minY - margin) / chunkSize), 0);
+            endColumn = fzMin<fzFloat>(floorf((maxX + margin) / chunkSize) + 1, m_chunkColumns);
+            endRow = fzMin<fzFloat>(floorf((maxY + margin) / chunkSize) + 1, m_chunkRows);
+        }
+        
+        
+        // STREAMING
+        // The chunks near the screen are built before they are visible,
+        // the ones far from it are discarded. They are not rebuilt until they come back.
+        if( m_isStreaming ) {
+            const fzUInt margin = FZ_TMX_STREAMING_MARGIN;
+            
+            vector<fzTMXChunk*>::iterator it(m_loadedChunks.begin());
+            while(it != m_loadedChunks.end())
+            {
+                fzUInt index = (*it) - &m_chunks.front();
+                fzUInt column = index % m_chunkColumns;
+                fzUInt row = index / m_chunkColumns;
+                
+                if(column + margin + 1 < beginColumn || column > endColumn + margin ||
+                   row + margin + 1 < beginRow || row > endRow + margin)
+                {
+                    unloadChunk(*(*it));
+                    *it = m_loadedChunks.back();
+                    m_loadedChunks.pop_back();
+                    
+                }else
+                    ++it;
+            }
+            
+            fzUInt loadEndColumn = fzMin(endColumn + margin, m_chunkColumns);
+            fzUInt loadEndRow = fzMin(endRow + margin, m_chunkRows);
+            for(fzUInt row = (beginRow > margin) ? beginRow - margin : 0; row < loadEndRow; ++row) {
+                for(fzUInt column = (beginColumn > margin) ? beginColumn - margin : 0; column < loadEndColumn; ++column) {
+                    if(!m_chunks[column + row * m_chunkColumns].isLoaded)
+                        loadChunk(column, row);
+                }
+            }
+        }
+        
+        
+        // VISIBLE CHUNKS
+        fzUInt count = 0;
+        for(fzUInt row = beginRow; row < endRow; ++row) {
+            for(fzUInt column = beginColumn; column < endColumn; ++column)
+            {
+                fzTMXChunk& chunk = m_chunks[column + row * m_chunkColumns];
+                if(!chunk.quads.empty() && fzRect(chunk.bounds).applyTransform(m_transformMV).intersect(screen)) {
+                    m_visibleChunks.push_back(&chunk);
+                    count += chunk.quads.size();
+                }
+            }
+        }
+        return count + m_children.size();
+    }
+    
+    
     void TMXLayer::visitTMXLayer(fzV4_T2_C4_Quad **quadp)
     {
         if (!m_isVisible)
             return;
         
         unsigned char dirtyFlags = m_dirtyFlags & kFZDirty_recursive;
+        bool transformIsDirty = (m_dirtyFlags & kFZDirty_transform_absolute) != 0;
+        bool colorIsDirty = (m_dirtyFlags & (kFZDirty_opacity | kFZDirty_color)) != 0;
         
-        updateStuff();
+        TextureAtlas& atlas = p_batch->m_textureAtlas;
+        const fzColor4B color4(255, 255, 255, static_cast<GLubyte>(m_cachedOpacity * 255));
+        
+        // STATIC TILE MESHES
+        // Chunks are rewritten when they moved inside the atlas or the layer moved,
+        // otherwise only the quads patched by setTileGID() and removeTileAt() are updated.
+        vector<fzTMXChunk*>::const_iterator it(m_visibleChunks.begin());
+        for(; it != m_visibleChunks.end(); ++it)
+        {
+            fzTMXChunk& chunk = *(*it);
+            fzV4_T2_C4_Quad *quads = *quadp;
+            const fzUInt count = chunk.quads.size();
+            
+            // the quads are only kept if the chunk was written at the same place in the previous frame
+            fzUInt begin = chunk.dirtyBegin;
+            fzUInt end = fzMin(chunk.dirtyEnd, count);
+            if(transformIsDirty || chunk.p_lastQuad != quads || chunk.lastFrame + 1 != m_frame) {
+                begin = 0;
+                end = count;
+            }
+            
+            for(fzUInt i = begin; i < end; ++i)
+            {
+                fzVec4 output[4];
+                const fzTMXTileQuad& tile = chunk.quads[i];
+                fzMath_mat4Vec4(m_transformMV,
+                                reinterpret_cast<const float*>(tile.vertices),
+                                reinterpret_cast<float*>(output));
+                
+                fzV4_T2_C4_Quad& quad = quads[i];
+                quad.bl.vertex = output[0];
+                quad.br.vertex = output[1];
+                quad.tl.vertex = output[2];
+                quad.tr.vertex = output[3];
+                
+                quad.bl.texCoord = tile.texCoords[0];
+                quad.br.texCoord = tile.texCoords[1];
+                quad.tl.texCoord = tile.texCoords[2];
+                quad.tr.texCoord = tile.texCoords[3];
+                atlas.updateQuad(&quad);
+            }
+            
+            fzUInt colorBegin = (colorIsDirty) ? 0 : begin;
+            fzUInt colorEnd = (colorIsDirty) ? count : end;
+            for(fzUInt i = colorBegin; i < colorEnd; ++i)
+            {
+                fzV4_T2_C4_Quad& quad = quads[i];
+                quad.bl.color = color4;
+                quad.br.color = color4;
+                quad.tl.color = color4;
+                quad.tr.color = color4;
+                atlas.updateQuad(&quad);
+            }
+            
+            chunk.p_lastQuad = quads;
+            chunk.lastFrame = m_frame;
+            chunk.dirtyBegin = count;
+            chunk.dirtyEnd = 0;
+            *quadp += count;
+        }
+        
+        
+        // SPRITES CREATED BY tileAt()
         MS::pushMatrix(m_transformMV);
         
         Sprite *child;
@@ -338,8 +794,27 @@ namespace FORZE {
             child->updateTransform(quadp);
         }
         MS::pop();
+        
+        m_dirtyFlags = 0;
     }
     
+    void TMXLayer::getTileVertices(vector<fzVec2>& output) const
+    {
+        vector<fzTMXChunk>::const_iterator it(m_chunks.begin());
+        for(; it != m_chunks.end(); ++it)
+        {
+            const fzUInt count = it->quads.size();
+            fzUInt offset = output.size();
+            output.resize(offset + count * 4);
+            
+            for(fzUInt i = 0; i < count; ++i, offset += 4)
+                fzMath_mat4Vec2(m_transformMV,
+                                reinterpret_cast<const float*>(it->quads[i].vertices),
+                                reinterpret_cast<float*>(&output[offset]));
+        }
+    }
+    
+    
     void TMXLayer::render(unsigned char dirtyFlags)
     {
         FZ_ASSERT(false, "You can not render a TMXLayer manually.");
@@ -49,6 +49,54 @@ namespace FORZE {
     class TMXTilesetInfo;
     
     
+    //! Cached quad of a tile, in layer coordinates.
+    struct fzTMXTileQuad
+    {
+        fzVec2 vertices[4];
+        fzVec2 texCoords[4];
+    };
+    
+    
+    //! Block of FZ_TMX_CHUNK_SIZE x FZ_TMX_CHUNK_SIZE tiles rendered as a static mesh.
+    struct fzTMXChunk
+    {
+        //! Bounding box of the quads in layer coordinates, used for culling.
+        fzRect bounds;
+        
+        //! Quads of the non-empty tiles, sorted by tile index.
+        vector<fzTMXTileQuad> quads;
+        
+        //! Tile index inside the chunk of every quad.
+        vector<uint16_t> tiles;
+        
+        //! Quad of the texture atlas where the chunk was written in the frame lastFrame.
+        fzV4_T2_C4_Quad *p_lastQuad;
+        fzUInt lastFrame;
+        
+        //! Range of quads patched since the last frame.
+        fzUInt dirtyBegin;
+        fzUInt dirtyEnd;
+        
+        //! Number of tiles of the chunk rendered by sprites, see TMXLayer::tileAt().
+        fzUInt sprites;
+        
+        //! In streaming mode the quads are only built for chunks near the screen.
+        bool isLoaded;
+        
+        fzTMXChunk()
+        : bounds(FZRectZero)
+        , quads()
+        , tiles()
+        , p_lastQuad(NULL)
+        , lastFrame(0)
+        , dirtyBegin(0)
+        , dirtyEnd(0)
+        , sprites(0)
+        , isLoaded(false)
+        { }
+    };
+    
+    
     class TMXLayer : public Node
     {
         friend class TMXTiledMap;
@@ -57,7 +105,35 @@ namespace FORZE {
         fzUInt			m_minGID;
         fzUInt			m_maxGID;
         
+        // static tile meshes
+        vector<fzTMXChunk>  m_chunks;
+        vector<fzTMXChunk*> m_visibleChunks;
+        vector<fzTMXChunk*> m_loadedChunks;
+        fzUInt              m_chunkColumns;
+        fzUInt              m_chunkRows;
+        fzUInt              m_frame;
+        fzUInt              m_meshVersion;
+        bool                m_isStreaming;
+        
+        // 14 bits GIDs plus the flip flags, used by streaming layers when the tileset is small enough
+        uint16_t            *p_compactTiles;
+        
         void setupTiles();
+        void compactTiles();
+        void freeTiles();
+        fzTMXChunk& chunkAt(fzUInt x, fzUInt y) {
+            return m_chunks[(x / FZ_TMX_CHUNK_SIZE) + (y / FZ_TMX_CHUNK_SIZE) * m_chunkColumns];
+        }
+        void loadChunk(fzUInt column, fzUInt row);
+        void unloadChunk(fzTMXChunk& chunk);
+        void makeTileQuad(uint32_t GID, const fzPoint& coord, fzTMXTileQuad& quad) const;
+        void updateTileQuad(uint32_t GID, const fzPoint& coord);
+        
+        uint32_t getGID(fzUInt index) const;
+        void setGID(fzUInt index, uint32_t GID);
+        bool hasTiles() const {
+            return p_tiles || p_compactTiles;
+        }
         
         
     protected:
@@ -70,8 +146,9 @@ namespace FORZE {
         // map size in tiles
         fzSize				m_mapTileSize;
         
-        // tiles in raw format
+        // GIDs in host byte order, mapped from the TMX cache if m_tilesAreMapped is true
         uint32_t			*p_tiles;
+        bool                m_tilesAreMapped;
         
         // map orientation
         fzTMXOrientation    m_orientation;
@@ -85,7 +162,7 @@ namespace FORZE {
         bool    useAutomaticVertexZ_;
         float	alphaFuncValue_;
         
-        void appendTileForGID(uint32_t GID, const fzPoint& position);
+        Sprite* createTileForGID(uint32_t GID, const fzPoint& coord);
         
         // internal protocol
         virtual void insertChild(Node*) override;
@@ -93,16 +170,20 @@ namespace FORZE {
     public:
         
         //! This constructor is used internally by TMXTilesMap at loading.
-        TMXLayer(TMXTiledMap *mapInfo, TMXLayerInfo *layerInfo);
+        //! If streaming is true, the chunks are built when they come near the screen and discarded when they leave it.
+        TMXLayer(TMXTiledMap *mapInfo, TMXLayerInfo *layerInfo, bool streaming = false);
         ~TMXLayer();
 
         
         //! This method removes the raw data of the tiles.
+        //! Streaming layers need the tiles to build the chunks, they can not release them.
         //! @see tileGIDAt()
         void releaseMap();
         
         
         //! Returns the sprite at the specified coordinate.
+        //! Tiles are rendered as static meshes, the sprite is created the first time this method is called
+        //! for a coordinate and since then the tile is rendered by the sprite.
         //! @return NULL is no tile exists at the specified coordinate.
         Sprite* tileAt(const fzPoint& tileCoordinate);
         
@@ -111,11 +192,18 @@ namespace FORZE {
         uint32_t tileGIDAt(const fzPoint& tileCoordinate, bool flags = false) const;
         
         
+        //! Sets the GID of the tile at the specified coordinate, only the quad of that tile is updated.
+        //! If flags is false, the flip flags of the current tile are kept.
         void setTileGID(uint32_t GID, const fzPoint& coord, bool flags = false);
         
+        //! Removes the tile at the specified coordinate, only the quad of that tile is updated.
         void removeTileAt(const fzPoint& tileCoordinate);
         
         fzPoint positionAt(const fzPoint& tileCoordinate) const;
+        
+        //! Returns the tile coordinate at the specified position in layer coordinates, the inverse of positionAt().
+        //! The coordinate is not clamped to the layer size.
+        fzPoint tileCoordinateAt(const fzPoint& position) const;
         fzFloat vertexZAt(const fzPoint& pos) const;
 
         
@@ -133,6 +221,26 @@ namespace FORZE {
             return m_mapTileSize;
         }
         
+        bool isStreaming() const {
+            return m_isStreaming;
+        }
+        
+        
+        //! Returns a number that changes every time the built tiles or their transform change.
+        //! @see getTileVertices()
+        fzUInt getMeshVersion() const {
+            return m_meshVersion;
+        }
+        
+        
+        //! Appends the four vertices (bl, br, tl, tr) of every built tile quad, transformed like Sprite::getVertices().
+        //! Tiles rendered by sprites are not included, they are children of the layer.
+        void getTileVertices(vector<fzVec2>& output) const;
+        
+        //! Culls the chunks against the screen.
+        //! @return the number of quads visitTMXLayer() will write.
+        fzUInt cullTMXLayer();
+        
         void visitTMXLayer(fzV4_T2_C4_Quad **quadp);
 
         fzPoint calculateLayerOffset(const fzPoint& pos) const;
@@ -28,10 +28,18 @@
  @author Manuel Martínez-Almeida
  */
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+
 #include "FZTMXParser.h"
 #include "FZMacros.h"
 #include "FZResourcesManager.h"
 #include "FZData.h"
+#include "FZBitOrder.h"
+#include "FZOSW.h"
 #include "external/rapidxml/rapidxml.hpp"
 
 
@@ -39,6 +47,18 @@ using namespace rapidxml;
 using namespace STD;
 
 namespace FORZE {
+    
+    static bool readAll(int fd, void *output, size_t length)
+    {
+        return read(fd, output, length) == (ssize_t)length;
+    }
+    
+    
+    static size_t alignOffset(size_t offset, size_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+    
 
     TMXMapInfo::TMXMapInfo()
     : m_tileset()
@@ -57,6 +77,23 @@ namespace FORZE {
         if(data.isEmpty())
             FZ_RAISE("TMXParser: Impossible to load file.");
         
+#if FZ_TMX_CACHE
+        // The source file is still loaded to validate the cache, hashing it is much cheaper than parsing it.
+        char cachePath[1024];
+        {
+            char cacheName[64];
+            snprintf(cacheName, sizeof(cacheName), "tmx_%08x_%u.cache", fzHash(filename), (unsigned)m_factor);
+            fzOSW_getPersistentPath(cacheName, cachePath, sizeof(cachePath));
+        }
+        const uint32_t sourceHash = fzHash(data.getPointer(), data.getLength());
+        const fzUInt sourceLength = data.getLength();
+        
+        if(loadCache(cachePath, sourceHash, sourceLength)) {
+            data.free();
+            return;
+        }
+#endif
+        
         try {
             parseTMXData(data.getPointer());
             data.free();
@@ -65,6 +102,189 @@ namespace FORZE {
             data.free();
             throw;
         }
+        
+#if FZ_TMX_CACHE
+        saveCache(cachePath, sourceHash, sourceLength);
+#endif
+    }
+    
+    
+    bool TMXMapInfo::loadCache(const char *absolutePath, uint32_t sourceHash, fzUInt sourceLength)
+    {
+        int fd = open(absolutePath, O_RDONLY);
+        if(fd < 0)
+            return false;
+        
+        struct stat info;
+        fzTMXCacheHeader header;
+        fzTMXCacheTileset tileset;
+        if(fstat(fd, &info) != 0 ||
+           !readAll(fd, &header, sizeof(header)) ||
+           header.magic != FZ_TMX_CACHE_MAGIC ||
+           header.version != FZ_TMX_CACHE_VERSION ||
+           header.byteOrder != 0x01020304 ||
+           header.sourceHash != sourceHash ||
+           header.sourceLength != sourceLength ||
+           header.factor != m_factor ||
+           header.orientation > kFZTMXOrientationHex ||
+           header.layerCount > (size_t)info.st_size / sizeof(fzTMXCacheLayer) ||
+           !readAll(fd, &tileset, sizeof(tileset)) ||
+           tileset.nameLength > (size_t)info.st_size ||
+           tileset.filenameLength > (size_t)info.st_size ||
+           tileset.nameLength + tileset.filenameLength > (size_t)info.st_size)
+        {
+            close(fd);
+            return false;
+        }
+        
+        // TILESET STRINGS
+        vector<char> strings(alignOffset(tileset.nameLength + tileset.filenameLength, 4));
+        vector<fzTMXCacheLayer> layers(header.layerCount);
+        if((!strings.empty() && !readAll(fd, &strings.front(), strings.size())) ||
+           (!layers.empty() && !readAll(fd, &layers.front(), layers.size() * sizeof(fzTMXCacheLayer))))
+        {
+            close(fd);
+            return false;
+        }
+        
+        // TILES
+        // They are mapped copy-on-write, pages are read lazily and only the modified ones are copied.
+        vector<TMXLayerInfo> layerInfos(header.layerCount);
+        fzUInt i = 0;
+        for(; i < header.layerCount; ++i)
+        {
+            const fzTMXCacheLayer& layer = layers[i];
+            TMXLayerInfo& layerInfo = layerInfos[i];
+            if(!(layer.width >= 0 && layer.height >= 0) || layer.width * layer.height > info.st_size / sizeof(uint32_t))
+                break;
+            
+            size_t length = (size_t)layer.width * (size_t)layer.height * sizeof(uint32_t);
+            
+            if(layer.tilesOffset % FZ_TMX_CACHE_ALIGNMENT != 0 ||
+               length > (size_t)info.st_size ||
+               layer.tilesOffset > (size_t)info.st_size - length)
+                break;
+            
+            if(length > 0) {
+                void *tiles = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, layer.tilesOffset);
+                if(tiles == MAP_FAILED)
+                    break;
+                
+                layerInfo.p_tiles = static_cast<uint32_t*>(tiles);
+                layerInfo.m_tilesAreMapped = true;
+            }
+            layerInfo.m_nameHash = layer.nameHash;
+            layerInfo.m_visible = layer.visible != 0;
+            layerInfo.m_opacity = layer.opacity;
+            layerInfo.m_offset = fzPoint(layer.offsetX, layer.offsetY);
+            layerInfo.m_size = fzSize(layer.width, layer.height);
+        }
+        
+        // the mappings stay valid after closing the descriptor
+        close(fd);
+        
+        if(i != header.layerCount) {
+            for(fzUInt n = 0; n < i; ++n) {
+                if(layerInfos[n].p_tiles)
+                    munmap(layerInfos[n].p_tiles, layerInfos[n].m_size.width * layerInfos[n].m_size.height * sizeof(uint32_t));
+            }
+            FZLOGERROR("TMXParser: The cache \"%s\" is corrupted.", absolutePath);
+            return false;
+        }
+        
+        m_orientation = static_cast<fzTMXOrientation>(header.orientation);
+        m_mapSize = fzSize(header.mapWidth, header.mapHeight);
+        m_tileSize = fzSize(header.tileWidth, header.tileHeight);
+        
+        m_tileset.m_firstGID = tileset.firstGID;
+        m_tileset.m_spacing = tileset.spacing;
+        m_tileset.m_margin = tileset.margin;
+        m_tileset.m_tileSize = fzSize(tileset.tileWidth, tileset.tileHeight);
+        m_tileset.m_name = string(strings.empty() ? "" : &strings.front(), tileset.nameLength);
+        m_tileset.m_filename = string(strings.empty() ? "" : &strings.front() + tileset.nameLength, tileset.filenameLength);
+        
+        m_layers.swap(layerInfos);
+        return true;
+    }
+    
+    
+    void TMXMapInfo::saveCache(const char *absolutePath, uint32_t sourceHash, fzUInt sourceLength) const
+    {
+        FILE *f = fopen(absolutePath, "wb");
+        if(f == NULL) {
+            FZLOGERROR("TMXParser: The cache \"%s\" can not be created.", absolutePath);
+            return;
+        }
+        
+        // HEADER
+        fzTMXCacheHeader header;
+        header.magic = FZ_TMX_CACHE_MAGIC;
+        header.version = FZ_TMX_CACHE_VERSION;
+        header.byteOrder = 0x01020304;
+        header.sourceHash = sourceHash;
+        header.sourceLength = sourceLength;
+        header.factor = m_factor;
+        header.orientation = m_orientation;
+        header.layerCount = m_layers.size();
+        header.mapWidth = m_mapSize.width;
+        header.mapHeight = m_mapSize.height;
+        header.tileWidth = m_tileSize.width;
+        header.tileHeight = m_tileSize.height;
+        fwrite(&header, sizeof(header), 1, f);
+        
+        // TILESET
+        fzTMXCacheTileset tileset;
+        tileset.firstGID = m_tileset.m_firstGID;
+        tileset.spacing = m_tileset.m_spacing;
+        tileset.margin = m_tileset.m_margin;
+        tileset.tileWidth = m_tileset.m_tileSize.width;
+        tileset.tileHeight = m_tileset.m_tileSize.height;
+        tileset.nameLength = m_tileset.m_name.size();
+        tileset.filenameLength = m_tileset.m_filename.size();
+        fwrite(&tileset, sizeof(tileset), 1, f);
+        
+        const char padding[4] = {0, 0, 0, 0};
+        size_t stringsLength = tileset.nameLength + tileset.filenameLength;
+        fwrite(m_tileset.m_name.data(), 1, tileset.nameLength, f);
+        fwrite(m_tileset.m_filename.data(), 1, tileset.filenameLength, f);
+        fwrite(padding, 1, alignOffset(stringsLength, 4) - stringsLength, f);
+        
+        // LAYERS
+        size_t offset = sizeof(header) + sizeof(tileset) + alignOffset(stringsLength, 4) + m_layers.size() * sizeof(fzTMXCacheLayer);
+        vector<TMXLayerInfo>::const_iterator it(m_layers.begin());
+        for(; it != m_layers.end(); ++it)
+        {
+            offset = alignOffset(offset, FZ_TMX_CACHE_ALIGNMENT);
+            
+            fzTMXCacheLayer layer;
+            layer.nameHash = it->m_nameHash;
+            layer.visible = it->m_visible;
+            layer.opacity = it->m_opacity;
+            layer.offsetX = it->m_offset.x;
+            layer.offsetY = it->m_offset.y;
+            layer.width = it->m_size.width;
+            layer.height = it->m_size.height;
+            layer.tilesOffset = offset;
+            fwrite(&layer, sizeof(layer), 1, f);
+            
+            offset += (size_t)layer.width * (size_t)layer.height * sizeof(uint32_t);
+        }
+        
+        // TILES
+        for(it = m_layers.begin(); it != m_layers.end(); ++it)
+        {
+            size_t length = (size_t)it->m_size.width * (size_t)it->m_size.height * sizeof(uint32_t);
+            fseek(f, alignOffset(ftell(f), FZ_TMX_CACHE_ALIGNMENT), SEEK_SET);
+            fwrite(it->p_tiles, 1, length, f);
+        }
+        
+        bool failed = ferror(f) != 0;
+        fclose(f);
+        
+        if(failed) {
+            FZLOGERROR("TMXParser: Error writing the cache \"%s\".", absolutePath);
+            fzOSW_removePath(absolutePath);
+        }
     }
     
     void TMXMapInfo::parseTMXData(char* data)
@@ -231,22 +451,42 @@ namespace FORZE {
            (strncmp(attribute->value(), "gzip", attribute->value_size()) == 0 ||
             strncmp(attribute->value(), "zlib", attribute->value_size()) == 0))
         {
+            // the layer size gives the exact length, the tiles are inflated straight into their final array.
             fzUInt expectedSize = info.m_size.width * info.m_size.height * sizeof(uint32_t);
-            buffer1 = Data::inflateZIPWithHint((unsigned char*)buffer2.getPointer(), buffer2.getLength(), expectedSize);
+            char *tiles = new(std::nothrow) char[expectedSize];
+            if(tiles == NULL) {
+                buffer2.free();
+                FZLOGERROR("TMXParser: Impossible to allocate memory.");
+                return false;
+            }
+            bool inflated = Data::inflateZIPInto((const unsigned char*)buffer2.getPointer(), buffer2.getLength(),
+                                                 (unsigned char*)tiles, expectedSize);
             buffer2.free();
             
-            
-            
-            if(expectedSize != buffer1.getLength()) {
-                buffer1.free();
-                FZLOGERROR("TMXParser: TMX data looks corrupted, hint failed while inflating data.");
+            if(!inflated) {
+                delete [] tiles;
+                FZLOGERROR("TMXParser: TMX data looks corrupted, the inflated length does not match the layer size.");
                 return false;
             }
+            buffer1 = fzBuffer(tiles, expectedSize);
             
-        }else
+        }else {
+            if(buffer2.getLength() != info.m_size.width * info.m_size.height * sizeof(uint32_t)) {
+                buffer2.free();
+                FZLOGERROR("TMXParser: TMX data looks corrupted, the decoded length does not match the layer size.");
+                return false;
+            }
             buffer1 = buffer2;
+        }
         
         info.p_tiles = reinterpret_cast<uint32_t*>(buffer1.getPointer());
+        
+        // GIDs are stored in little endian, they are converted once here.
+        if(fzBitOrder_int32LittleToHost(1) != 1) {
+            fzUInt count = info.m_size.width * info.m_size.height;
+            for(fzUInt i = 0; i < count; ++i)
+                info.p_tiles[i] = fzBitOrder_int32Swap(info.p_tiles[i]);
+        }
         return true;
     }
 
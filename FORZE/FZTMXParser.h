@@ -44,6 +44,12 @@ using namespace STD;
 #define kFlippedVerticallyFlag		0x40000000
 #define kFlippedMask				~(kFlippedHorizontallyFlag|kFlippedVerticallyFlag)
 
+#define FZ_TMX_CACHE_MAGIC 0x4d545a46 // "FZTM"
+#define FZ_TMX_CACHE_VERSION 1
+
+// Tiles are aligned to the biggest page size, so they can be mapped on any device.
+#define FZ_TMX_CACHE_ALIGNMENT 16384
+
 
 
 namespace FORZE {
@@ -61,6 +67,59 @@ namespace FORZE {
         kFZTMXOrientationHex,
     };
     
+    
+    /** Binary cache of a parsed TMX file, written and read by TMXMapInfo. Host byte order.
+     * - fzTMXCacheHeader
+     * - fzTMXCacheTileset followed by the tileset name and filename, padded to 4 bytes.
+     * - fzTMXCacheLayer[layerCount]
+     * - Tiles (uint32_t GIDs) of every layer at FZ_TMX_CACHE_ALIGNMENT boundaries.
+     */
+    struct fzTMXCacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        
+        //! 0x01020304 in the byte order of the device that wrote the cache.
+        uint32_t byteOrder;
+        
+        //! fzHash() and length of the source TMX file.
+        uint32_t sourceHash;
+        uint32_t sourceLength;
+        
+        uint32_t factor;
+        uint32_t orientation;
+        uint32_t layerCount;
+        float mapWidth;
+        float mapHeight;
+        float tileWidth;
+        float tileHeight;
+    };
+    
+    struct fzTMXCacheTileset
+    {
+        uint32_t firstGID;
+        float spacing;
+        float margin;
+        float tileWidth;
+        float tileHeight;
+        uint32_t nameLength;
+        uint32_t filenameLength;
+    };
+    
+    struct fzTMXCacheLayer
+    {
+        uint32_t nameHash;
+        uint32_t visible;
+        float opacity;
+        float offsetX;
+        float offsetY;
+        float width;
+        float height;
+        
+        //! Offset of the tiles from the beginning of the file.
+        uint32_t tilesOffset;
+    };
+    
     struct TMXProperties
     {
         struct
@@ -81,6 +140,7 @@ namespace FORZE {
         fzFloat     m_opacity;
         uint32_t     m_nameHash;
         uint32_t    *p_tiles;
+        bool        m_tilesAreMapped;
         fzPoint     m_offset;
         fzSize      m_size;        
        
@@ -93,6 +153,7 @@ namespace FORZE {
         , m_size(FZSizeZero)
         , m_nameHash(-1)
         , p_tiles(NULL)
+        , m_tilesAreMapped(false)
         { }
         
         
@@ -116,9 +177,15 @@ namespace FORZE {
             return m_size;
         }
         
+        //! Returns the GIDs in host byte order, the layer takes their ownership.
         uint32_t* getTiles() const {
             return p_tiles;
         }
+        
+        //! Returns true if the tiles are mapped from the binary cache (copy-on-write), they are released with munmap().
+        bool areTilesMapped() const {
+            return m_tilesAreMapped;
+        }
     };
     
     
@@ -217,6 +284,9 @@ namespace FORZE {
         bool parseTileset(void* outputData, TMXTilesetInfo& info);
         bool parseObjectGroup(void* outputData, TMXObjectGroup& info);
         bool parseProperties(void* outputData, TMXProperties& info);
+        
+        bool loadCache(const char *absolutePath, uint32_t sourceHash, fzUInt sourceLength);
+        void saveCache(const char *absolutePath, uint32_t sourceHash, fzUInt sourceLength) const;
 
         fzUInt m_factor;
         fzTMXOrientation m_orientation;
@@ -232,6 +302,9 @@ namespace FORZE {
         explicit TMXMapInfo();
         explicit TMXMapInfo(const char* filename);
         
+        //! Parses the TMX file.
+        //! If FZ_TMX_CACHE is enabled, the parsed map is saved in the persistent path and
+        //! loaded from there while the TMX file does not change.
         void parseTMXFile(const char*);
         void parseTMXData(char*);
         
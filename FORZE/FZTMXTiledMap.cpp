@@ -40,7 +40,7 @@ using namespace STD;
 
 namespace FORZE {
     
-    TMXTiledMap::TMXTiledMap(const char *tmxfilename)
+    TMXTiledMap::TMXTiledMap(const char *tmxfilename, bool streaming)
     : SpriteBatch(NULL, 0)
     , m_mapInfo()
     {
@@ -67,7 +67,7 @@ namespace FORZE {
         for(; it != m_mapInfo.m_layers.end(); ++it)
         {
             TMXLayerInfo *info = (TMXLayerInfo*) &(*it);
-            TMXLayer *layer = new TMXLayer(this, info);
+            TMXLayer *layer = new TMXLayer(this, info, streaming);
             addChild(layer);
             
             maxWidth = fzMax(maxWidth, layer->getContentSize().width);
@@ -86,14 +86,21 @@ namespace FORZE {
     
     void TMXTiledMap::render(unsigned char dirtyFlags)
     {        
-        // RESERVE MEMORY
+        // CULLING
+        // Only the chunks of tiles inside the screen are written into the atlas.
         TMXLayer *layer;
         fzUInt totalSize = 0;
         FZ_LIST_FOREACH(m_children, layer) {
-            totalSize += layer->getChildren().size();
+            layer->makeDirty(dirtyFlags);
+            totalSize += layer->cullTMXLayer();
         }
         
+        // RESERVE MEMORY
+        // the atlas does not keep its quads when it grows
+        const fzUInt capacity = m_textureAtlas.getCapacity();
         m_textureAtlas.reserveCapacity(totalSize);
+        if(capacity != m_textureAtlas.getCapacity())
+            dirtyFlags |= kFZDirty_transform_absolute;
         
         // RENDERING
         fzV4_T2_C4_Quad *quad = m_textureAtlas.getQuads();
@@ -55,7 +55,9 @@ namespace FORZE {
     public:
         //! Constructs a TMXTiledMap node from the TMX file.
         //! This constructor initializes an instance of the TMXParser.
-        explicit TMXTiledMap(const char *tmxfilename);
+        //! If streaming is true, the layers only build the tiles around the screen as it moves,
+        //! use it for very big maps. See TMXLayer::isStreaming().
+        explicit TMXTiledMap(const char *tmxfilename, bool streaming = false);
         
         
         TMXTilesetInfo* getTileset() {
@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "FZTexture2D.h"
 #include "FZMacros.h"
@@ -44,6 +45,7 @@
 #include "FZMath.h"
 #include "FZBitOrder.h"
 #include "FZData.h"
+#include "FZImageConverter.h"
 
 // libpng
 #include "external/libpng/png.h"
@@ -165,6 +167,7 @@ namespace FORZE {
 #pragma mark - Texture2D implementation
     
     fzTextureFormat Texture2D::_defaultPixelFormat = kFZTextureFormat_auto;
+    fzDithering Texture2D::_dithering = kFZDithering_Ordered;
     
     void Texture2D::allocTexture()
     {
@@ -176,27 +179,22 @@ namespace FORZE {
     }
     
     
-    unsigned char* Texture2D::expand(fzPixelFormat format, fzUInt fromX, fzUInt fromY, fzUInt toX, fzUInt toY, const void *ptr)
+    bool Texture2D::canUseNPOT()
     {
-        FZ_ASSERT(format >=0 && format < MAX_TEXTURE_FORMATS, "Texture format is not supported.");
-        FZ_ASSERT(_pixelFormat_hash[format].isCompressed == false, "Compressed textures cannot be expanded.");
-        FZ_ASSERT(toX >= fromX && toY >= fromY, "You cannot reduce a texture.");
-        FZ_ASSERT(toX != fromX || toY != fromY, "Not to resize  TO == FROM.");
-        
-        uint8_t bytesPerPixel = _pixelFormat_hash[format].dataBBP >> 3;
-        FZ_ASSERT(bytesPerPixel > 0, "Strange bug: memory corruption?.");
-        fzUInt rowSize = fromX * bytesPerPixel;
-        fzUInt rowPOTSize = toX * bytesPerPixel;
-        
-        const uint8_t *src = static_cast<const uint8_t*>(ptr);
-        uint8_t *dest = new uint8_t[rowPOTSize * toY];
-            
-        if(toY == fromY)
-            memcpy(dest, ptr, rowSize * fromY);
-        else for(fzUInt i = 0; i < fromY; ++i)
-            memcpy(&dest[rowPOTSize * i], &src[rowSize * i], rowSize);
-        
-        return dest;
+#if FZ_TEXTURE_NPOT_SUPPORT
+        return DeviceConfig::Instance().isNPOTSupported();
+#else
+        return false;
+#endif
+    }
+    
+    
+    static void setUnpackAlignment(GLsizei width, uint8_t bitsPerPixel)
+    {
+        // rows are tightly packed, the default alignment (4) breaks odd widths.
+        GLsizei rowSize = (width * bitsPerPixel) / 8;
+        GLint alignment = (rowSize % 4 == 0) ? 4 : ((rowSize % 2 == 0) ? 2 : 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
     }
     
     
@@ -217,6 +215,9 @@ namespace FORZE {
 
         if(!dataInfo.isCompressed)
         {
+            if(ptr)
+                setUnpackAlignment(width, dataInfo.dataBBP);
+            
             glTexImage2D(GL_TEXTURE_2D, level,
                          textureInfo.openGLFormat,
                          width, height, 0,
@@ -237,11 +238,76 @@ namespace FORZE {
         }
         
         CHECK_GL_ERROR_DEBUG();
+        
+        // VIDEO MEMORY ACCOUNTING (POT padding and mipmaps included)
+        if(level == 0)
+            m_memory = 0;
+        
+        if(dataInfo.isCompressed)
+            m_memory += packetSize;
+        else
+            m_memory += (width * height * textureInfo.dataBBP) / 8;
+    }
+    
+    
+    void Texture2D::uploadImage(fzPixelFormat format, GLsizei width, GLsizei height, const void *ptr)
+    {
+        GLsizei widthPOT = fzMath_nextPOT(width);
+        GLsizei heightPOT = fzMath_nextPOT(height);
+        
+        if(canUseNPOT() || (width == widthPOT && height == heightPOT)) {
+            upload(format, 0, width, height, 0, ptr);
+            m_width = width;
+            m_height = height;
+            return;
+        }
+        
+        // POT storage is allocated empty and the image is copied into its corner,
+        // the padding never exists in RAM.
+        upload(format, 0, widthPOT, heightPOT, 0, NULL);
+        if(ptr) {
+            fzPixelInfo dataInfo = _pixelFormat_hash[format];
+            setUnpackAlignment(width, dataInfo.dataBBP);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                            dataInfo.dataFormat,
+                            dataInfo.dataType,
+                            ptr);
+            CHECK_GL_ERROR_DEBUG();
+        }
+        m_width = widthPOT;
+        m_height = heightPOT;
+    }
+    
+    
+    void Texture2D::update(const void* ptr, fzPixelFormat format, GLsizei width, GLsizei height, const fzSize& size)
+    {
+        m_size = size;
+        uploadImage(format, width, height, ptr);
+    }
+    
+    
+    void Texture2D::updateRegion(const void* ptr, fzPixelFormat format, GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        FZ_ASSERT(ptr != NULL, "Pointer can not be NULL.");
+        FZ_ASSERT(m_textureID != 0, "The texture must be uploaded before.");
+        FZ_ASSERT(x >= 0 && y >= 0 && x + width <= m_width && y + height <= m_height, "Region is out of bounds.");
+        
+        fzPixelInfo dataInfo = _pixelFormat_hash[format];
+        FZ_ASSERT(!dataInfo.isCompressed, "Compressed textures can not be updated.");
+        
+        bind();
+        setUnpackAlignment(width, dataInfo.dataBBP);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height,
+                        dataInfo.dataFormat,
+                        dataInfo.dataType,
+                        ptr);
+        CHECK_GL_ERROR_DEBUG();
     }
     
     
     Texture2D::Texture2D()
     : m_textureID(0)
+    , m_memory(0)
     , m_factor(1)
     , m_texParams()
     , m_format(kFZTextureFormat_invalid)
@@ -252,46 +318,30 @@ namespace FORZE {
     : Texture2D()
     {
         m_size = size;
-        m_width = width;
-        m_height = height;
         
-        if(!DeviceConfig::Instance().isNPOTSupported()) {
-            if(!fzMath_isPOT(width) || !fzMath_isPOT(height)) {
-                FZ_RAISE("Texture2D: NPOT textures are not supported.");
-            }
-        }
-
         setPixelFormat(pixelFormat, textureFormat);
-        upload(pixelFormat, 0, width, height, 0, ptr);
+        uploadImage(pixelFormat, width, height, ptr);
     }
     
     
     Texture2D::Texture2D(fzTextureFormat format, const fzSize& size)
-    : Texture2D(NULL, kFZPixelFormat_RGBA8888, format, fzMath_nextPOT(size.width), fzMath_nextPOT(size.height), size)
+    : Texture2D(NULL, kFZPixelFormat_RGBA8888, format, ceilf(size.width), ceilf(size.height), size)
     { }
     
     
     Texture2D::Texture2D(const char* filename)
     : Texture2D()
     {
-        FZ_ASSERT(filename != NULL, "Filename cannot be empty.");
-        
-        const char *extension = IO::getExtension(filename);
-        if(extension == NULL)
-            FZ_RAISE_STOP("Texture2D: File extension is missing.");
-
-        
-        if(strcasecmp( extension, "png") == 0 )
-            loadPNGFile(filename);
-        
-        else if(strcasecmp( extension, "pvr") == 0 )
-            loadPVRFile(filename);
-        
-        else if(strcasecmp( extension, "pvr.ccz") == 0 )
-            loadPVRCCZFile(filename);
-        
-        else
-            FZ_RAISE_STOP("Texture2D: Invalid file extension.");
+        fzTextureSource source;
+        decode(filename, source);
+        load(source);
+    }
+    
+    
+    Texture2D::Texture2D(fzTextureSource& source)
+    : Texture2D()
+    {
+        load(source);
     }
     
     
@@ -337,43 +387,47 @@ namespace FORZE {
     }
     
     
-    void Texture2D::loadPNGFile(const char *filename)
+    struct fzPNGReader
+    {
+        const png_byte *data;
+        png_size_t remaining;
+    };
+    
+    
+    static void readPNGData(png_structp png_ptr, png_bytep output, png_size_t length)
+    {
+        fzPNGReader *reader = (fzPNGReader*)png_get_io_ptr(png_ptr);
+        if(length > reader->remaining)
+            png_error(png_ptr, "Unexpected end of file.");
+        
+        memcpy(output, reader->data, length);
+        reader->data += length;
+        reader->remaining -= length;
+    }
+    
+    
+    void Texture2D::decodePNGFile(const char *filename, fzTextureSource& source)
     {
         // LOAD CORRECT TEXTURE FILE
-        FILE *file = NULL;
-        {
-            char absolutePath[512];
-            fzUInt step = 0, factor = 0;
-            while (true) {
-                
-                ResourcesManager::Instance().getPath(filename, step, absolutePath, &factor);
-                if(factor == 0) {
-                    char *message = FZT("Texture2D:PNG:IO: \"%s\" not found.", filename);
-                    FZ_RAISE(message);
-                }
-                
-                file = fopen(absolutePath, "rb");
-                if(file) {
-                    m_factor = factor;
-                    break;
-                }
-                ++step;
-            }
+        // the file is mapped, archived PNGs are decoded without any copy.
+        fzUInt factor = 0;
+        fzBuffer file = ResourcesManager::Instance().mapResource(filename, &factor);
+        if(file.isEmpty()) {
+            char *message = FZT("Texture2D:PNG:IO: \"%s\" not found.", filename);
+            FZ_RAISE(message);
         }
         
         
         // check png sign
-        png_byte header[8];
-        fread(header, 1, 8, file);
-        if (::png_sig_cmp(header, 0, 8)) {
-            fclose(file);
+        if (file.getLength() < 8 || ::png_sig_cmp((png_bytep)file.getPointer(), 0, 8)) {
+            file.free();
             FZ_RAISE_STOP("Texture2D:PNG: Invalid PNG sign.");
         }
         
         // initialize stuff
         png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
         if(!png_ptr) {
-            fclose(file);
+            file.free();
             FZ_RAISE_STOP("Texture2D:PNG: \"png_create_read_struct\" failed, memory issue.");
         }
 
@@ -381,19 +435,20 @@ namespace FORZE {
         png_infop info_ptr = png_create_info_struct(png_ptr);
         if(!info_ptr) {
             png_destroy_read_struct(&png_ptr, NULL, NULL);
-            fclose(file);
+            file.free();
             FZ_RAISE_STOP("Texture2D:PNG: \"png_create_info_struct\" failed, memory issue.");
         }
         
         
         if (setjmp(png_jmpbuf(png_ptr))) {
             png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-            fclose(file);
+            file.free();
             FZ_RAISE_STOP("Texture2D:PNG: libpng exception.");
         }
         
         // init libpng io
-        png_init_io(png_ptr, file);
+        fzPNGReader reader = { (const png_byte*)file.getPointer() + 8, file.getLength() - 8 };
+        png_set_read_fn(png_ptr, &reader, readPNGData);
         png_set_sig_bytes(png_ptr, 8);
         
         // get image info
@@ -431,97 +486,83 @@ namespace FORZE {
                 
             default:
                 png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-                fclose(file);
+                file.free();
                 FZ_RAISE_STOP("Texture2D:PNG: Invalid internal format.");
         }
         
-        uint32_t width = fzMath_nextPOT(sizeWidth);
-        uint32_t height = fzMath_nextPOT(sizeHeight);
+        // tightly packed, POT padding (if needed) is done by the GPU at upload time.
         uint8_t bytes = _pixelFormat_hash[pixelFormat].dataBBP / 8;
         
         // get raw pixels
-        fzUInt texLength = width * height * bytes;
-        fzUInt structLength = sizeHeight * sizeof(png_bytep**);
+        fzUInt texLength = sizeWidth * sizeHeight * bytes;
+        fzUInt structLength = sizeHeight * sizeof(png_bytep);
+        
+        // the row pointers follow the pixels, aligned even if the rows are not (NPOT RGB888 or LA88).
+        fzUInt structOffset = (texLength + sizeof(png_bytep) - 1) & ~(fzUInt)(sizeof(png_bytep) - 1);
         
         
         /* read file */
         if (setjmp(png_jmpbuf(png_ptr))) {
             png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-            fclose(file);
+            file.free();
             FZ_RAISE_STOP("Texture2D:PNG: libpng exception.");
         }
         
-              png_byte *buffer;
+        char *buffer;
         try {
             
-            buffer = new png_byte[texLength + structLength];
+            buffer = new char[structOffset + structLength];
             
         } catch(std::bad_alloc& error) {
             png_destroy_read_struct(&png_ptr, &info_ptr, (png_info**)NULL);
-            fclose(file);
+            file.free();
             throw;
         }
 
-        png_byte *pixels = buffer;
-        png_byte** row_ptrs = (png_byte**) (pixels + texLength);
+        png_byte *pixels = reinterpret_cast<png_byte*>(buffer);
+        png_byte** row_ptrs = (png_byte**) (pixels + structOffset);
         
         for (fzUInt i = 0; i < sizeHeight; ++i)
-            row_ptrs[i] = pixels + (i * width * bytes);
+            row_ptrs[i] = pixels + (i * sizeWidth * bytes);
         
 
         png_read_image(png_ptr, row_ptrs);
         png_read_end(png_ptr, NULL);
         png_destroy_read_struct(&png_ptr, &info_ptr, (png_info**)NULL);
 
-        fclose(file);
+        file.free();
 
         
-        // UPLOADING TEXTURE DATA TO GPU
-        setPixelFormat(pixelFormat, getDefaultTextureFormat());
-        
-        try {
-            upload(pixelFormat,
-                   0,
-                   width,
-                   height,
-                   0,
-                   pixels
-                   );
-            delete [] buffer;
-            
-        } catch(...) {
-            delete [] buffer;
-            throw;
-        }
-        
-        m_width = width;
-        m_height = height;
-        m_size = fzSize(sizeWidth, sizeHeight);        
+        // the row pointers stay at the end of the buffer, they are freed with the pixels.
+        source.data = fzBuffer(buffer, texLength);
+        source.format = pixelFormat;
+        source.width = sizeWidth;
+        source.height = sizeHeight;
+        source.size = fzSize(sizeWidth, sizeHeight);
+        source.factor = factor;
+        source.isPVR = false;
     }
     
     
-    void Texture2D::loadPVRFile(const char *filename)
+    void Texture2D::decodePVRFile(const char *filename, fzTextureSource& source)
     {
         fzUInt factor;
-        fzBuffer buffer = ResourcesManager::Instance().loadResource(filename, &factor);
-        m_factor = factor;
+        fzBuffer buffer = ResourcesManager::Instance().mapResource(filename, &factor);
         
-        // Unpack PVR Data
-        try {
-            loadPVRData(buffer.getPointer());
-            buffer.free();
-
-        } catch(std::exception &error) {
-            buffer.free();
-            throw;
-        }
+        if(buffer.isEmpty())
+            FZ_RAISE("Texture2D:IO: Error reading file.");
+        
+        // PVR data is uploaded as it is, the header is parsed by loadPVRData().
+        source.data = buffer;
+        source.factor = factor;
+        source.isPVR = true;
     }
     
     
-    void Texture2D::loadPVRCCZFile(const char *filename)
+    void Texture2D::decodePVRCCZFile(const char *filename, fzTextureSource& source)
     {
         fzUInt factor;
-        fzBuffer buffer = ResourcesManager::Instance().loadResource(filename, &factor);
+        fzBuffer buffer = ResourcesManager::Instance().mapResource(filename, &factor);
         
         if(buffer.isEmpty())
             FZ_RAISE("Texture2D:IO: Error reading file.");
@@ -532,16 +573,74 @@ namespace FORZE {
         if(buffer2.isEmpty())
             FZ_RAISE_STOP("Texture2D:IO: Error descompressing data.");
         
-        m_factor = factor;
+        source.data = buffer2;
+        source.factor = factor;
+        source.isPVR = true;
+    }
+    
+    
+    void Texture2D::reduceSource(fzTextureSource& source)
+    {
+        uint8_t *pixels = reinterpret_cast<uint8_t*>(source.data.getPointer());
+        fzUInt count = source.width * source.height;
+        
+        fzImageInfo info = ImageConverter::analyze(pixels, source.format, count);
+        fzPixelFormat format = ImageConverter::chooseFormat(source.format, info, getDefaultTextureFormat());
+        if(format == source.format)
+            return;
+        
+        // in place, the buffer keeps its allocation and only its length changes.
+        fzUInt length = ImageConverter::convert(pixels, source.format, format, source.width, source.height, getDithering());
+        source.data = fzBuffer(source.data.getPointer(), length);
+        source.format = format;
+    }
+    
+    
+    void Texture2D::decode(const char *filename, fzTextureSource& source)
+    {
+        FZ_ASSERT(filename != NULL, "Filename cannot be empty.");
+        
+        const char *extension = IO::getExtension(filename);
+        if(extension == NULL)
+            FZ_RAISE_STOP("Texture2D: File extension is missing.");
         
         
-        // Unpack PVR Data
+        if(strcasecmp( extension, "png") == 0 ) {
+            decodePNGFile(filename, source);
+            reduceSource(source);
+        }
+        
+        else if(strcasecmp( extension, "pvr") == 0 )
+            decodePVRFile(filename, source);
+        
+        else if(strcasecmp( extension, "pvr.ccz") == 0 )
+            decodePVRCCZFile(filename, source);
+        
+        else
+            FZ_RAISE_STOP("Texture2D: Invalid file extension.");
+    }
+    
+    
+    void Texture2D::load(fzTextureSource& source)
+    {
+        FZ_ASSERT(!source.data.isEmpty(), "Texture source was not decoded.");
+
+        m_factor = source.factor;
+        
+        // UPLOADING TEXTURE DATA TO GPU
         try {
-            loadPVRData(buffer2.getPointer());
-            buffer2.free();
+            if(source.isPVR)
+                loadPVRData(source.data.getPointer());
+            
+            else {
+                setPixelFormat(source.format, getDefaultTextureFormat());
+                uploadImage(source.format, source.width, source.height, source.data.getPointer());
+                m_size = source.size;
+            }
+            source.data.free();
             
         } catch(...) {
-            buffer2.free();
+            source.data.free();
             throw;
         }
     }
@@ -609,24 +708,8 @@ namespace FORZE {
             if(_pixelFormat_hash[pixelFormat].isCompressed != false)
                 FZ_RAISE_STOP("Texture2D:PVR: Compressed textures cannot be NPOT.");
 
-            if(DeviceConfig::Instance().isNPOTSupported()) {
-                upload(pixelFormat, 0, width, height, 0, textureData);
-                m_width  = width;
-                m_height = height;
-            
-            }else{
-                // If NPOT is not supported, the texture will be expanded.
-                unsigned char *expanded = expand(pixelFormat, width, height, widthPOT, heightPOT, textureData);
-                try {
-                    upload(pixelFormat, 0, widthPOT, heightPOT, 0, expanded);
-                } catch(...) {
-                    delete [] expanded;
-                    throw;
-                }
-                m_width  = widthPOT;
-                m_height = heightPOT;
-                delete [] expanded;
-            }
+            // If NPOT is not supported, the texture will be padded by the GPU.
+            uploadImage(pixelFormat, width, height, textureData);
             
         }else{
             m_width  = widthPOT;
@@ -733,8 +816,12 @@ namespace FORZE {
     
     void Texture2D::generateMipmap() const
     {
+        FZ_ASSERT(fzMath_isPOT(m_width) && fzMath_isPOT(m_height), "Mipmaps can not be generated for NPOT textures.");
         bind();
         fzGLGenerateMipmap(GL_TEXTURE_2D);
+        
+        // the mipmap chain takes one third more.
+        m_memory += m_memory / 3;
     }
     
     
@@ -784,8 +871,9 @@ namespace FORZE {
               " - Width: %d\n"
               " - Height: %d\n"
               " - ContentSize: {%.2f, %.2f}\n"
-              " - Factor: %f\n", this, m_textureID, m_width, m_height,
-              m_size.width, m_size.height, m_factor);
+              " - Factor: %f\n"
+              " - Memory: %d bytes\n", this, m_textureID, m_width, m_height,
+              m_size.width, m_size.height, m_factor, m_memory);
     }
     
     
@@ -803,6 +891,18 @@ namespace FORZE {
     }
     
     
+    void Texture2D::setDithering(fzDithering dithering)
+    {
+        _dithering = dithering;
+    }
+    
+    
+    fzDithering Texture2D::getDithering()
+    {
+        return _dithering;
+    }
+    
+    
     fzTextureFormat Texture2D::screenTextureFormat()
     {
         switch (Director::Instance().getGLConfig().colorFormat) {
@@ -33,6 +33,7 @@
 
 #include "FZOSW.h"
 #include "FZLifeCycle.h"
+#include "FZAllocator.h"
 
 
 namespace FORZE {
@@ -80,6 +81,22 @@ namespace FORZE {
     };
     
     
+    /** @typedef fzDithering
+     Dithering applied when an image is reduced to a 16 bits format.
+     */
+    enum fzDithering
+    {
+        //! Plain truncation, the fastest.
+        kFZDithering_None,
+        
+        //! 4x4 Bayer matrix, cheap and stable.
+        kFZDithering_Ordered,
+        
+        //! Floyd-Steinberg, the best looking for gradients.
+        kFZDithering_ErrorDiffusion
+    };
+    
+    
     struct fzPixelInfo
     {
         fzTextureFormat textureFormat;
@@ -98,11 +115,32 @@ namespace FORZE {
     };
     
     
+    /** fzTextureSource
+     Image decoded in RAM and ready to be uploaded to the GPU.
+     It is filled by Texture2D::decode(), that does not call OpenGL, so it can run in a worker thread.
+     */
+    struct fzTextureSource
+    {
+        //! PNG: tightly packed pixels. PVR: the whole (inflated) file.
+        fzBuffer data;
+        fzPixelFormat format;
+        GLsizei width, height;
+        fzSize size;
+        fzUInt factor;
+        bool isPVR;
+        
+        fzTextureSource()
+        : data(fzBuffer::empty()), format(kFZPixelFormat_RGBA8888)
+        , width(0), height(0), size(), factor(1), isPVR(false)
+        { }
+    };
+    
+    
     //CLASS INTERFACES:
     
     /** Texture2D class.
      * This class allows to easily create OpenGL 2D textures from images, text or raw data.
-     * The created Texture2D object will always have power-of-two dimensions. 
+     * The created Texture2D object will have power-of-two dimensions unless NPOT textures can be used (see canUseNPOT()).
      * Depending on how you create the Texture2D object, the actual image area of the texture might be smaller than the texture dimensions i.e. "contentSize" != (pixelsWide, pixelsHigh) and (maxS, maxT) != (1.0, 1.0).
      * Be aware that the content of the generated textures will be upside-down!
      */
@@ -110,6 +148,7 @@ namespace FORZE {
     {
     private:
         static fzTextureFormat _defaultPixelFormat;
+        static fzDithering _dithering;
         
         void allocTexture();
         
@@ -120,20 +159,34 @@ namespace FORZE {
         fzTextureFormat m_format;
         fzTexParams     m_texParams;
         fzFloat         m_factor;
+        mutable fzUInt  m_memory;
       
-        unsigned char* expand(fzPixelFormat format, fzUInt fromX, fzUInt fromY, fzUInt toX, fzUInt toY, const void *ptr);
         void upload(fzPixelFormat format, GLint level, GLsizei width, GLsizei height, GLsizei packetSize, const void *ptr);
+        void uploadImage(fzPixelFormat format, GLsizei width, GLsizei height, const void *ptr);
         void setPixelFormat(fzPixelFormat pixelFormat, fzTextureFormat textureFormat);
         
-        void loadPNGFile(const char*);
-        void loadPVRFile(const char*);
-        void loadPVRCCZFile(const char*);
+        void load(fzTextureSource& source);
+        
+        static void decodePNGFile(const char*, fzTextureSource&);
+        static void decodePVRFile(const char*, fzTextureSource&);
+        static void decodePVRCCZFile(const char*, fzTextureSource&);
+        static void reduceSource(fzTextureSource&);
         
         
     public:
         
         static const fzTextureInfo& getDefaultTextureConfig(fzTextureFormat format);
         
+        //! Returns true if NPOT textures are enabled (FZ_TEXTURE_NPOT_SUPPORT) and supported by the GPU.
+        //! Otherwise NPOT images are padded to POT by the GPU, their content size stays the same.
+        static bool canUseNPOT();
+        
+        //! Reads and decodes an image (.png, .pvr, .pvr.ccz) without uploading it.
+        //! It is thread-safe, it can be called from a worker thread.
+        //! @throws if the file is not found or it's invalid.
+        static void decode(const char* filename, fzTextureSource& source);
+        
+        
         //! Default constructor
         Texture2D();
 
@@ -149,6 +202,10 @@ namespace FORZE {
         //! Constructs a Texture2D from an image in ROM.
         Texture2D(const char* filename);
         
+        //! Constructs a Texture2D from an image already decoded by decode().
+        //! The source's memory is released.
+        Texture2D(fzTextureSource& source);
+        
         // Destructor
         ~Texture2D();
         
@@ -177,6 +234,13 @@ namespace FORZE {
         }
         
         
+        //! Returns the video memory used by the texture in bytes.
+        //! It includes the POT padding and the mipmaps.
+        fzUInt getMemoryUsage() const {
+            return m_memory;
+        }
+        
+        
         //! Returns the texture Opengl ID.
         GLuint getName() const {
             return m_textureID;
@@ -209,6 +273,16 @@ namespace FORZE {
         }
         
         
+        //! Replaces the texture content (and size), the OpenGL texture name does not change.
+        //! ptr can be NULL, then the content is undefined.
+        void update(const void* ptr, fzPixelFormat format, GLsizei width, GLsizei height, const fzSize& size);
+        
+        
+        //! Updates a region of the texture with tightly packed pixels.
+        //! The pixel format must match the one used to create the texture.
+        void updateRegion(const void* ptr, fzPixelFormat format, GLint x, GLint y, GLsizei width, GLsizei height);
+        
+        
         //! Binds the opengl texture.
         //! @code fzGLBindTexture2D(texture->getName());
         void bind() const;
@@ -236,7 +310,7 @@ namespace FORZE {
         
         
         //! Generates mipmap images for the texture.
-        //! It only works if the texture size is POT (power of 2).
+        //! It only works if the texture size is POT (power of 2), NPOT textures are used when canUseNPOT() is true.
         void generateMipmap() const;
         
         
@@ -247,18 +321,23 @@ namespace FORZE {
         void log() const;
         
         /** Sets the default pixel format for non-PVR images.
-         If the image contains alpha channel, then the options are:
-         - generate 32-bit textures:    kFZTexture2DPixelFormat_RGBA8888 (default)
-         - generate 16-bit textures:    kFZTexture2DPixelFormat_RGBA4444
-         - generate 16-bit textures:    kFZTexture2DPixelFormat_RGB5A1
-         - generate 16-bit textures:    kFZTexture2DPixelFormat_RGB565
-         - generate 16-bit textures:    kFZTexture2DPixelFormat_IA88
-         - generate 8-bit textures:     kFZTexture2DPixelFormat_A8
+         The decoded pixels are analyzed (opaque, 1-bit alpha, grayscale) and converted at load time:
+         - kFZTextureFormat_auto (default): lossless reductions only, L8/LA88 for grayscale, A8 for alpha only images.
+         - kFZTextureFormat_performance: same as auto, and RGB565 if opaque, RGB5A1 if 1-bit alpha, RGBA4444 for the rest.
+         - kFZTextureFormat_quality: the decoded format, no reduction.
+         - any concrete format (kFZTextureFormat_RGBA4444...): all the images are converted to it.
+         @see ImageConverter::chooseFormat()
          */
         static fzTextureFormat getDefaultTextureFormat();
         static void setDefaultTextureFormat(fzTextureFormat);
         
         
+        //! Sets the dithering used when images are reduced to 16 bits formats.
+        //! kFZDithering_Ordered by default.
+        static fzDithering getDithering();
+        static void setDithering(fzDithering);
+        
+        
         static fzTextureFormat screenTextureFormat();
         static fzPixelInfo getPixelInfo(fzPixelFormat format);
         static fzTextureInfo getTextureInfo(fzTextureFormat format);
@@ -28,8 +28,16 @@
  @author Manuel Martínez-Almeida
  */
 
+#include <string.h>
+#include <algorithm>
+
 #include "FZTextureCache.h"
 #include "FZTexture2D.h"
+#include "FZPrefetchManager.h"
+#include "FZSpriteFrameCache.h"
+#include "FZMemoryManager.h"
+#include "FZResourceGroup.h"
+#include "FZScheduler.h"
 #include "FZMacros.h"
 #include "FZIO.h"
 
@@ -37,6 +45,27 @@ using namespace STD;
 
 namespace FORZE {
     
+    // Sorted textures referenced by the sprite frames.
+    static void getSpriteSheets(vector<const Texture2D*>& sheets)
+    {
+        const SpriteFrameCache::framesMap& frames = SpriteFrameCache::Instance().getFrames();
+        SpriteFrameCache::framesMap::const_iterator it(frames.begin());
+        for(; it != frames.end(); ++it)
+            sheets.push_back(it->second.getTexture());
+        
+        sort(sheets.begin(), sheets.end());
+        sheets.erase(unique(sheets.begin(), sheets.end()), sheets.end());
+    }
+    
+    
+    // Only retained by the cache and not referenced by any sprite frame.
+    static bool isUnused(const TextureCache::fzTextureEntry& entry, const vector<const Texture2D*>& sheets)
+    {
+        return (entry.texture->retainCount() <= 1 &&
+                !binary_search(sheets.begin(), sheets.end(), entry.texture));
+    }
+    
+    
     TextureCache* TextureCache::p_instance = NULL;
     
     TextureCache& TextureCache::Instance()
@@ -50,7 +79,12 @@ namespace FORZE {
     
     TextureCache::TextureCache()
     : m_textures()
-    { }
+    , m_memory(0)
+    , m_memoryBudget(0)
+    {
+        memset(m_memoryByFormat, 0, sizeof(m_memoryByFormat));
+        MemoryManager::Instance().addCache(this);
+    }
     
     
     Texture2D* TextureCache::addImage(const char* filename)
@@ -63,16 +97,17 @@ namespace FORZE {
         // Remove "-x" suffix
         IO::removeFileSuffix(filenameCpy);
         
+        PrefetchManager::record(kFZPrefetch_Texture, filenameCpy);
         
         uint32_t hash = fzHash(filenameCpy);
-        Texture2D *tex = getTextureByHash(hash);
+        ResourceGroup::tag(kFZResource_Texture, hash);
+        Texture2D *tex = touchTexture(hash);
         
         if( ! tex ) {
             
             try {
                 tex = new Texture2D(filenameCpy);
-                tex->retain();
-                m_textures.insert(texturesPair(hash, tex));
+                insertTexture(hash, tex);
                 
             } catch(std::exception& error) {
                 delete filenameCpy;
@@ -86,13 +121,82 @@ namespace FORZE {
     }
     
     
+    Texture2D* TextureCache::addDecodedImage(const char* filename, fzTextureSource& source)
+    {
+        FZ_ASSERT(filename != NULL, "filename argument must be non-NULL.");
+        
+        char *filenameCpy = fzStrcpy(filename);
+        IO::removeFileSuffix(filenameCpy);
+        
+        uint32_t hash = fzHash(filenameCpy);
+        delete filenameCpy;
+        ResourceGroup::tag(kFZResource_Texture, hash);
+
+        Texture2D *tex = touchTexture(hash);
+        if( tex ) {
+            source.data.free();
+            return tex;
+        }
+        
+        try {
+            tex = new Texture2D(source);
+            insertTexture(hash, tex);
+            
+        } catch(std::exception& error) {
+            FZLOGERROR("%s", error.what());
+            return NULL;
+        }
+        return tex;
+    }
+    
+    
     Texture2D* TextureCache::getTextureByHash(uint32_t hash) const
     {
         texturesMap::const_iterator it(m_textures.find(hash));
         if(it == m_textures.end())
             return NULL;
         
-        return it->second;   
+        return it->second.texture;
+    }
+    
+    
+    Texture2D* TextureCache::touchTexture(uint32_t hash)
+    {
+        texturesMap::iterator it(m_textures.find(hash));
+        if(it == m_textures.end())
+            return NULL;
+        
+        it->second.lastUse = Scheduler::Instance().getFrame();
+        return it->second.texture;
+    }
+    
+    
+    void TextureCache::insertTexture(uint32_t hash, Texture2D *tex)
+    {
+        tex->retain();
+        
+        fzTextureEntry entry = {tex, tex->getMemoryUsage(), Scheduler::Instance().getFrame()};
+        m_textures.insert(texturesPair(hash, entry));
+        
+        m_memory += entry.memory;
+        m_memoryByFormat[tex->getTextureFormat()] += entry.memory;
+        
+        // the new texture is not retained by anyone yet, it is protected by its lastUse.
+        if(m_memoryBudget > 0 && m_memory > m_memoryBudget)
+            evictTextures(m_memoryBudget, entry.lastUse);
+    }
+    
+    
+    void TextureCache::eraseTexture(texturesMap::iterator it)
+    {
+        fzTextureEntry& entry = it->second;
+        m_memory -= entry.memory;
+        m_memoryByFormat[entry.texture->getTextureFormat()] -= entry.memory;
+        
+        // frames do not retain their texture, they would be left dangling.
+        SpriteFrameCache::Instance().removeSpriteFramesFromTexture(entry.texture);
+        entry.texture->release();
+        m_textures.erase(it);
     }
     
     
@@ -107,9 +211,8 @@ namespace FORZE {
     {
         texturesMap::iterator it(m_textures.begin());
         for(; it != m_textures.end(); ++it) {
-            if(it->second == tex) {
-                tex->release();
-                m_textures.erase(it);
+            if(it->second.texture == tex) {
+                eraseTexture(it);
                 break;
             }
         }
@@ -119,25 +222,29 @@ namespace FORZE {
     void TextureCache::removeTextureByName(const char* filename)
     {
         FZ_ASSERT(filename, "Filename can not be NULL.");
-
-        uint32_t hash = fzHash(filename);
-        Texture2D *tex = getTextureByHash(hash);
-        if(tex) {
-            m_textures.erase(hash);
-            tex->release();
-        }
+        removeTextureByHash(fzHash(filename));
+    }
+    
+    
+    void TextureCache::removeTextureByHash(uint32_t hash)
+    {
+        texturesMap::iterator it(m_textures.find(hash));
+        if(it != m_textures.end())
+            eraseTexture(it);
     }
     
     
     void TextureCache::removeUnusedTextures()
     {
+        vector<const Texture2D*> sheets;
+        getSpriteSheets(sheets);
+        
         texturesMap::iterator it(m_textures.begin());
         for(; it != m_textures.end(); )
         {
-            if(it->second->retainCount() <= 1) {
-                it->second->release();
-                m_textures.erase(it++);
-            }else
+            if(isUnused(it->second, sheets))
+                eraseTexture(it++);
+            else
                 ++it;
         }
     }
@@ -147,8 +254,114 @@ namespace FORZE {
     {
         texturesMap::const_iterator it(m_textures.begin());
         for(; it != m_textures.end(); ++it)
-            it->second->release();
+            it->second.texture->release();
         
         m_textures.clear();
+        m_memory = 0;
+        memset(m_memoryByFormat, 0, sizeof(m_memoryByFormat));
+    }
+    
+    
+    fzUInt TextureCache::evictTextures(fzUInt maxMemory)
+    {
+        return evictTextures(maxMemory, (fzUInt)-1);
+    }
+    
+    
+    fzUInt TextureCache::evictTextures(fzUInt maxMemory, fzUInt frame)
+    {
+        if(m_memory <= maxMemory)
+            return 0;
+        
+        vector<const Texture2D*> sheets;
+        getSpriteSheets(sheets);
+        
+        fzUInt released = 0;
+        while(m_memory > maxMemory)
+        {
+            // least recently requested unused texture
+            texturesMap::iterator victim(m_textures.end());
+            texturesMap::iterator it(m_textures.begin());
+            for(; it != m_textures.end(); ++it) {
+                if(isUnused(it->second, sheets) && it->second.lastUse < frame &&
+                   (victim == m_textures.end() || it->second.lastUse < victim->second.lastUse))
+                    victim = it;
+            }
+            if(victim == m_textures.end())
+                break;
+            
+            released += victim->second.memory;
+            eraseTexture(victim);
+        }
+        return released;
+    }
+    
+    
+    void TextureCache::evictColdTextures(fzUInt frames)
+    {
+        fzUInt frame = Scheduler::Instance().getFrame();
+        
+        vector<const Texture2D*> sheets;
+        getSpriteSheets(sheets);
+        
+        texturesMap::iterator it(m_textures.begin());
+        for(; it != m_textures.end(); )
+        {
+            if(isUnused(it->second, sheets) && it->second.lastUse + frames < frame)
+                eraseTexture(it++);
+            else
+                ++it;
+        }
+    }
+    
+    
+    void TextureCache::setMemoryBudget(fzUInt bytes)
+    {
+        m_memoryBudget = bytes;
+        if(m_memoryBudget > 0 && m_memory > m_memoryBudget)
+            evictTextures(m_memoryBudget, Scheduler::Instance().getFrame());
+    }
+    
+    
+    fzUInt TextureCache::getMemoryUsage(fzTextureFormat format) const
+    {
+        FZ_ASSERT(format >= 0 && format <= kFZTextureFormat_PVRTC2, "Invalid texture format.");
+        return m_memoryByFormat[format];
+    }
+    
+    
+    void TextureCache::logMemoryUsage() const
+    {
+        static const char *formatNames[] = {
+            "RGBA8888", "BGRA8888", "RGB888", "RGBA4444", "RGB5A1",
+            "RGB565", "LA88", "A8", "L8", "PVRTC4", "PVRTC2"
+        };
+        
+        FZLog("TextureCache: %d textures, %d KB (budget: %d KB)", (int)m_textures.size(), m_memory / 1024, m_memoryBudget / 1024);
+        for(fzUInt i = 0; i <= kFZTextureFormat_PVRTC2; ++i) {
+            if(m_memoryByFormat[i] > 0)
+                FZLog(" - %s: %d KB", formatNames[i], m_memoryByFormat[i] / 1024);
+        }
+    }
+    
+    
+    const char* TextureCache::getMemoryName() const
+    {
+        return "TextureCache";
+    }
+    
+    
+    void TextureCache::releaseMemory(fzMemoryTier tier)
+    {
+        switch (tier) {
+            case kFZMemoryTier_Cold:
+                evictColdTextures(MemoryManager::Instance().getColdFrames());
+                break;
+            case kFZMemoryTier_Unused:
+                removeUnusedTextures();
+                break;
+            default:
+                break;
+        }
     }
 }
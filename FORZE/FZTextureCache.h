@@ -33,6 +33,8 @@
 
 #include "FZConfig.h"
 #include "FZSelectors.h"
+#include "FZTexture2D.h"
+#include "FZProtocols.h"
 #if FZ_STL_CPLUSPLUS11
 #include STL_UNORDERED_MAP
 #else
@@ -44,28 +46,50 @@ using namespace STD;
 
 namespace FORZE {
     
-    class Texture2D;
-    
     //! Singleton that handles the loading of textures.
     //! Once the texture is loaded, the next time it will return
-    //! a reference of the previously loaded texture reducing GPU & CPU memory
-    class TextureCache : public SELProtocol
+    //! a reference of the previously loaded texture reducing GPU & CPU memory.
+    //! The video memory used by the cached textures is accounted, per texture and per format.
+    //! If a memory budget is set, the least recently requested textures that nobody else retains
+    //! are evicted when the budget is exceeded; addImage() reloads them transparently.
+    //! Sprite frames do not retain their texture and they can not be reloaded, so the textures referenced
+    //! by the SpriteFrameCache are never evicted nor removed as unused. Remove the frames first
+    //! (SpriteFrameCache::removeSpriteFramesFromFile()) to release a sprite sheet.
+    //! The sprite frames of an explicitly removed texture are removed from the SpriteFrameCache as well.
+    class TextureCache : public SELProtocol, public Protocol::Memory
     {
+    public:
+        struct fzTextureEntry {
+            Texture2D *texture;
+            fzUInt memory;
+            fzUInt lastUse;
+        };
+        
     private:
         // Simplified typedefs
 #if FZ_STL_CPLUSPLUS11
-        typedef unordered_map<uint32_t, Texture2D*> texturesMap;
+        typedef unordered_map<uint32_t, fzTextureEntry> texturesMap;
 #else
-        typedef map<uint32_t, Texture2D*> texturesMap;
+        typedef map<uint32_t, fzTextureEntry> texturesMap;
 #endif
-        typedef pair<uint32_t, Texture2D*> texturesPair;
-        
+        typedef pair<uint32_t, fzTextureEntry> texturesPair;
         
         // singleton instance
         static TextureCache* p_instance;
-        texturesMap m_textures;
         
+        texturesMap m_textures;
+        fzUInt m_memory;
+        fzUInt m_memoryByFormat[kFZTextureFormat_PVRTC2 + 1];
+        fzUInt m_memoryBudget;
+
         Texture2D* getTextureByHash(uint32_t hash) const;
+        Texture2D* touchTexture(uint32_t hash);
+        void insertTexture(uint32_t hash, Texture2D *texture);
+        void eraseTexture(texturesMap::iterator it);
+        
+        // Only the textures requested before the given frame are evicted.
+        fzUInt evictTextures(fzUInt maxMemory, fzUInt frame);
+        
         
     protected:
         // Constructors
@@ -86,6 +110,11 @@ namespace FORZE {
         //! Supported image extensions: .png, .pvr, .pvr.ccz
         Texture2D* addImage(const char* filename);
         
+        //! Same as addImage() but the image was already decoded with Texture2D::decode(),
+        //! usually in a worker thread. Only the upload is done here.
+        //! The source's memory is released even if the texture was already in the cache.
+        Texture2D* addDecodedImage(const char* filename, fzTextureSource& source);
+        
         
         //! Deletes a Texture2D from the cache given the Texture2D pointer.
         void removeTexture(Texture2D *texture);
@@ -96,10 +125,14 @@ namespace FORZE {
         void removeTextureByName(const char* key);
         
         
+        //! Deletes a Texture2D from the cache given the hash of its key name.
+        void removeTextureByHash(uint32_t hash);
+        
+        
         Texture2D* getTextureByName(const char* key) const;
         
         
-        //! Removes unused textures.
+        //! Removes unused textures, the ones only retained by the cache and not referenced by sprite frames.
         //! This method will be called if the system througs a memory warning.
         void removeUnusedTextures();
         
@@ -108,6 +141,49 @@ namespace FORZE {
         void removeAllTextures();
         
         
+        //! Evicts the least recently requested textures that are only retained by the cache,
+        //! and not referenced by sprite frames, until the used video memory is lower or equal than the given number of bytes.
+        //! @return the number of bytes released.
+        //! @warning the textures returned by addImage() that were not retained yet can be released,
+        //! even the ones requested in the current frame. The budget never evicts those.
+        fzUInt evictTextures(fzUInt maxMemory);
+        
+        
+        //! Sets the video memory budget in bytes. 0 means unlimited (default).
+        //! When a new texture exceeds the budget, the textures only retained by the cache that were
+        //! not requested in the current frame are evicted, the budget can be exceeded until the next frame.
+        void setMemoryBudget(fzUInt bytes);
+        
+        
+        //! @see setMemoryBudget()
+        fzUInt getMemoryBudget() const {
+            return m_memoryBudget;
+        }
+        
+        
+        //! Evicts the textures only retained by the cache that were not requested in the last frames.
+        void evictColdTextures(fzUInt frames);
+        
+        
+        //! Returns the video memory (bytes) used by the cached textures.
+        fzUInt getMemoryUsage() const override {
+            return m_memory;
+        }
+        
+        
+        //! Returns the video memory (bytes) used by the cached textures of the given format.
+        fzUInt getMemoryUsage(fzTextureFormat format) const;
+        
+        
+        //! Logs the memory used by each format.
+        void logMemoryUsage() const;
+        
+        
+        // Protocol::Memory
+        const char* getMemoryName() const override;
+        void releaseMemory(fzMemoryTier tier) override;
+        
+        
         const texturesMap& getTextures() const {
             return m_textures;
         }
@@ -66,6 +66,11 @@ namespace FORZE {
         // Destructor
         ~Transition();
         
+        //! Returns the scene that is being presented.
+        Scene* getInScene() const {
+            return p_inScene;
+        }
+        
         virtual void cleanup() override;
         virtual void onEnter() override;
         virtual void onExit() override;
@@ -0,0 +1,753 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "FZTrueType.h"
+#include "FZMacros.h"
+#include "FZMath.h"
+
+
+using namespace STD;
+
+namespace FORZE {
+    
+#pragma mark - Big endian readers
+    
+    // TrueType data is big endian and it is not aligned.
+    static inline uint16_t readU16(const uint8_t *p) {
+        return (uint16_t)((p[0] << 8) | p[1]);
+    }
+    
+    static inline int16_t readS16(const uint8_t *p) {
+        return (int16_t)readU16(p);
+    }
+    
+    static inline uint32_t readU32(const uint8_t *p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+    
+    
+#pragma mark - Rasterizer
+    
+    // Signed area accumulation rasterizer: every line adds its coverage to the cells it crosses,
+    // the accumulated sum along each row is the coverage of the pixel (non-zero winding).
+    class fzCoverageBuffer
+    {
+        vector<fzFloat> m_cells;
+        fzInt m_width, m_height;
+        
+    public:
+        fzCoverageBuffer(fzInt width, fzInt height)
+        : m_cells(width * height + 4, 0)
+        , m_width(width)
+        , m_height(height)
+        { }
+        
+        
+        void line(fzFloat x0, fzFloat y0, fzFloat x1, fzFloat y1)
+        {
+            if(y0 == y1)
+                return;
+            
+            fzFloat dir = 1;
+            if(y0 > y1) {
+                dir = -1;
+                FZ_SWAP(x0, x1);
+                FZ_SWAP(y0, y1);
+            }
+            
+            const fzFloat dxdy = (x1 - x0) / (y1 - y0);
+            fzFloat x = x0;
+            if(y0 < 0) {
+                x -= y0 * dxdy;
+                y0 = 0;
+            }
+            const fzInt yEnd = fzMin<fzInt>(m_height, (fzInt)ceilf(y1));
+            
+            for(fzInt y = (fzInt)y0; y < yEnd; ++y)
+            {
+                fzFloat *row = &m_cells[y * m_width];
+                fzFloat dy = fzMin<fzFloat>(y + 1, y1) - fzMax<fzFloat>(y, y0);
+                fzFloat xnext = x + dxdy * dy;
+                fzFloat d = dy * dir;
+                
+                fzFloat xa = fzMin(x, xnext);
+                fzFloat xb = fzMax(x, xnext);
+                fzFloat xaFloor = floorf(xa);
+                fzInt xai = (fzInt)xaFloor;
+                fzInt xbi = (fzInt)ceilf(xb);
+                
+                if(xbi <= xai + 1) {
+                    // the line does not leave the pixel
+                    fzFloat xmf = 0.5f * (x + xnext) - xaFloor;
+                    row[xai] += d - d * xmf;
+                    row[xai + 1] += d * xmf;
+                    
+                }else{
+                    fzFloat s = 1.0f / (xb - xa);
+                    fzFloat xaf = xa - xaFloor;
+                    fzFloat a0 = 0.5f * s * (1 - xaf) * (1 - xaf);
+                    fzFloat xbf = xb - xbi + 1;
+                    fzFloat am = 0.5f * s * xbf * xbf;
+                    
+                    row[xai] += d * a0;
+                    if(xbi == xai + 2)
+                        row[xai + 1] += d * (1 - a0 - am);
+                    else {
+                        fzFloat a1 = s * (1.5f - xaf);
+                        row[xai + 1] += d * (a1 - a0);
+                        for(fzInt xi = xai + 2; xi < xbi - 1; ++xi)
+                            row[xi] += d * s;
+                        
+                        fzFloat a2 = a1 + (xbi - xai - 3) * s;
+                        row[xbi - 1] += d * (1 - a2 - am);
+                    }
+                    row[xbi] += d * am;
+                }
+                x = xnext;
+            }
+        }
+        
+        
+        void quad(fzFloat x0, fzFloat y0, fzFloat x1, fzFloat y1, fzFloat x2, fzFloat y2)
+        {
+            // the number of segments grows with the curvature
+            fzFloat devx = x0 - 2 * x1 + x2;
+            fzFloat devy = y0 - 2 * y1 + y2;
+            fzFloat dd = devx * devx + devy * devy;
+            fzInt n = 1 + (fzInt)floorf(sqrtf(sqrtf(3 * dd)));
+            
+            fzFloat px = x0, py = y0;
+            const fzFloat step = 1.0f / n;
+            for(fzInt i = 1; i <= n; ++i) {
+                fzFloat t = i * step;
+                fzFloat mt = 1 - t;
+                fzFloat nx = mt * mt * x0 + 2 * mt * t * x1 + t * t * x2;
+                fzFloat ny = mt * mt * y0 + 2 * mt * t * y1 + t * t * y2;
+                line(px, py, nx, ny);
+                px = nx;
+                py = ny;
+            }
+        }
+        
+        
+        void accumulate(uint8_t *output, fzUInt stride) const
+        {
+            fzFloat acc = 0;
+            for(fzInt y = 0; y < m_height; ++y) {
+                const fzFloat *row = &m_cells[y * m_width];
+                uint8_t *out = output + y * stride;
+                for(fzInt x = 0; x < m_width; ++x) {
+                    acc += row[x];
+                    fzFloat coverage = fabsf(acc);
+                    out[x] = (uint8_t)(fzMin<fzFloat>(coverage, 1) * 255.0f + 0.5f);
+                }
+            }
+        }
+    };
+    
+    
+#pragma mark - TrueType
+    
+    // True if [offset, offset + length) is inside a block of the given size, without overflows.
+    static inline bool fzInBounds(uint32_t offset, uint32_t length, uint32_t size) {
+        return offset <= size && length <= size - offset;
+    }
+    
+    
+    TrueType::TrueType(fzBuffer data)
+    : m_data(data)
+    , m_cmap(0), m_loca(0), m_glyf(0), m_hmtx(0), m_kern(0)
+    , m_cmapLength(0), m_glyfLength(0), m_kernLength(0)
+    , m_unitsPerEm(0), m_numGlyphs(0), m_numHMetrics(0)
+    , m_ascender(0), m_descender(0), m_lineGap(0)
+    , m_longLoca(false)
+    {
+        try {
+            parse();
+        } catch(...) {
+            m_data.free();
+            throw;
+        }
+    }
+    
+    
+    TrueType::~TrueType()
+    {
+        m_data.free();
+    }
+    
+    
+    void TrueType::parse()
+    {
+        if(m_data.isEmpty() || m_data.getLength() < 12)
+            FZ_RAISE("TrueType: Invalid data.");
+        
+        const uint8_t *font = reinterpret_cast<const uint8_t*>(m_data.getPointer());
+        uint32_t version = readU32(font);
+        if(version == 0x4F54544F) // 'OTTO'
+            FZ_RAISE("TrueType: CFF outlines are not supported.");
+        
+        if(version != 0x00010000 && version != 0x74727565) // 'true'
+            FZ_RAISE("TrueType: Invalid TrueType sign.");
+        
+        if(!fzInBounds(12, readU16(font + 4) * 16, m_data.getLength()))
+            FZ_RAISE("TrueType: The table directory is truncated.");
+        
+        uint32_t headLength, hheaLength, maxpLength, cmapLength, locaLength, hmtxLength;
+        uint32_t head = findTable("head", &headLength);
+        uint32_t hhea = findTable("hhea", &hheaLength);
+        uint32_t maxp = findTable("maxp", &maxpLength);
+        m_cmap = findTable("cmap", &cmapLength);
+        m_loca = findTable("loca", &locaLength);
+        m_glyf = findTable("glyf", &m_glyfLength);
+        m_hmtx = findTable("hmtx", &hmtxLength);
+        m_kern = findTable("kern", &m_kernLength);
+        
+        if(!head || !hhea || !maxp || !m_cmap || !m_loca || !m_glyf || !m_hmtx)
+            FZ_RAISE("TrueType: Required tables are missing.");
+        
+        if(headLength < 54 || hheaLength < 36 || maxpLength < 6 || cmapLength < 4)
+            FZ_RAISE("TrueType: Required tables are truncated.");
+        
+        m_unitsPerEm    = readU16(font + head + 18);
+        m_longLoca      = readS16(font + head + 50) != 0;
+        m_ascender      = readS16(font + hhea + 4);
+        m_descender     = readS16(font + hhea + 6);
+        m_lineGap       = readS16(font + hhea + 8);
+        m_numHMetrics   = readU16(font + hhea + 34);
+        m_numGlyphs     = readU16(font + maxp + 4);
+        
+        if(m_unitsPerEm == 0 || m_numHMetrics == 0 || m_ascender == m_descender)
+            FZ_RAISE("TrueType: Invalid metrics.");
+        
+        if((uint32_t)m_numHMetrics * 4 > hmtxLength ||
+           ((uint32_t)m_numGlyphs + 1) * (m_longLoca ? 4 : 2) > locaLength)
+            FZ_RAISE("TrueType: hmtx or loca tables are truncated.");
+        
+        
+        // choose the unicode cmap subtable: full repertoire (3, 10) first, then BMP (3, 1) or (0, x).
+        const uint8_t *cmap = font + m_cmap;
+        uint16_t numTables = readU16(cmap + 2);
+        if(!fzInBounds(4, numTables * 8, cmapLength))
+            FZ_RAISE("TrueType: cmap table is truncated.");
+        
+        uint32_t bmp = 0, full = 0;
+        for(uint16_t i = 0; i < numTables; ++i) {
+            const uint8_t *record = cmap + 4 + i * 8;
+            uint16_t platform = readU16(record);
+            uint16_t encoding = readU16(record + 2);
+            uint32_t offset = readU32(record + 4);
+            if(!fzInBounds(offset, 16, cmapLength))
+                continue;
+            
+            const uint8_t *subtable = cmap + offset;
+            uint16_t format = readU16(subtable);
+            
+            if(format == 12 && (platform == 0 || (platform == 3 && encoding == 10))) {
+                // the groups must be inside the table
+                if(readU32(subtable + 12) <= (cmapLength - offset - 16) / 12)
+                    full = offset;
+            }
+            else if(format == 4 && (platform == 0 || (platform == 3 && encoding == 1))) {
+                // end codes, reserved pad, start codes, deltas and range offsets
+                uint32_t segCount = readU16(subtable + 6) / 2;
+                if(fzInBounds(offset, 16 + segCount * 8, cmapLength))
+                    bmp = offset;
+            }
+        }
+        
+        uint32_t subtable = (full) ? full : bmp;
+        if(subtable == 0)
+            FZ_RAISE("TrueType: Unicode character map not found.");
+        
+        m_cmap += subtable;
+        m_cmapLength = cmapLength - subtable;
+    }
+    
+    
+    uint32_t TrueType::findTable(const char *tag, uint32_t *length) const
+    {
+        const uint8_t *font = reinterpret_cast<const uint8_t*>(m_data.getPointer());
+        uint16_t numTables = readU16(font + 4);
+        
+        *length = 0;
+        for(uint16_t i = 0; i < numTables; ++i) {
+            const uint8_t *record = font + 12 + i * 16;
+            if(memcmp(record, tag, 4) == 0) {
+                uint32_t offset = readU32(record + 8);
+                uint32_t tableLength = readU32(record + 12);
+                if(!fzInBounds(offset, tableLength, m_data.getLength()))
+                    return 0;
+                
+                *length = tableLength;
+                return offset;
+            }
+        }
+        return 0;
+    }
+    
+    
+    uint32_t TrueType::getGlyphIndex(uint32_t codePoint) const
+    {
+        // the subtable header and its arrays were validated by parse()
+        const uint8_t *table = reinterpret_cast<const uint8_t*>(m_data.getPointer()) + m_cmap;
+        
+        if(readU16(table) == 12)
+        {
+            uint32_t nGroups = readU32(table + 12);
+            uint32_t low = 0, high = nGroups;
+            while(low < high) {
+                uint32_t mid = (low + high) / 2;
+                const uint8_t *group = table + 16 + mid * 12;
+                uint32_t start = readU32(group);
+                uint32_t end = readU32(group + 4);
+                
+                if(codePoint < start)
+                    high = mid;
+                else if(codePoint > end)
+                    low = mid + 1;
+                else {
+                    uint32_t glyph = readU32(group + 8) + (codePoint - start);
+                    return (glyph < m_numGlyphs) ? glyph : 0;
+                }
+            }
+            return 0;
+        }
+        
+        // format 4
+        if(codePoint > 0xFFFF)
+            return 0;
+        
+        uint16_t segCount = readU16(table + 6) / 2;
+        const uint8_t *endCodes = table + 14;
+        const uint8_t *startCodes = endCodes + segCount * 2 + 2;
+        const uint8_t *idDeltas = startCodes + segCount * 2;
+        const uint8_t *idRangeOffsets = idDeltas + segCount * 2;
+        
+        uint16_t low = 0, high = segCount;
+        while(low < high) {
+            uint16_t mid = (low + high) / 2;
+            if(readU16(endCodes + mid * 2) < codePoint)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        if(low == segCount)
+            return 0;
+        
+        uint16_t start = readU16(startCodes + low * 2);
+        if(codePoint < start)
+            return 0;
+        
+        uint16_t delta = readU16(idDeltas + low * 2);
+        uint16_t rangeOffset = readU16(idRangeOffsets + low * 2);
+        if(rangeOffset == 0)
+            return (uint16_t)(codePoint + delta);
+        
+        // the glyph id array follows the range offsets, the offset is relative to the range offset itself.
+        uint32_t glyphOffset = (uint32_t)(idRangeOffsets - table) + low * 2 + rangeOffset + (codePoint - start) * 2;
+        if(!fzInBounds(glyphOffset, 2, m_cmapLength))
+            return 0;
+        
+        uint16_t index = readU16(table + glyphOffset);
+        return (index == 0) ? 0 : (uint16_t)(index + delta);
+    }
+    
+    
+    fzFloat TrueType::getScaleForHeight(fzFloat lineHeight) const
+    {
+        return lineHeight / (m_ascender - m_descender);
+    }
+    
+    
+    fzInt TrueType::getAdvance(uint32_t glyph) const
+    {
+        const uint8_t *hmtx = reinterpret_cast<const uint8_t*>(m_data.getPointer()) + m_hmtx;
+        if(glyph >= m_numHMetrics)
+            glyph = m_numHMetrics - 1;
+        
+        return readU16(hmtx + glyph * 4);
+    }
+    
+    
+    fzUInt TrueType::getKerningPairs(uint16_t *firsts, uint16_t *seconds, int16_t *values) const
+    {
+        // version, number of subtables and the first subtable header
+        if(m_kern == 0 || m_kernLength < 18)
+            return 0;
+        
+        const uint8_t *kern = reinterpret_cast<const uint8_t*>(m_data.getPointer()) + m_kern;
+        if(readU16(kern) != 0 || readU16(kern + 2) == 0)
+            return 0;
+        
+        // first subtable, it must be horizontal and format 0
+        const uint8_t *table = kern + 4;
+        uint16_t coverage = readU16(table + 4);
+        if((coverage & 1) == 0 || (coverage >> 8) != 0)
+            return 0;
+        
+        uint16_t nPairs = readU16(table + 6);
+        if(!fzInBounds(18, nPairs * 6, m_kernLength))
+            return 0;
+        
+        const uint8_t *pairs = table + 14;
+        for(uint16_t i = 0; firsts && i < nPairs; ++i) {
+            const uint8_t *pair = pairs + i * 6;
+            firsts[i] = readU16(pair);
+            seconds[i] = readU16(pair + 2);
+            values[i] = readS16(pair + 4);
+        }
+        return nPairs;
+    }
+    
+    
+    fzInt TrueType::getKerning(uint32_t first, uint32_t second) const
+    {
+        fzUInt nPairs = getKerningPairs(NULL, NULL, NULL);
+        if(nPairs == 0)
+            return 0;
+        
+        // pairs are sorted by (first << 16 | second)
+        const uint8_t *pairs = reinterpret_cast<const uint8_t*>(m_data.getPointer()) + m_kern + 4 + 14;
+        uint32_t key = (first << 16) | second;
+        fzUInt low = 0, high = nPairs;
+        while(low < high) {
+            fzUInt mid = (low + high) / 2;
+            uint32_t value = readU32(pairs + mid * 6);
+            if(value < key)
+                low = mid + 1;
+            else if(value > key)
+                high = mid;
+            else
+                return readS16(pairs + mid * 6 + 4);
+        }
+        return 0;
+    }
+    
+    
+    uint32_t TrueType::getGlyphOffset(uint32_t glyph, uint32_t *length) const
+    {
+        *length = 0;
+        if(glyph >= m_numGlyphs)
+            return 0;
+        
+        const uint8_t *loca = reinterpret_cast<const uint8_t*>(m_data.getPointer()) + m_loca;
+        uint32_t start, end;
+        if(m_longLoca) {
+            start = readU32(loca + glyph * 4);
+            end = readU32(loca + glyph * 4 + 4);
+        }else{
+            start = readU16(loca + glyph * 2) * 2;
+            end = readU16(loca + glyph * 2 + 2) * 2;
+        }
+        
+        // an empty glyph has no data, otherwise at least the header is needed
+        if(end < start || end > m_glyfLength || (end > start && end - start < 10))
+            return 0;
+        
+        *length = end - start;
+        return m_glyf + start;
+    }
+    
+    
+    void TrueType::getOutline(uint32_t glyph, const fzFloat *m, vector<fzOutlinePoint>& points, vector<fzUInt>& ends, fzUInt depth) const
+    {
+        uint32_t length;
+        uint32_t offset = getGlyphOffset(glyph, &length);
+        if(length == 0 || depth > 8)
+            return;
+        
+        const uint8_t *data = reinterpret_cast<const uint8_t*>(m_data.getPointer()) + offset;
+        const uint8_t *limit = data + length;
+        int16_t numberOfContours = readS16(data);
+        
+        if(numberOfContours >= 0)
+        {
+            // SIMPLE GLYPH
+            // The malformed glyphs are skipped, the points read until then are discarded.
+            const uint8_t *endPts = data + 10;
+            const uint8_t *p = endPts + numberOfContours * 2;
+            if(p + 2 > limit)
+                return;
+            
+            // end points must grow, the last one gives the number of points
+            fzUInt numPoints = 0;
+            for(int16_t c = 0; c < numberOfContours; ++c) {
+                fzUInt end = readU16(endPts + c * 2) + 1;
+                if(end < numPoints)
+                    return;
+                numPoints = end;
+            }
+            
+            uint16_t instructions = readU16(p);
+            if(instructions > limit - p - 2)
+                return;
+            p += 2 + instructions;
+            
+            // flags
+            vector<uint8_t> flags(numPoints);
+            for(fzUInt i = 0; i < numPoints; ) {
+                if(p >= limit)
+                    return;
+                uint8_t flag = *p++;
+                fzUInt repeat = 0;
+                if(flag & 8) {
+                    if(p >= limit)
+                        return;
+                    repeat = *p++;
+                }
+                for(fzUInt r = 0; r <= repeat && i < numPoints; ++r)
+                    flags[i++] = flag;
+            }
+            
+            // coordinates are deltas, x first, y after
+            fzUInt base = points.size();
+            points.resize(base + numPoints);
+            
+            int32_t value = 0;
+            for(fzUInt i = 0; i < numPoints; ++i) {
+                uint8_t flag = flags[i];
+                if(flag & 2) {
+                    if(p + 1 > limit) {
+                        points.resize(base);
+                        return;
+                    }
+                    value += (flag & 16) ? *p : -(int32_t)*p;
+                    ++p;
+                }else if(!(flag & 16)) {
+                    if(p + 2 > limit) {
+                        points.resize(base);
+                        return;
+                    }
+                    value += readS16(p);
+                    p += 2;
+                }
+                points[base + i].x = value;
+                points[base + i].onCurve = (flag & 1) != 0;
+            }
+            value = 0;
+            for(fzUInt i = 0; i < numPoints; ++i) {
+                uint8_t flag = flags[i];
+                if(flag & 4) {
+                    if(p + 1 > limit) {
+                        points.resize(base);
+                        return;
+                    }
+                    value += (flag & 32) ? *p : -(int32_t)*p;
+                    ++p;
+                }else if(!(flag & 32)) {
+                    if(p + 2 > limit) {
+                        points.resize(base);
+                        return;
+                    }
+                    value += readS16(p);
+                    p += 2;
+                }
+                points[base + i].y = value;
+            }
+            
+            // transform
+            for(fzUInt i = base; i < points.size(); ++i) {
+                fzFloat x = points[i].x, y = points[i].y;
+                points[i].x = m[0] * x + m[2] * y + m[4];
+                points[i].y = m[1] * x + m[3] * y + m[5];
+            }
+            for(int16_t c = 0; c < numberOfContours; ++c)
+                ends.push_back(base + readU16(endPts + c * 2) + 1);
+        }
+        else
+        {
+            // COMPOSITE GLYPH
+            const uint8_t *p = data + 10;
+            uint16_t flags;
+            do {
+                if(p + 4 > limit)
+                    return;
+                flags = readU16(p);
+                uint16_t component = readU16(p + 2);
+                p += 4;
+                
+                // arguments and scales
+                fzUInt argumentsSize = (flags & 1) ? 4 : 2;
+                fzUInt scaleSize = (flags & 8) ? 2 : (flags & 0x40) ? 4 : (flags & 0x80) ? 8 : 0;
+                if(p + argumentsSize + scaleSize > limit)
+                    return;
+                
+                fzFloat dx = 0, dy = 0;
+                if(flags & 1) {
+                    if(flags & 2) { dx = readS16(p); dy = readS16(p + 2); }
+                    p += 4;
+                }else{
+                    if(flags & 2) { dx = (int8_t)p[0]; dy = (int8_t)p[1]; }
+                    p += 2;
+                }
+                
+                // 2.14 fixed point scales
+                fzFloat a = 1, b = 0, c = 0, d = 1;
+                if(flags & 8) {
+                    a = d = readS16(p) / 16384.0f;
+                    p += 2;
+                }else if(flags & 0x40) {
+                    a = readS16(p) / 16384.0f;
+                    d = readS16(p + 2) / 16384.0f;
+                    p += 4;
+                }else if(flags & 0x80) {
+                    a = readS16(p) / 16384.0f;
+                    b = readS16(p + 2) / 16384.0f;
+                    c = readS16(p + 4) / 16384.0f;
+                    d = readS16(p + 6) / 16384.0f;
+                    p += 8;
+                }
+                
+                // combined = m * component transform
+                fzFloat t[6] = {
+                    m[0] * a + m[2] * b,
+                    m[1] * a + m[3] * b,
+                    m[0] * c + m[2] * d,
+                    m[1] * c + m[3] * d,
+                    m[0] * dx + m[2] * dy + m[4],
+                    m[1] * dx + m[3] * dy + m[5]
+                };
+                getOutline(component, t, points, ends, depth + 1);
+                
+            } while(flags & 0x20);
+        }
+    }
+    
+    
+    fzGlyphBox TrueType::getGlyphBox(uint32_t glyph, fzFloat scale) const
+    {
+        fzGlyphBox box = { 0, 0, 0, 0 };
+        
+        uint32_t length;
+        uint32_t offset = getGlyphOffset(glyph, &length);
+        if(length == 0)
+            return box;
+        
+        const uint8_t *data = reinterpret_cast<const uint8_t*>(m_data.getPointer()) + offset;
+        box.x0 = (fzInt)floorf(readS16(data + 2) * scale);
+        box.y0 = (fzInt)floorf(-readS16(data + 8) * scale);
+        box.x1 = (fzInt)ceilf(readS16(data + 6) * scale);
+        box.y1 = (fzInt)ceilf(-readS16(data + 4) * scale);
+        return box;
+    }
+    
+    
+    void TrueType::rasterize(uint32_t glyph, fzFloat scale, uint8_t *output, fzUInt stride, fzUInt padding) const
+    {
+        fzGlyphBox box = getGlyphBox(glyph, scale);
+        fzInt width = box.getWidth() + padding * 2;
+        fzInt height = box.getHeight() + padding * 2;
+        if(box.getWidth() <= 0 || box.getHeight() <= 0)
+            return;
+        
+        // font units -> bitmap pixels, y grows down
+        const fzFloat m[6] = {
+            scale, 0, 0, -scale,
+            (fzFloat)(padding - box.x0), (fzFloat)(padding - box.y0)
+        };
+        
+        vector<fzOutlinePoint> points;
+        vector<fzUInt> ends;
+        getOutline(glyph, m, points, ends, 0);
+        
+        // the points of malformed fonts can be outside the box, the coverage buffer is not written out of bounds.
+        for(fzUInt i = 0; i < points.size(); ++i) {
+            points[i].x = fzMin<fzFloat>(fzMax<fzFloat>(points[i].x, 0), width - 1);
+            points[i].y = fzMin<fzFloat>(fzMax<fzFloat>(points[i].y, 0), height);
+        }
+        
+        fzCoverageBuffer buffer(width, height);
+        fzUInt begin = 0;
+        for(fzUInt c = 0; c < ends.size(); ++c)
+        {
+            const fzUInt end = ends[c];
+            const fzUInt count = end - begin;
+            if(count < 2) {
+                begin = end;
+                continue;
+            }
+            
+            // the contour may start with an off-curve point, then start is implied.
+            const fzOutlinePoint& first = points[begin];
+            const fzOutlinePoint& last = points[end - 1];
+            fzFloat sx, sy;
+            fzUInt i = begin, iEnd = end;
+            if(first.onCurve) {
+                sx = first.x; sy = first.y;
+                ++i;
+            }else if(last.onCurve) {
+                sx = last.x; sy = last.y;
+                --iEnd;
+            }else{
+                sx = (first.x + last.x) * 0.5f;
+                sy = (first.y + last.y) * 0.5f;
+            }
+            
+            fzFloat px = sx, py = sy;
+            fzFloat cx = 0, cy = 0;
+            bool hasControl = false;
+            for(; i < iEnd; ++i)
+            {
+                const fzOutlinePoint& point = points[i];
+                if(point.onCurve) {
+                    if(hasControl)
+                        buffer.quad(px, py, cx, cy, point.x, point.y);
+                    else
+                        buffer.line(px, py, point.x, point.y);
+                    
+                    px = point.x; py = point.y;
+                    hasControl = false;
+                }else{
+                    if(hasControl) {
+                        fzFloat mx = (cx + point.x) * 0.5f;
+                        fzFloat my = (cy + point.y) * 0.5f;
+                        buffer.quad(px, py, cx, cy, mx, my);
+                        px = mx; py = my;
+                    }
+                    cx = point.x; cy = point.y;
+                    hasControl = true;
+                }
+            }
+            
+            // close the contour
+            if(hasControl)
+                buffer.quad(px, py, cx, cy, sx, sy);
+            else
+                buffer.line(px, py, sx, sy);
+            
+            begin = end;
+        }
+        
+        buffer.accumulate(output, stride);
+    }
+}
@@ -0,0 +1,153 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZTRUETYPE_H_INCLUDED__
+#define __FZTRUETYPE_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZTypes.h"
+#include "FZAllocator.h"
+#include STL_VECTOR
+
+
+using namespace STD;
+
+namespace FORZE {
+    
+    //! Pixel bounding box of a rasterized glyph, y grows down from the baseline.
+    struct fzGlyphBox
+    {
+        fzInt x0, y0, x1, y1;
+        
+        fzInt getWidth() const { return x1 - x0; }
+        fzInt getHeight() const { return y1 - y0; }
+    };
+    
+    
+    /** TrueType parses a TrueType font (.ttf, or .otf with TrueType outlines) and rasterizes its glyphs.
+     * Only the tables needed to render horizontal text are read: cmap (formats 4 and 12), head, hhea,
+     * hmtx, maxp, loca, glyf and kern (format 0). Hinting instructions are ignored.
+     * Every offset read from the font is checked against the data, malformed fonts are rejected
+     * in the constructor and malformed glyphs are rendered empty.
+     *
+     * The const methods do not modify any state, so glyphs can be rasterized from several
+     * worker threads at the same time.
+     */
+    class TrueType
+    {
+    private:
+        struct fzOutlinePoint
+        {
+            fzFloat x, y;
+            bool onCurve;
+        };
+        
+        fzBuffer m_data;
+        uint32_t m_cmap;
+        uint32_t m_loca;
+        uint32_t m_glyf;
+        uint32_t m_hmtx;
+        uint32_t m_kern;
+        
+        // bytes that can be read from the tables, the cmap one starts at the chosen subtable
+        uint32_t m_cmapLength;
+        uint32_t m_glyfLength;
+        uint32_t m_kernLength;
+        uint16_t m_unitsPerEm;
+        uint16_t m_numGlyphs;
+        uint16_t m_numHMetrics;
+        int16_t m_ascender;
+        int16_t m_descender;
+        int16_t m_lineGap;
+        bool m_longLoca;
+        
+        void parse();
+        uint32_t findTable(const char *tag, uint32_t *length) const;
+        uint32_t getGlyphOffset(uint32_t glyph, uint32_t *length) const;
+        void getOutline(uint32_t glyph, const fzFloat *transform, vector<fzOutlinePoint>& points, vector<fzUInt>& ends, fzUInt depth) const;
+        
+        
+    protected:
+        TrueType(const TrueType&);
+        TrueType &operator = (const TrueType&);
+        
+        
+    public:
+        //! Constructs a TrueType font from the file data, the TrueType takes the ownership of the buffer.
+        //! @throws an exception if the data is not a valid TrueType font, the buffer is released.
+        explicit TrueType(fzBuffer data);
+        
+        // Destructor
+        ~TrueType();
+        
+        
+        //! Returns the glyph index of an unicode code point, 0 if the font does not include it.
+        uint32_t getGlyphIndex(uint32_t codePoint) const;
+        
+        
+        //! Returns the scale that converts font units to pixels for a given line height.
+        fzFloat getScaleForHeight(fzFloat lineHeight) const;
+        
+        
+        //! Returns the ascender in font units.
+        fzInt getAscender() const {
+            return m_ascender;
+        }
+        
+        
+        //! Returns the descender in font units, usually negative.
+        fzInt getDescender() const {
+            return m_descender;
+        }
+        
+        
+        //! Returns the horizontal advance of a glyph in font units.
+        fzInt getAdvance(uint32_t glyph) const;
+        
+        
+        //! Returns the kerning between two glyphs in font units.
+        fzInt getKerning(uint32_t first, uint32_t second) const;
+        
+        
+        //! Iterates all the kerning pairs of the kern table.
+        //! @return the number of pairs, the arrays can be NULL.
+        fzUInt getKerningPairs(uint16_t *firsts, uint16_t *seconds, int16_t *values) const;
+        
+        
+        //! Returns the pixel box of a glyph rasterized with the given scale.
+        //! Empty glyphs (space) return an empty box.
+        fzGlyphBox getGlyphBox(uint32_t glyph, fzFloat scale) const;
+        
+        
+        //! Rasterizes a glyph with antialiasing into a 8 bits coverage bitmap.
+        //! The bitmap must be getGlyphBox().getWidth() x getGlyphBox().getHeight() pixels, plus the padding.
+        //! @param padding are the empty pixels left at every side of the glyph.
+        void rasterize(uint32_t glyph, fzFloat scale, uint8_t *output, fzUInt stride, fzUInt padding) const;
+    };
+}
+#endif
@@ -81,7 +81,7 @@ namespace FORZE {
     {
         return
         (r.origin.x < (origin.x + size.width)) &&
-        ((r.origin.y + r.size.width) > origin.x) &&
+        ((r.origin.x + r.size.width) > origin.x) &&
         (r.origin.y < (origin.y + size.height)) &&
         ((r.origin.y + r.size.height) > origin.y);
     }
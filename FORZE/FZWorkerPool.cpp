@@ -0,0 +1,180 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZWorkerPool.h"
+#include "FZMacros.h"
+#include "external/tinythread/tinythread.h"
+
+
+using namespace STD;
+
+namespace FORZE {
+    
+    WorkerPool* WorkerPool::p_instance = NULL;
+    
+    WorkerPool& WorkerPool::Instance()
+    {
+        if (p_instance == NULL)
+            p_instance = new WorkerPool();
+        
+        return *p_instance;
+    }
+    
+    
+    WorkerPool::WorkerPool()
+    : m_workers()
+    , m_tasks()
+    , p_batch(NULL)
+    , m_stop(false)
+    {
+        p_mutex = new mutex();
+        p_workCondition = new condition_variable();
+        p_doneCondition = new condition_variable();
+        
+        // The main thread is also used by parallelFor(), so we leave a core for it.
+        fzUInt cores = thread::hardware_concurrency();
+        fzUInt workers = (cores > 2) ? cores - 1 : 1;
+        
+        m_workers.reserve(workers);
+        for(fzUInt i = 0; i < workers; ++i)
+            m_workers.push_back(new thread(workerLoop, this));
+        
+        FZLOGINFO("WorkerPool: %d workers.", workers);
+    }
+    
+    
+    WorkerPool::~WorkerPool()
+    {
+        p_mutex->lock();
+        m_stop = true;
+        p_workCondition->notify_all();
+        p_mutex->unlock();
+        
+        vector<thread*>::iterator it(m_workers.begin());
+        for(; it != m_workers.end(); ++it) {
+            (*it)->join();
+            delete *it;
+        }
+        delete p_doneCondition;
+        delete p_workCondition;
+        delete p_mutex;
+    }
+    
+    
+    fzUInt WorkerPool::getNumberOfWorkers() const
+    {
+        return m_workers.size();
+    }
+    
+    
+    void WorkerPool::workerLoop(void *ptr)
+    {
+        WorkerPool *pool = static_cast<WorkerPool*>(ptr);
+        
+        pool->p_mutex->lock();
+        while(true)
+        {
+            fzBatch *batch = pool->p_batch;
+            
+            if(batch && batch->next < batch->count) {
+                
+                // Batch tasks have preference, the main thread is waiting for them.
+                fzUInt index = batch->next++;
+                pool->p_mutex->unlock();
+                batch->func(batch->context, index);
+                pool->p_mutex->lock();
+                
+                if(++batch->done == batch->count)
+                    pool->p_doneCondition->notify_all();
+                
+            }else if(!pool->m_tasks.empty()) {
+                
+                fzTask task = pool->m_tasks.front();
+                pool->m_tasks.pop();
+                pool->p_mutex->unlock();
+                task.func(task.context, task.index);
+                pool->p_mutex->lock();
+                
+            }else if(pool->m_stop) {
+                break;
+                
+            }else
+                pool->p_workCondition->wait(*pool->p_mutex);
+        }
+        pool->p_mutex->unlock();
+    }
+    
+    
+    void WorkerPool::dispatch(fzTaskFunc func, void *context, fzUInt index)
+    {
+        FZ_ASSERT(func, "Task function can not be NULL.");
+        
+        fzTask task = {func, context, index};
+        
+        p_mutex->lock();
+        m_tasks.push(task);
+        p_workCondition->notify_one();
+        p_mutex->unlock();
+    }
+    
+    
+    void WorkerPool::parallelFor(fzTaskFunc func, void *context, fzUInt count)
+    {
+        FZ_ASSERT(func, "Task function can not be NULL.");
+        
+        if(count == 0)
+            return;
+        
+        if(count == 1) {
+            func(context, 0);
+            return;
+        }
+        
+        fzBatch batch = {func, context, count, 0, 0};
+        
+        p_mutex->lock();
+        FZ_ASSERT(p_batch == NULL, "parallelFor() can not be nested.");
+        p_batch = &batch;
+        p_workCondition->notify_all();
+        
+        // The calling thread executes tasks as well.
+        while(batch.next < batch.count) {
+            fzUInt index = batch.next++;
+            p_mutex->unlock();
+            func(context, index);
+            p_mutex->lock();
+            ++batch.done;
+        }
+        while(batch.done < batch.count)
+            p_doneCondition->wait(*p_mutex);
+        
+        p_batch = NULL;
+        p_mutex->unlock();
+    }
+}
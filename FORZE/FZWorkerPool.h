@@ -0,0 +1,123 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZWORKERPOOL_H_INCLUDED__
+#define __FZWORKERPOOL_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "FZTypes.h"
+#include STL_QUEUE
+#include STL_VECTOR
+
+
+using namespace STD;
+
+namespace FORZE {
+    
+    //! Task function executed by the WorkerPool.
+    //! @param context is the user pointer passed when the task was dispatched.
+    //! @param index is the task index, [0, count) when used by parallelFor().
+    typedef void (*fzTaskFunc)(void *context, fzUInt index);
+    
+    
+    class thread;
+    class mutex;
+    class condition_variable;
+    
+    /** WorkerPool owns a fixed set of background threads (one less than the number of cores).
+     * It is used internally by FORZE to spread independent work across cores, but it can be used
+     * by the developer as well.
+     * - dispatch(): runs a task asynchronously, the caller is responsible of the synchronization.
+     * - parallelFor(): runs N tasks and blocks until all of them finished. The calling thread
+     *   helps executing the tasks, so it is safe to use even when there are no free workers.
+     *
+     * @warning Tasks must not call OpenGL and must not modify the node hierarchy.
+     */
+    class WorkerPool
+    {
+    private:
+        struct fzTask {
+            fzTaskFunc func;
+            void *context;
+            fzUInt index;
+        };
+        
+        struct fzBatch {
+            fzTaskFunc func;
+            void *context;
+            fzUInt count;
+            fzUInt next;
+            fzUInt done;
+        };
+        
+        // Pool's instance
+        static WorkerPool* p_instance;
+        
+        mutex *p_mutex;
+        condition_variable *p_workCondition;
+        condition_variable *p_doneCondition;
+        
+        vector<thread*> m_workers;
+        queue<fzTask> m_tasks;
+        fzBatch *p_batch;
+        bool m_stop;
+        
+        static void workerLoop(void *pool);
+        
+        
+    protected:
+        // Constructors
+        WorkerPool();
+        WorkerPool(const WorkerPool&);
+        WorkerPool &operator = (const WorkerPool&);
+        
+        // Destructor
+        ~WorkerPool();
+        
+        
+    public:
+        //! Gets and allocates the singleton.
+        static WorkerPool& Instance();
+        
+        
+        //! Returns the number of background threads.
+        fzUInt getNumberOfWorkers() const;
+        
+        
+        //! Runs a task in a background thread.
+        //! The task is queued and executed as soon as a worker is free.
+        void dispatch(fzTaskFunc func, void *context, fzUInt index = 0);
+        
+        
+        //! Runs "count" tasks, func(context, 0) ... func(context, count-1), across the workers
+        //! and the calling thread. It returns when all the tasks finished.
+        //! @warning Only one parallelFor() can be running at the same time.
+        void parallelFor(fzTaskFunc func, void *context, fzUInt count);
+    };
+}
+#endif
@@ -0,0 +1,69 @@
+// DO NOT MODIFY THE HEADERS IF FORZE IS ALREADY COMPILED AS A STATIC LIBRARY
+#ifndef __FZACOLORRGBA_SDF_SHADER_H_INCLUDED__
+#define __FZACOLORRGBA_SDF_SHADER_H_INCLUDED__
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+#include "../FZOSW.h"
+
+#if FZ_GL_SHADERS
+
+// Signed distance field text. The alpha channel stores the distance, 0.5 is the edge.
+// u_outlineWidth and u_glowWidth are distances: 0.5 is the whole spread of the field.
+// The output is premultiplied.
+const char __fz_frag_aC4_SDF[] =
+"#ifdef GL_ES \n"
+"#extension GL_OES_standard_derivatives : enable \n"
+"precision mediump float; \n"
+"varying lowp vec4 v_fragmentColor; \n"
+"varying mediump vec2 v_texCoord; \n"
+"uniform lowp sampler2D u_texture; \n"
+"#else \n"
+"varying vec4 v_fragmentColor; \n"
+"varying vec2 v_texCoord; \n"
+"uniform sampler2D u_texture; \n"
+"#endif \n"
+"uniform vec4 u_outlineColor; \n"
+"uniform float u_outlineWidth; \n"
+"uniform vec4 u_glowColor; \n"
+"uniform float u_glowWidth; \n"
+"void main() { \n"
+"	float dist = texture2D(u_texture, v_texCoord).a; \n"
+"	float smoothing = 0.7 * fwidth(dist); \n"
+"	float fill = smoothstep(0.5 - smoothing, 0.5 + smoothing, dist); \n"
+"	float edge = 0.5 - u_outlineWidth; \n"
+"	vec4 color = mix(u_outlineColor, v_fragmentColor, fill); \n"
+"	color.a *= smoothstep(edge - smoothing, edge + smoothing, dist); \n"
+"	float glow = u_glowColor.a * smoothstep(edge - max(u_glowWidth, 0.001), edge, dist) * (1.0 - color.a); \n"
+"	gl_FragColor = vec4(color.rgb * color.a + u_glowColor.rgb * glow, color.a + glow); \n"
+"}";
+
+
+#endif
+#endif
@@ -31,6 +31,7 @@ static TestLayer *allTest(fzUInt index)
         case 18: return new ActionRepeat();
         case 19: return new ActionCallFunc();
         case 20: return new ActionCallFuncND();
+        case 21: return new ActionCoroutine();
         default:
             return NULL;
     }
@@ -469,6 +470,55 @@ ActionCallFuncND::ActionCallFuncND()
 }
 
 
+class JumpScript : public Coroutine
+{
+    Sprite *p_sprite;
+    int m_jumps;
+    
+public:
+    JumpScript(Sprite *sprite)
+    : p_sprite(sprite)
+    , m_jumps(0)
+    { }
+    
+    void run()
+    {
+        FZ_COROUTINE_BEGIN();
+        
+        for(m_jumps = 0; m_jumps < 3; ++m_jumps) {
+            FZ_AWAIT_ACTION(p_sprite, new JumpBy(0.5f, fzPoint(40, 0), 50, 1));
+            FZ_AWAIT_DELAY(0.25f);
+        }
+        FZ_AWAIT_ACTION(p_sprite, new RotateBy(1, 360));
+        FZ_AWAIT_ACTION(p_sprite, new FadeOut(1));
+        
+        FZ_COROUTINE_END();
+    }
+};
+
+
+ActionCoroutine::ActionCoroutine()
+: ActionBase("Coroutine", "Jumps 3 times, spins and fades out.")
+{
+    p_script = new JumpScript(grossini);
+    p_script->start();
+}
+
+
+ActionCoroutine::~ActionCoroutine()
+{
+    p_script->release();
+}
+
+
+void ActionCoroutine::onExit()
+{
+    // the script uses grossini between the awaits
+    p_script->stop();
+    ActionBase::onExit();
+}
+
+
 ActionOrbit::ActionOrbit()
 : ActionBase("ActionOrbit", NULL)
 {
@@ -171,6 +171,17 @@ public:
     ActionCallFuncND();
 };
 
+class ActionCoroutine : public ActionBase
+{
+    Coroutine *p_script;
+    
+public:
+    ActionCoroutine();
+    ~ActionCoroutine();
+    
+    void onExit();
+};
+
 
 class ActionOrbit : public ActionBase
 {
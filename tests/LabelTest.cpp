@@ -6,7 +6,7 @@
 using namespace FORZE;
 
 
-#define NUMBER_OF_TESTS 4
+#define NUMBER_OF_TESTS 7
 
 static TestLayer *allTest(fzUInt index)
 {
@@ -15,6 +15,9 @@ static TestLayer *allTest(fzUInt index)
         case 1: return new LabelTest2();
         case 2: return new LabelTest3();
         case 3: return new LabelTest4();
+        case 4: return new LabelTest5();
+        case 5: return new LabelTest6();
+        case 6: return new LabelTest7();
         default:
             return NULL;
     }
@@ -133,3 +133,93 @@ public:
         addChild(label4);
     }
 };
+
+
+class LabelTest5 : public TestLayer
+{
+    fzUInt m_frames;
+    
+public:
+    LabelTest5()
+    : TestLayer("Text mesh", "Only the changed glyphs are updated")
+    , m_frames(0)
+    {
+        Label *label1 = new Label("0", "helvetica.fnt");
+        label1->setMode(kFZLabelMode_mesh);
+        label1->setName("counter");
+        label1->setPosition(getContentSize()/2 + fzPoint(0, 50));
+        addChild(label1);
+        
+        Label *label2 = new Label("Hello, my name is\nFORZE", "helvetica.fnt");
+        label2->setMode(kFZLabelMode_mesh);
+        label2->setAlignment(kFZLabelAlignment_center);
+        label2->setColor(fzYELLOW);
+        label2->setPosition(getContentSize()/2 + fzPoint(0, -50));
+        label2->runAction(new RepeatForever(new RotateBy(4, 360)));
+        addChild(label2);
+        
+        schedule(SEL_FLOAT(LabelTest5::updateCounter), 0);
+    }
+    
+    void updateCounter(fzFloat)
+    {
+        Label *counter = (Label*)getChildByName("counter");
+        counter->setString(FZT("%d", ++m_frames));
+    }
+};
+
+
+class LabelTest6 : public TestLayer
+{
+    fzUInt m_frames;
+    
+public:
+    LabelTest6()
+    : TestLayer("TrueType", "Glyphs are rasterized when they are used")
+    , m_frames(0)
+    {
+        Label *label1 = new Label("The quick brown fox\njumps over the lazy dog", "arial.ttf", 40);
+        label1->setAlignment(kFZLabelAlignment_center);
+        label1->setPosition(getContentSize()/2 + fzPoint(0, 80));
+        addChild(label1);
+        
+        Label *label2 = new Label("0", "arial.ttf", 24);
+        label2->setMode(kFZLabelMode_mesh);
+        label2->setName("counter");
+        label2->setPosition(getContentSize()/2 - fzPoint(0, 40));
+        addChild(label2);
+        
+        schedule(SEL_FLOAT(LabelTest6::updateCounter), 0);
+    }
+    
+    void updateCounter(fzFloat)
+    {
+        Label *counter = (Label*)getChildByName("counter");
+        counter->setString(FZT("AV %d Wa", ++m_frames));
+    }
+};
+
+
+class LabelTest7 : public TestLayer
+{
+public:
+    LabelTest7()
+    : TestLayer("Distance field", "One atlas for every size, outline and glow")
+    {
+        Label *label1 = new Label("Small", "arial.ttf", 16, true);
+        label1->setPosition(getContentSize()/2 + fzPoint(0, 120));
+        addChild(label1);
+        
+        Label *label2 = new Label("Outline", "arial.ttf", 48, true);
+        label2->setOutline(fzColor4F(0, 0, 0, 1), 0.5f);
+        label2->setPosition(getContentSize()/2 + fzPoint(0, 40));
+        addChild(label2);
+        
+        Label *label3 = new Label("Glow", "arial.ttf", 48, true);
+        label3->setColor(fzYELLOW);
+        label3->setGlow(fzColor4F(1, 0.3f, 0, 0.8f), 1);
+        label3->setPosition(getContentSize()/2 - fzPoint(0, 60));
+        label3->runAction(new RepeatForever(new Sequence(new ScaleTo(1.5f, 4), new ScaleTo(1.5f, 1), NULL)));
+        addChild(label3);
+    }
+};
@@ -5,13 +5,14 @@
 using namespace FORZE;
 
 
-#define NUMBER_OF_TESTS 2
+#define NUMBER_OF_TESTS 3
 
 TestLayer *allTest2(fzUInt index)
 {
     switch (index) {
         case 0: return new LightBasic();
         case 1: return new LightTMX();
+        case 2: return new TMXEncodings();
         default:
             return NULL;
     }
@@ -47,6 +47,29 @@ public:
 };
 
 
+class TMXEncodings : public TestLayer
+{
+public:
+    TMXEncodings()
+    : TestLayer("TMXEncodings", "uncompressed, gzip and zlib")
+    {
+        const char *filenames[] = {
+            "orthogonal-test6-uncompressed.tmx",
+            "orthogonal-test6-gzip.tmx",
+            "orthogonal-test6.tmx"
+        };
+        
+        // the three maps have the same tiles
+        for(fzInt i = 0; i < 3; ++i) {
+            TMXTiledMap *map = new TMXTiledMap(filenames[i]);
+            map->setScale(1/3.0f);
+            map->setPosition(getContentSize().width * i / 3, 0);
+            addChild(map);
+        }
+    }
+};
+
+
 class LightTMX : public TestLayer
 {   
     LightSystem *system;
@@ -5,14 +5,15 @@
 using namespace FORZE;
 
 
-#define NUMBER_OF_TESTS 3
+#define NUMBER_OF_TESTS 4
 
 static TestLayer *allTest(fzUInt index)
 {
     switch (index) {
         case 0: return new SchedulingTest();
         case 1: return new UnschedulingTest();
-        case 2: return new ActionLoop1();
+        case 2: return new PhasesTest();
+        case 3: return new ActionLoop1();
 
         default:
             return NULL;
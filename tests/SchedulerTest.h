@@ -122,6 +122,56 @@ public:
 
 };
 
+class ConcurrentSpinner : public Sprite
+{
+    fzFloat speed;
+    
+public:
+    ConcurrentSpinner()
+    : Sprite("grossini.png")
+    , speed(FZ_RANDOM_MINUS1_1() * 360)
+    {
+        setScale(0.3f);
+        // update() only modifies this sprite, so it is safe to run it in a worker thread.
+        schedule(SEL_FLOAT(Node::update), 0, kFZUpdatePhase_Update, true);
+    }
+    
+    void update(fzFloat dt)
+    {
+        setRotation(getRotation() + speed * dt);
+    }
+};
+
+
+class PhasesTest : public TestLayer
+{
+public:
+    PhasesTest()
+    : TestLayer("Update phases", "Sprites rotate in worker threads, the label is updated in the post-update phase.")
+    {
+        for(int i = 0; i < 200; ++i) {
+            Sprite *sprite = new ConcurrentSpinner();
+            sprite->setPosition(FZ_RANDOM_0_1() * getContentSize().width, FZ_RANDOM_0_1() * getContentSize().height);
+            addChild(sprite);
+        }
+        
+        Label *label = new Label("", "helvetica.fnt");
+        label->setTag(0);
+        label->setPosition(getContentSize()/2);
+        addChild(label, 1);
+        
+        schedule(SEL_FLOAT(PhasesTest::postUpdate), 0, kFZUpdatePhase_PostUpdate);
+    }
+    
+    void postUpdate(fzFloat dt)
+    {
+        Node *first = static_cast<Node*>(getChildren().front());
+        Label *label = (Label*) getChildByTag(0);
+        label->setString(FZT("%f", first->getRotation()));
+    }
+};
+
+
 class ActionLoop1 : public TestLayer
 {    
 public:
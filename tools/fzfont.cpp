@@ -0,0 +1,280 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+/**
+ * fzfont: converts an AngelCode bitmap font (.fnt, text format) into the precompiled FORZE font
+ * format (.fzf), loaded by Font without any parsing. The format is described in FORZE/FZFont.h.
+ *
+ * Build: c++ -std=c++11 -O2 tools/fzfont.cpp -o fzfont
+ * Usage: fzfont <input.fnt> <output.fzf>
+ * Convert every scaled variant: font@x2.fnt -> font@x2.fzf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+// Must match FORZE/FZFont.h
+#define FZ_FONT_MAGIC 0x4e465a46
+#define FZ_FONT_VERSION 1
+
+struct fzFontHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    float lineHeight;
+    uint32_t textureLength;
+    uint32_t pageCount;
+    uint32_t kerningCount;
+};
+
+struct fzFontGlyph
+{
+    float x, y;
+    float width, height;
+    float xOffset, yOffset;
+    float xAdvance;
+};
+
+struct fzFontKerning
+{
+    uint32_t second;
+    float amount;
+};
+
+
+static bool isLittleEndian()
+{
+    uint16_t value = 1;
+    return *(uint8_t*)&value == 1;
+}
+
+
+static uint32_t toLittle32(uint32_t n)
+{
+    if(isLittleEndian())
+        return n;
+    return ((n & 0xff) << 24) | ((n & 0xff00) << 8) | ((n >> 8) & 0xff00) | (n >> 24);
+}
+
+
+static float toLittleFloat(float f)
+{
+    uint32_t n;
+    memcpy(&n, &f, sizeof(n));
+    n = toLittle32(n);
+    memcpy(&f, &n, sizeof(n));
+    return f;
+}
+
+
+static void writeU32(vector<char>& out, uint32_t value)
+{
+    value = toLittle32(value);
+    out.insert(out.end(), (char*)&value, (char*)&value + sizeof(value));
+}
+
+
+static void writeFloat(vector<char>& out, float value)
+{
+    value = toLittleFloat(value);
+    out.insert(out.end(), (char*)&value, (char*)&value + sizeof(value));
+}
+
+
+int main(int argc, char **argv)
+{
+    if(argc != 3) {
+        fprintf(stderr, "Usage: %s <input.fnt> <output.fzf>\n", argv[0]);
+        return 1;
+    }
+    
+    FILE *input = fopen(argv[1], "r");
+    if(input == NULL) {
+        fprintf(stderr, "fzfont: %s can not be opened.\n", argv[1]);
+        return 1;
+    }
+    
+    float lineHeight = 0;
+    string texture;
+    map<uint32_t, fzFontGlyph> glyphs;
+    map<uint64_t, float> kernings;
+    
+    char line[1024];
+    int lineNumber = 0;
+    while(fgets(line, sizeof(line), input))
+    {
+        ++lineNumber;
+        if(strncmp(line, "common ", 7) == 0)
+        {
+            int pages = 0;
+            if(sscanf(line, "common lineHeight=%f base=%*d scaleW=%*d scaleH=%*d pages=%d", &lineHeight, &pages) != 2) {
+                fprintf(stderr, "fzfont: line %d: invalid common data.\n", lineNumber);
+                return 1;
+            }
+            if(pages != 1) {
+                fprintf(stderr, "fzfont: line %d: the number of pages must be 1.\n", lineNumber);
+                return 1;
+            }
+        }
+        else if(strncmp(line, "page ", 5) == 0)
+        {
+            const char *start = strstr(line, "file=\"");
+            const char *end = (start) ? strchr(start + 6, '"') : NULL;
+            if(end == NULL) {
+                fprintf(stderr, "fzfont: line %d: invalid page data.\n", lineNumber);
+                return 1;
+            }
+            texture.assign(start + 6, end);
+        }
+        else if(strncmp(line, "char ", 5) == 0)
+        {
+            unsigned int id;
+            fzFontGlyph glyph;
+            if(sscanf(line, "char id=%u x=%f y=%f width=%f height=%f xoffset=%f yoffset=%f xadvance=%f",
+                      &id, &glyph.x, &glyph.y, &glyph.width, &glyph.height,
+                      &glyph.xOffset, &glyph.yOffset, &glyph.xAdvance) != 8) {
+                fprintf(stderr, "fzfont: line %d: invalid char data, ignored.\n", lineNumber);
+                continue;
+            }
+            glyphs[id] = glyph;
+        }
+        else if(strncmp(line, "kerning ", 8) == 0)
+        {
+            unsigned int first, second;
+            float amount;
+            if(sscanf(line, "kerning first=%u second=%u amount=%f", &first, &second, &amount) != 3) {
+                fprintf(stderr, "fzfont: line %d: invalid kerning data, ignored.\n", lineNumber);
+                continue;
+            }
+            if(amount != 0)
+                kernings[((uint64_t)first << 32) | second] = amount;
+        }
+    }
+    fclose(input);
+    
+    if(lineHeight <= 0 || texture.empty() || glyphs.empty()) {
+        fprintf(stderr, "fzfont: %s is not a valid text FNT file.\n", argv[1]);
+        return 1;
+    }
+    
+    
+    // PAGES: 256 code points each, only the pages with glyphs are stored.
+    vector<uint32_t> pages;
+    for(map<uint32_t, fzFontGlyph>::const_iterator it = glyphs.begin(); it != glyphs.end(); ++it) {
+        uint32_t page = it->first >> 8;
+        if(pages.empty() || pages.back() != page)
+            pages.push_back(page);
+    }
+    
+    const uint32_t nuGlyphs = pages.size() * 256;
+    vector<fzFontGlyph> table(nuGlyphs);
+    memset(&table[0], 0, nuGlyphs * sizeof(fzFontGlyph));
+    
+    for(map<uint32_t, fzFontGlyph>::const_iterator it = glyphs.begin(); it != glyphs.end(); ++it) {
+        size_t pageIndex = lower_bound(pages.begin(), pages.end(), it->first >> 8) - pages.begin();
+        table[pageIndex * 256 + (it->first & 0xFF)] = it->second;
+    }
+    
+    
+    // KERNING: flat table indexed by glyph, pairs whose first glyph is not stored are dropped.
+    vector<uint32_t> kerningIndex(nuGlyphs + 1, 0);
+    vector<fzFontKerning> kerningTable;
+    map<uint64_t, float>::const_iterator kerning = kernings.begin();
+    for(uint32_t slot = 0; slot < nuGlyphs; ++slot)
+    {
+        uint32_t codePoint = (pages[slot / 256] << 8) | (slot & 0xFF);
+        kerningIndex[slot] = kerningTable.size();
+        
+        for(; kerning != kernings.end() && (kerning->first >> 32) <= codePoint; ++kerning) {
+            if((kerning->first >> 32) == codePoint) {
+                fzFontKerning pair = { (uint32_t)(kerning->first & 0xFFFFFFFF), kerning->second };
+                kerningTable.push_back(pair);
+            }
+        }
+    }
+    kerningIndex[nuGlyphs] = kerningTable.size();
+    
+    
+    // OUTPUT
+    uint32_t textureLength = (texture.size() + 1 + 3) & ~3;
+    
+    vector<char> out;
+    writeU32(out, FZ_FONT_MAGIC);
+    writeU32(out, FZ_FONT_VERSION);
+    writeFloat(out, lineHeight);
+    writeU32(out, textureLength);
+    writeU32(out, pages.size());
+    writeU32(out, kerningTable.size());
+    
+    out.insert(out.end(), texture.begin(), texture.end());
+    out.resize(out.size() + textureLength - texture.size(), '\0');
+    
+    for(size_t i = 0; i < pages.size(); ++i)
+        writeU32(out, pages[i]);
+    
+    for(size_t i = 0; i < table.size(); ++i) {
+        const fzFontGlyph& glyph = table[i];
+        writeFloat(out, glyph.x);
+        writeFloat(out, glyph.y);
+        writeFloat(out, glyph.width);
+        writeFloat(out, glyph.height);
+        writeFloat(out, glyph.xOffset);
+        writeFloat(out, glyph.yOffset);
+        writeFloat(out, glyph.xAdvance);
+    }
+    
+    for(size_t i = 0; i < kerningIndex.size(); ++i)
+        writeU32(out, kerningIndex[i]);
+    
+    for(size_t i = 0; i < kerningTable.size(); ++i) {
+        writeU32(out, kerningTable[i].second);
+        writeFloat(out, kerningTable[i].amount);
+    }
+    
+    FILE *output = fopen(argv[2], "wb");
+    if(output == NULL || fwrite(&out[0], 1, out.size(), output) != out.size()) {
+        fprintf(stderr, "fzfont: %s can not be written.\n", argv[2]);
+        if(output)
+            fclose(output);
+        return 1;
+    }
+    fclose(output);
+    
+    printf("%s: %u glyphs in %u pages, %u kerning pairs, %u bytes.\n",
+           argv[2], (unsigned)glyphs.size(), (unsigned)pages.size(), (unsigned)kerningTable.size(), (unsigned)out.size());
+    return 0;
+}
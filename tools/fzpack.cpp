@@ -0,0 +1,315 @@
+/*
+ * FORZE ENGINE: http://forzefield.com
+ *
+ * Copyright (c) 2011-2012 FORZEFIELD Studios S.L.
+ * Copyright (c) 2012 Manuel Martínez-Almeida
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ @author Manuel Martínez-Almeida
+ */
+
+/**
+ * fzpack: packs a resources directory into an archive that can be mounted with
+ * ResourcesManager::mountArchive(). The format is described in FORZE/FZResourcesArchive.h.
+ *
+ * Build: c++ -std=c++11 -O2 tools/fzpack.cpp FORZE/FZHash.cpp -lz -o fzpack
+ * Usage: fzpack [-z] <resources directory> <output archive>
+ *  -z  deflates the files that shrink at least a 10% (already compressed formats are stored).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "../FORZE/FZHash.h"
+
+using namespace std;
+
+// Must match FORZE/FZResourcesArchive.h
+#define FZ_ARCHIVE_MAGIC 0x4b505a46
+#define FZ_ARCHIVE_VERSION 2
+#define FZ_ARCHIVE_ALIGNMENT 4096
+#define FZ_IO_SUBFIX_CHAR '@'
+
+struct fzArchiveHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t alignment;
+};
+
+struct fzArchiveEntry
+{
+    uint32_t hash;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t length;
+    uint16_t compression;
+    uint16_t factor;
+};
+
+struct fzPackedFile
+{
+    string path;
+    fzArchiveEntry entry;
+    vector<char> data;
+};
+
+
+static bool isLittleEndian()
+{
+    uint16_t value = 1;
+    return *(uint8_t*)&value == 1;
+}
+
+
+static uint32_t toLittle32(uint32_t n)
+{
+    if(isLittleEndian())
+        return n;
+    return ((n & 0xff) << 24) | ((n & 0xff00) << 8) | ((n >> 8) & 0xff00) | (n >> 24);
+}
+
+
+static uint16_t toLittle16(uint16_t n)
+{
+    if(isLittleEndian())
+        return n;
+    return (uint16_t)((n << 8) | (n >> 8));
+}
+
+
+static bool isCompressedFormat(const string& path)
+{
+    static const char *extensions[] = { ".png", ".jpg", ".jpeg", ".ccz", ".gz", ".zip", ".mp3", ".m4a", ".caf", NULL };
+    for(const char **ext = extensions; *ext; ++ext) {
+        size_t length = strlen(*ext);
+        if(path.size() >= length && strcasecmp(path.c_str() + path.size() - length, *ext) == 0)
+            return true;
+    }
+    return false;
+}
+
+
+// "hero@x2.png" -> 2, "hero.png" or "hero@ipadhd.png" -> 1
+static uint16_t parseFactor(const string& path)
+{
+    size_t slash = path.rfind('/');
+    const char *name = path.c_str() + (slash == string::npos ? 0 : slash + 1);
+    const char *flag = strchr(name, FZ_IO_SUBFIX_CHAR);
+    if(flag && flag[1] == 'x') {
+        int factor = atoi(flag + 2);
+        if(factor > 0)
+            return (uint16_t)factor;
+    }
+    return 1;
+}
+
+
+static bool readFile(const string& path, vector<char>& data)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if(f == NULL)
+        return false;
+    
+    fseek(f, 0, SEEK_END);
+    data.resize((size_t)ftell(f));
+    fseek(f, 0, SEEK_SET);
+    size_t read = data.empty() ? 0 : fread(&data[0], 1, data.size(), f);
+    fclose(f);
+    return (read == data.size());
+}
+
+
+static void collectFiles(const string& root, const string& relative, vector<fzPackedFile>& files)
+{
+    string directory = relative.empty() ? root : root + "/" + relative;
+    DIR *dir = opendir(directory.c_str());
+    if(dir == NULL)
+        return;
+    
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        if(entry->d_name[0] == '.')
+            continue;
+        
+        string path = relative.empty() ? entry->d_name : relative + "/" + entry->d_name;
+        struct stat info;
+        if(stat((root + "/" + path).c_str(), &info) != 0)
+            continue;
+        
+        if(S_ISDIR(info.st_mode))
+            collectFiles(root, path, files);
+        
+        else if(S_ISREG(info.st_mode)) {
+            fzPackedFile file;
+            file.path = path;
+            files.push_back(file);
+        }
+    }
+    closedir(dir);
+}
+
+
+static bool compareFiles(const fzPackedFile& a, const fzPackedFile& b)
+{
+    if(a.entry.hash != b.entry.hash)
+        return a.entry.hash < b.entry.hash;
+    
+    // colliding paths are told apart by the loader, sorting them keeps the duplicates together
+    return strcasecmp(a.path.c_str(), b.path.c_str()) < 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    bool deflate = false;
+    int arg = 1;
+    if(argc > 1 && strcmp(argv[1], "-z") == 0) {
+        deflate = true;
+        ++arg;
+    }
+    if(argc - arg != 2) {
+        fprintf(stderr, "Usage: %s [-z] <resources directory> <output archive>\n", argv[0]);
+        return 1;
+    }
+    string root = argv[arg];
+    const char *output = argv[arg+1];
+    
+    vector<fzPackedFile> files;
+    collectFiles(root, "", files);
+    
+    // LOAD AND COMPRESS
+    for(size_t i = 0; i < files.size(); ++i)
+    {
+        fzPackedFile& file = files[i];
+        if(!readFile(root + "/" + file.path, file.data)) {
+            fprintf(stderr, "fzpack: \"%s\" could not be read.\n", file.path.c_str());
+            return 1;
+        }
+        
+        fzArchiveEntry& entry = file.entry;
+        entry.hash = FORZE::fzHashLowercase(file.path.c_str());
+        entry.length = (uint32_t)file.data.size();
+        entry.size = entry.length;
+        entry.compression = 0;
+        entry.factor = parseFactor(file.path);
+        
+        if(deflate && !file.data.empty() && !isCompressedFormat(file.path))
+        {
+            uLongf size = compressBound(file.data.size());
+            vector<char> compressed(size);
+            if(compress2((Bytef*)&compressed[0], &size, (const Bytef*)&file.data[0], file.data.size(), Z_BEST_COMPRESSION) == Z_OK &&
+               size < file.data.size() * 9 / 10)
+            {
+                compressed.resize(size);
+                file.data.swap(compressed);
+                entry.size = (uint32_t)size;
+                entry.compression = 1;
+            }
+        }
+    }
+    
+    // SORTED INDEX
+    // the paths are resolved ignoring case, so two files can not differ only in case
+    sort(files.begin(), files.end(), compareFiles);
+    for(size_t i = 1; i < files.size(); ++i) {
+        if(strcasecmp(files[i].path.c_str(), files[i-1].path.c_str()) == 0) {
+            fprintf(stderr, "fzpack: \"%s\" and \"%s\" only differ in case.\n",
+                    files[i-1].path.c_str(), files[i].path.c_str());
+            return 1;
+        }
+    }
+    
+    // LAYOUT: the paths follow the index, every blob starts in a new page and it is followed by at least one '\0'
+    uint64_t offset = sizeof(fzArchiveHeader) + files.size() * sizeof(fzArchiveEntry);
+    for(size_t i = 0; i < files.size(); ++i)
+        offset += files[i].path.size() + 1;
+    
+    for(size_t i = 0; i < files.size(); ++i) {
+        offset = (offset + FZ_ARCHIVE_ALIGNMENT - 1) & ~(uint64_t)(FZ_ARCHIVE_ALIGNMENT - 1);
+        files[i].entry.offset = (uint32_t)offset;
+        offset += files[i].entry.size + 1;
+    }
+    if(offset > UINT32_MAX) {
+        fprintf(stderr, "fzpack: the archive is bigger than 4GB.\n");
+        return 1;
+    }
+    
+    // WRITE
+    FILE *f = fopen(output, "wb");
+    if(f == NULL) {
+        fprintf(stderr, "fzpack: \"%s\" could not be created.\n", output);
+        return 1;
+    }
+    
+    fzArchiveHeader header;
+    header.magic = toLittle32(FZ_ARCHIVE_MAGIC);
+    header.version = toLittle32(FZ_ARCHIVE_VERSION);
+    header.count = toLittle32((uint32_t)files.size());
+    header.alignment = toLittle32(FZ_ARCHIVE_ALIGNMENT);
+    fwrite(&header, sizeof(header), 1, f);
+    
+    for(size_t i = 0; i < files.size(); ++i) {
+        fzArchiveEntry entry = files[i].entry;
+        entry.hash = toLittle32(entry.hash);
+        entry.offset = toLittle32(entry.offset);
+        entry.size = toLittle32(entry.size);
+        entry.length = toLittle32(entry.length);
+        entry.compression = toLittle16(entry.compression);
+        entry.factor = toLittle16(entry.factor);
+        fwrite(&entry, sizeof(entry), 1, f);
+    }
+    
+    uint64_t position = sizeof(fzArchiveHeader) + files.size() * sizeof(fzArchiveEntry);
+    for(size_t i = 0; i < files.size(); ++i) {
+        fwrite(files[i].path.c_str(), 1, files[i].path.size() + 1, f);
+        position += files[i].path.size() + 1;
+    }
+    
+    for(size_t i = 0; i < files.size(); ++i)
+    {
+        const fzPackedFile& file = files[i];
+        for(; position < file.entry.offset; ++position)
+            fputc(0, f);
+        
+        if(!file.data.empty())
+            fwrite(&file.data[0], 1, file.data.size(), f);
+        fputc(0, f);
+        position += file.data.size() + 1;
+        
+        printf("%08x %s%s\n", file.entry.hash, file.path.c_str(), file.entry.compression ? " (deflated)" : "");
+    }
+    fclose(f);
+    
+    printf("fzpack: %u files packed into \"%s\".\n", (unsigned)files.size(), output);
+    return 0;
+}